@@ -0,0 +1,74 @@
+/**
+ * 姿勢フィルタ共通処理の実装
+ */
+
+#include "AttitudeFilter.h"
+#include <stdint.h>
+#include <string.h>
+
+AttitudeFilter::AttitudeFilter()
+  : q0_(1.0f), q1_(0.0f), q2_(0.0f), q3_(0.0f),
+    beta_(0.1f), invSampleFreq_(0.01f),
+    roll_(0.0f), pitch_(0.0f), yaw_(0.0f), anglesValid_(false) {
+}
+
+void AttitudeFilter::reset() {
+  q0_ = 1.0f;
+  q1_ = 0.0f;
+  q2_ = 0.0f;
+  q3_ = 0.0f;
+  anglesValid_ = false;
+}
+
+float AttitudeFilter::invSqrt(float x) {
+  // 高速逆平方根（Quake IIIアルゴリズム）
+  // ビット列の読み替えは memcpy で行う（ポインタキャストは未定義動作、long は64bit環境で8B）
+  float halfx = 0.5f * x;
+  float y = x;
+  int32_t i;
+  memcpy(&i, &y, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  memcpy(&y, &i, sizeof(y));
+  y = y * (1.5f - (halfx * y * y));
+  return y;
+}
+
+void AttitudeFilter::computeAngles() {
+  roll_ = atan2f(2.0f * (q0_ * q1_ + q2_ * q3_),
+                 1.0f - 2.0f * (q1_ * q1_ + q2_ * q2_)) * 57.29578f;  // radをdegに変換
+  // 数値誤差で |sin| が1をわずかに超えると asinf が NaN になるので丸める
+  float sinp = 2.0f * (q0_ * q2_ - q3_ * q1_);
+  if (sinp > 1.0f) sinp = 1.0f;
+  if (sinp < -1.0f) sinp = -1.0f;
+  pitch_ = asinf(sinp) * 57.29578f;
+  yaw_ = atan2f(2.0f * (q0_ * q3_ + q1_ * q2_),
+                1.0f - 2.0f * (q2_ * q2_ + q3_ * q3_)) * 57.29578f;
+  anglesValid_ = true;
+}
+
+void AttitudeFilter::eulerToQuaternion(float rollDeg, float pitchDeg, float yawDeg,
+                                       float* q0, float* q1, float* q2, float* q3) {
+  // 半角（deg → rad の 1/2）
+  float cr = cosf(rollDeg * 0.00872665f), sr = sinf(rollDeg * 0.00872665f);
+  float cp = cosf(pitchDeg * 0.00872665f), sp = sinf(pitchDeg * 0.00872665f);
+  float cy = cosf(yawDeg * 0.00872665f), sy = sinf(yawDeg * 0.00872665f);
+  *q0 = cr * cp * cy + sr * sp * sy;
+  *q1 = sr * cp * cy - cr * sp * sy;
+  *q2 = cr * sp * cy + sr * cp * sy;
+  *q3 = cr * cp * sy - sr * sp * cy;
+}
+
+float AttitudeFilter::getRoll() {
+  if (!anglesValid_) computeAngles();
+  return roll_;
+}
+
+float AttitudeFilter::getPitch() {
+  if (!anglesValid_) computeAngles();
+  return pitch_;
+}
+
+float AttitudeFilter::getYaw() {
+  if (!anglesValid_) computeAngles();
+  return yaw_;
+}
@@ -0,0 +1,98 @@
+/**
+ * 姿勢フィルタの共通インターフェース
+ * Madgwick / Mahony / 相補 / EKF を MPU6886_AHRS から切り替えて使えるようにする
+ * プラットフォーム依存を持たないポータブル実装
+ */
+
+#ifndef ATTITUDE_FILTER_H
+#define ATTITUDE_FILTER_H
+
+#include <cmath>
+
+/**
+ * 姿勢フィルタの基底クラス
+ * 姿勢はクォータニオン (w, x, y, z) で保持し、オイラー角は読み出し時にまとめて計算してキャッシュする
+ */
+class AttitudeFilter {
+public:
+  AttitudeFilter();
+  virtual ~AttitudeFilter() {}
+
+  /**
+   * フィルタ名（ログ・ベンチマーク表示用）
+   */
+  virtual const char* name() const = 0;
+
+  /**
+   * 予想サンプルレートでフィルタを初期化
+   * @param sampleRateHz 更新周波数 (Hz)
+   */
+  virtual void begin(float sampleRateHz) { invSampleFreq_ = 1.0f / sampleRateHz; }
+
+  /**
+   * 新しいIMU計測でフィルタを更新
+   * @param gx, gy, gz ジャイロスコープ (deg/s)
+   * @param ax, ay, az 加速度計 (g)
+   * @param dtSec 前回の更新からの時間（秒）
+   */
+  virtual void update(float gx, float gy, float gz,
+                      float ax, float ay, float az,
+                      float dtSec) = 0;
+
+  /**
+   * 設定されたサンプルレートを使用して更新（後方互換性）
+   */
+  void update(float gx, float gy, float gz,
+              float ax, float ay, float az) {
+    update(gx, gy, gz, ax, ay, az, invSampleFreq_);
+  }
+
+  /**
+   * オイラー角として姿勢を取得（度数法）
+   * update() 後の最初の呼び出しで3軸まとめて計算し、次の update() まではキャッシュを返す
+   */
+  float getRoll();
+  float getPitch();
+  float getYaw();
+
+  /**
+   * クォータニオン要素を取得 (w, x, y, z)
+   */
+  virtual void getQuaternion(float* q0, float* q1, float* q2, float* q3) {
+    *q0 = q0_; *q1 = q1_; *q2 = q2_; *q3 = q3_;
+  }
+
+  /**
+   * フィルタゲインを設定（加速度による補正の強さ。高い = 速い収束だがノイズが多い）
+   * 意味の細部はフィルタごとに異なる（各クラスのコメント参照）
+   */
+  virtual void setGain(float gain) { beta_ = gain; }
+
+  /**
+   * 姿勢を初期状態にリセット
+   */
+  virtual void reset();
+
+  /**
+   * 高速逆平方根（1/sqrt(x)、相対誤差 0.2% 以下）
+   */
+  static float invSqrt(float x);
+
+protected:
+  // update() の最後に呼ぶ（オイラー角のキャッシュを無効化）
+  void invalidateAngles() { anglesValid_ = false; }
+  // キャッシュ roll_/pitch_/yaw_ を計算（既定はクォータニオンから）
+  virtual void computeAngles();
+  // ZYX オイラー角（度）からクォータニオンへ
+  static void eulerToQuaternion(float rollDeg, float pitchDeg, float yawDeg,
+                                float* q0, float* q1, float* q2, float* q3);
+
+  float q0_, q1_, q2_, q3_;  // クォータニオン状態
+  float beta_;                // フィルタゲイン
+  float invSampleFreq_;       // 1 / サンプルレート（秒）
+
+  float roll_, pitch_, yaw_;  // オイラー角のキャッシュ（度）
+  bool anglesValid_;          // キャッシュが現在の状態に対応しているか
+};
+
+#endif // ATTITUDE_FILTER_H
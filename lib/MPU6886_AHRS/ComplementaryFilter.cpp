@@ -0,0 +1,45 @@
+/**
+ * 相補フィルタ実装
+ */
+
+#include "ComplementaryFilter.h"
+
+// 角度差を -180～180 度に丸める
+static float wrapDeg(float a) {
+  while (a > 180.0f) a -= 360.0f;
+  while (a <= -180.0f) a += 360.0f;
+  return a;
+}
+
+void ComplementaryFilter::reset() {
+  AttitudeFilter::reset();
+  roll_ = 0.0f;
+  pitch_ = 0.0f;
+  yaw_ = 0.0f;
+  anglesValid_ = true;
+}
+
+void ComplementaryFilter::update(float gx, float gy, float gz,
+                                 float ax, float ay, float az,
+                                 float dtSec) {
+  // ジャイロ積分（deg/s のまま）
+  roll_ = wrapDeg(roll_ + gx * dtSec);
+  pitch_ += gy * dtSec;
+  yaw_ = wrapDeg(yaw_ + gz * dtSec);
+
+  // 加速度から求めた傾きへ引き戻す（Madgwick と同じ軸・符号）
+  if (ax != 0.0f || ay != 0.0f || az != 0.0f) {
+    float accRoll = atan2f(ay, az) * 57.29578f;
+    float accPitch = atan2f(-ax, sqrtf(ay * ay + az * az)) * 57.29578f;
+    float k = beta_ * dtSec;
+    if (k > 1.0f) k = 1.0f;
+    roll_ = wrapDeg(roll_ + k * wrapDeg(accRoll - roll_));
+    pitch_ += k * (accPitch - pitch_);
+  }
+  if (pitch_ > 90.0f) pitch_ = 90.0f;
+  if (pitch_ < -90.0f) pitch_ = -90.0f;
+}
+
+void ComplementaryFilter::getQuaternion(float* q0, float* q1, float* q2, float* q3) {
+  eulerToQuaternion(roll_, pitch_, yaw_, q0, q1, q2, q3);
+}
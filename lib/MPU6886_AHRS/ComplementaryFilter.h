@@ -0,0 +1,35 @@
+/**
+ * 相補フィルタ
+ * 6軸IMU用の最も軽い姿勢フィルタ（三角関数は加速度からの傾き計算のみ）
+ */
+
+#ifndef COMPLEMENTARY_FILTER_H
+#define COMPLEMENTARY_FILTER_H
+
+#include "AttitudeFilter.h"
+
+/**
+ * 相補フィルタ
+ * roll/pitch はジャイロ積分を加速度から求めた傾きへ一次遅れで引き戻す。yaw はジャイロ積分のみ
+ * 角速度をそのままオイラー角速度とみなすため、大きく傾いた状態での速い回転には弱い
+ * ゲイン: 加速度へ引き戻す速さ [1/s]（0.4 なら時定数 2.5 秒）
+ */
+class ComplementaryFilter : public AttitudeFilter {
+public:
+  ComplementaryFilter() {}
+
+  const char* name() const override { return "Complementary"; }
+
+  using AttitudeFilter::update;
+  void update(float gx, float gy, float gz,
+              float ax, float ay, float az,
+              float dtSec) override;
+
+  void getQuaternion(float* q0, float* q1, float* q2, float* q3) override;
+  void reset() override;
+
+protected:
+  void computeAngles() override { anglesValid_ = true; }  // 状態がオイラー角そのもの
+};
+
+#endif // COMPLEMENTARY_FILTER_H
@@ -0,0 +1,183 @@
+/**
+ * 6状態EKF実装
+ */
+
+#include "Ekf6AHRS.h"
+#include <string.h>
+
+static const float DEG2RAD = 0.01745329f;
+static const float RAD2DEG = 57.29578f;
+
+Ekf6AHRS::Ekf6AHRS() {
+  setProcessNoise(0.05f, 0.002f);
+  reset();
+}
+
+void Ekf6AHRS::setProcessNoise(float gyroNoiseDps, float biasWalkDps) {
+  qGyro_ = (gyroNoiseDps * DEG2RAD) * (gyroNoiseDps * DEG2RAD);
+  qBias_ = (biasWalkDps * DEG2RAD) * (biasWalkDps * DEG2RAD);
+}
+
+void Ekf6AHRS::reset() {
+  AttitudeFilter::reset();
+  memset(x_, 0, sizeof(x_));
+  memset(P_, 0, sizeof(P_));
+  // 初期姿勢は不明（最初の数サンプルで加速度に合わせる）、バイアスは校正済みの残り程度
+  for (int i = 0; i < 3; i++) P_[i][i] = 0.5f;
+  for (int i = 3; i < N; i++) P_[i][i] = (2.0f * DEG2RAD) * (2.0f * DEG2RAD);
+}
+
+void Ekf6AHRS::getBias(float* bx, float* by, float* bz) {
+  *bx = x_[3] * RAD2DEG;
+  *by = x_[4] * RAD2DEG;
+  *bz = x_[5] * RAD2DEG;
+}
+
+void Ekf6AHRS::update(float gx, float gy, float gz,
+                      float ax, float ay, float az,
+                      float dtSec) {
+  // --- 予測 ---
+  float p = gx * DEG2RAD - x_[3];
+  float q = gy * DEG2RAD - x_[4];
+  float r = gz * DEG2RAD - x_[5];
+  float sr = sinf(x_[0]), cr = cosf(x_[0]);
+  float sp = sinf(x_[1]), cp = cosf(x_[1]);
+  if (fabsf(cp) < 1e-3f) cp = (cp < 0.0f) ? -1e-3f : 1e-3f;  // pitch ±90度付近の特異点回避
+  float tp = sp / cp;
+  float u = q * sr + r * cr;
+  float w = q * cr - r * sr;
+
+  // オイラー角の運動学
+  x_[0] += (p + u * tp) * dtSec;
+  x_[1] += w * dtSec;
+  x_[2] += (u / cp) * dtSec;
+
+  // ヤコビアン F = I + A dt
+  float F[N][N];
+  memset(F, 0, sizeof(F));
+  for (int i = 0; i < N; i++) F[i][i] = 1.0f;
+  float sec2 = 1.0f / (cp * cp);
+  F[0][0] += w * tp * dtSec;
+  F[0][1] += u * sec2 * dtSec;
+  F[0][3] = -dtSec;
+  F[0][4] = -sr * tp * dtSec;
+  F[0][5] = -cr * tp * dtSec;
+  F[1][0] = -u * dtSec;
+  F[1][4] = -cr * dtSec;
+  F[1][5] = sr * dtSec;
+  F[2][0] = (w / cp) * dtSec;
+  F[2][1] = u * sp * sec2 * dtSec;
+  F[2][4] = -(sr / cp) * dtSec;
+  F[2][5] = -(cr / cp) * dtSec;
+
+  // P = F P F^T + Q
+  float FP[N][N];
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      float s = 0.0f;
+      for (int k = 0; k < N; k++) s += F[i][k] * P_[k][j];
+      FP[i][j] = s;
+    }
+  }
+  for (int i = 0; i < N; i++) {
+    for (int j = i; j < N; j++) {
+      float s = 0.0f;
+      for (int k = 0; k < N; k++) s += FP[i][k] * F[j][k];
+      P_[i][j] = P_[j][i] = s;
+    }
+  }
+  for (int i = 0; i < 3; i++) P_[i][i] += qGyro_ * dtSec;
+  for (int i = 3; i < N; i++) P_[i][i] += qBias_ * dtSec;
+
+  // --- 観測（加速度の向き = 重力方向） ---
+  float norm2 = ax * ax + ay * ay + az * az;
+  if (norm2 > 0.0f) {
+    float inv = invSqrt(norm2);
+    float z[3] = { ax * inv, ay * inv, az * inv };
+    sr = sinf(x_[0]); cr = cosf(x_[0]);
+    sp = sinf(x_[1]); cp = cosf(x_[1]);
+    float h[3] = { -sp, sr * cp, cr * cp };
+    // H は roll / pitch の列のみ非ゼロ
+    float H[3][2] = {
+      { 0.0f,     -cp      },
+      { cr * cp,  -sr * sp },
+      { -sr * cp, -cr * sp },
+    };
+
+    // 観測ノイズ（|a| が 1g から外れるほど信用しない）
+    float sigma = 0.02f / (beta_ > 1e-3f ? beta_ : 1e-3f);
+    float dev = fabsf(norm2 * inv - 1.0f);
+    sigma *= 1.0f + 20.0f * dev;
+    float R = sigma * sigma;
+
+    // PHt = P H^T (N×3)、S = H P H^T + R (3×3)
+    float PHt[N][3];
+    for (int i = 0; i < N; i++) {
+      for (int m = 0; m < 3; m++) {
+        PHt[i][m] = P_[i][0] * H[m][0] + P_[i][1] * H[m][1];
+      }
+    }
+    float S[3][3];
+    for (int m = 0; m < 3; m++) {
+      for (int n = 0; n < 3; n++) {
+        S[m][n] = H[m][0] * PHt[0][n] + H[m][1] * PHt[1][n];
+      }
+      S[m][m] += R;
+    }
+
+    // S^-1（余因子）
+    float c00 = S[1][1] * S[2][2] - S[1][2] * S[2][1];
+    float c01 = S[1][2] * S[2][0] - S[1][0] * S[2][2];
+    float c02 = S[1][0] * S[2][1] - S[1][1] * S[2][0];
+    float det = S[0][0] * c00 + S[0][1] * c01 + S[0][2] * c02;
+    if (fabsf(det) > 1e-12f) {
+      float id = 1.0f / det;
+      float Si[3][3] = {
+        { c00 * id, (S[0][2] * S[2][1] - S[0][1] * S[2][2]) * id, (S[0][1] * S[1][2] - S[0][2] * S[1][1]) * id },
+        { c01 * id, (S[0][0] * S[2][2] - S[0][2] * S[2][0]) * id, (S[0][2] * S[1][0] - S[0][0] * S[1][2]) * id },
+        { c02 * id, (S[0][1] * S[2][0] - S[0][0] * S[2][1]) * id, (S[0][0] * S[1][1] - S[0][1] * S[1][0]) * id },
+      };
+
+      // K = PHt S^-1 (N×3)
+      float K[N][3];
+      for (int i = 0; i < N; i++) {
+        for (int n = 0; n < 3; n++) {
+          K[i][n] = PHt[i][0] * Si[0][n] + PHt[i][1] * Si[1][n] + PHt[i][2] * Si[2][n];
+        }
+      }
+
+      // 状態更新
+      float y[3] = { z[0] - h[0], z[1] - h[1], z[2] - h[2] };
+      for (int i = 0; i < N; i++) {
+        x_[i] += K[i][0] * y[0] + K[i][1] * y[1] + K[i][2] * y[2];
+      }
+
+      // P = P - K (H P) 。H P = PHt^T
+      for (int i = 0; i < N; i++) {
+        for (int j = i; j < N; j++) {
+          float s = K[i][0] * PHt[j][0] + K[i][1] * PHt[j][1] + K[i][2] * PHt[j][2];
+          P_[i][j] -= s;
+          P_[j][i] = P_[i][j];
+        }
+      }
+    }
+  }
+
+  // 角度を -π～π に丸める
+  for (int i = 0; i < 3; i += 2) {
+    while (x_[i] > 3.14159265f) x_[i] -= 6.2831853f;
+    while (x_[i] <= -3.14159265f) x_[i] += 6.2831853f;
+  }
+  invalidateAngles();
+}
+
+void Ekf6AHRS::computeAngles() {
+  roll_ = x_[0] * RAD2DEG;
+  pitch_ = x_[1] * RAD2DEG;
+  yaw_ = x_[2] * RAD2DEG;
+  anglesValid_ = true;
+}
+
+void Ekf6AHRS::getQuaternion(float* q0, float* q1, float* q2, float* q3) {
+  eulerToQuaternion(x_[0] * RAD2DEG, x_[1] * RAD2DEG, x_[2] * RAD2DEG, q0, q1, q2, q3);
+}
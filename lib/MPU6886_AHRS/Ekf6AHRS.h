@@ -0,0 +1,56 @@
+/**
+ * 6状態拡張カルマンフィルタ（姿勢 + ジャイロバイアス）
+ * 6軸IMU（加速度計 + ジャイロ）用の姿勢フィルタ
+ */
+
+#ifndef EKF6_AHRS_H
+#define EKF6_AHRS_H
+
+#include "AttitudeFilter.h"
+
+/**
+ * 6状態EKF
+ * 状態: [roll, pitch, yaw, バイアスx, バイアスy, バイアスz]（rad, rad/s）
+ * 予測: バイアスを引いたジャイロでオイラー角を積分。観測: 加速度の向き（重力方向）
+ * yaw と z軸バイアスは重力からは観測できないため、ジャイロ積分のまま
+ * ゲイン: 加速度を信用する度合い（観測ノイズ sigma = 0.02 / gain [g]）。
+ *         加えて |a| が 1g から外れるほど観測ノイズを大きくする（歩行中の衝撃対策）
+ */
+class Ekf6AHRS : public AttitudeFilter {
+public:
+  Ekf6AHRS();
+
+  const char* name() const override { return "EKF6"; }
+
+  using AttitudeFilter::update;
+  void update(float gx, float gy, float gz,
+              float ax, float ay, float az,
+              float dtSec) override;
+
+  void getQuaternion(float* q0, float* q1, float* q2, float* q3) override;
+  void reset() override;
+
+  /**
+   * プロセスノイズを設定
+   * @param gyroNoiseDps ジャイロのノイズ密度 (deg/s)
+   * @param biasWalkDps バイアスのランダムウォーク (deg/s/√s)
+   */
+  void setProcessNoise(float gyroNoiseDps, float biasWalkDps);
+
+  /**
+   * 推定したジャイロバイアス (deg/s)
+   */
+  void getBias(float* bx, float* by, float* bz);
+
+protected:
+  void computeAngles() override;
+
+private:
+  static const int N = 6;
+  float x_[N];      // 状態
+  float P_[N][N];   // 共分散
+  float qGyro_;     // ジャイロノイズ分散 (rad/s)^2
+  float qBias_;     // バイアスランダムウォーク分散 (rad/s)^2/s
+};
+
+#endif // EKF6_AHRS_H
@@ -4,10 +4,34 @@
 
 #include "MPU6886.h"
 
+static const MPU6886::Config PROFILES[MPU6886::PROFILE_COUNT] = {
+  // accel            gyro                  DLPF A_DLPF div
+  { MPU6886::AFS_8G, MPU6886::GFS_2000DPS, 1,   0,     1  },  // DEFAULT 500Hz
+  { MPU6886::AFS_8G, MPU6886::GFS_2000DPS, 1,   0,     0  },  // GAIT    1kHz
+  { MPU6886::AFS_4G, MPU6886::GFS_500DPS,  2,   2,     1  },  // BALANCE 500Hz
+  { MPU6886::AFS_8G, MPU6886::GFS_2000DPS, 5,   5,     19 },  // IDLE    50Hz
+};
+
 MPU6886::MPU6886() 
   : wire_(nullptr), i2cAddress_(MPU6886_ADDRESS), deviceID_(0),
-    accelScale_(AFS_8G), gyroScale_(GFS_2000DPS),
+    config_(PROFILES[PROFILE_DEFAULT]),
     accelRes_(0.0f), gyroRes_(0.0f) {
+  updateAccelRes();
+  updateGyroRes();
+}
+
+const MPU6886::Config& MPU6886::profileConfig(Profile profile) {
+  return PROFILES[profile < PROFILE_COUNT ? profile : PROFILE_DEFAULT];
+}
+
+const char* MPU6886::profileName(Profile profile) {
+  switch (profile) {
+    case PROFILE_DEFAULT: return "default";
+    case PROFILE_GAIT:    return "gait";
+    case PROFILE_BALANCE: return "balance";
+    case PROFILE_IDLE:    return "idle";
+    default:              return "?";
+  }
 }
 
 int MPU6886::begin(TwoWire* wire, uint8_t address) {
@@ -18,18 +42,13 @@ int MPU6886::begin(TwoWire* wire, uint8_t address) {
   uint8_t whoami;
   readBytes(MPU6886_WHOAMI, 1, &whoami);
   deviceID_ = whoami;
-  delay(1);
 
   // WHOAMI値をチェック（MPU6886/9の正常なIDは0x19または0x70）
   if (whoami != 0x19 && whoami != 0x70) {
     return -1;  // デバイスが見つからない
   }
 
-  // デバイスをリセット
-  writeByte(MPU6886_PWR_MGMT_1, 0x00);
-  delay(10);
-
-  // デバイスリセット
+  // デバイスリセット（USER_CTRL / FIFO_EN などは 0 に戻る）
   writeByte(MPU6886_PWR_MGMT_1, 0x80);
   delay(10);
 
@@ -37,48 +56,12 @@ int MPU6886::begin(TwoWire* wire, uint8_t address) {
   writeByte(MPU6886_PWR_MGMT_1, 0x01);
   delay(10);
 
-  // 加速度計を設定 (±8g)
-  writeByte(MPU6886_ACCEL_CONFIG, 0x10);
-  delay(1);
-
-  // ジャイロスコープを設定 (±2000dps)
-  writeByte(MPU6886_GYRO_CONFIG, 0x18);
-  delay(1);
+  // レンジ・DLPF・ODR（リセット後なので全て書く）
+  writeConfig(config_, true);
 
-  // サンプルレート分周器を設定 (1kHz / (1 + div))
-  writeByte(MPU6886_CONFIG, 0x01);  // 1kHz出力
-  delay(1);
-
-  writeByte(MPU6886_SMPLRT_DIV, 0x01);  // 500Hz
-  delay(1);
-
-  // 割り込みを無効化
-  writeByte(MPU6886_INT_ENABLE, 0x00);
-  delay(1);
-
-  // 加速度計LPFを設定
-  writeByte(MPU6886_ACCEL_CONFIG2, 0x00);
-  delay(1);
-
-  // ユーザー制御機能を無効化
-  writeByte(MPU6886_USER_CTRL, 0x00);
-  delay(1);
-
-  // FIFOを無効化
-  writeByte(MPU6886_FIFO_EN, 0x00);
-  delay(1);
-
-  // 割り込みピンを設定
+  // 割り込みピンを設定し、データレディ割り込みを有効化
   writeByte(MPU6886_INT_PIN_CFG, 0x22);
-  delay(1);
-
-  // データレディ割り込みを有効化
   writeByte(MPU6886_INT_ENABLE, 0x01);
-  delay(10);
-
-  // スケール解像度を更新
-  setAccelScale(accelScale_);
-  setGyroScale(gyroScale_);
 
   return 0;
 }
@@ -124,11 +107,31 @@ void MPU6886::readGyro(float* gx, float* gy, float* gz) {
 void MPU6886::readTemp(float* temp) {
   int16_t rawTemp;
   readTempADC(&rawTemp);
-  *temp = (float)rawTemp / 326.8f + 25.0f;
+  *temp = rawToCelsius(rawTemp);
+}
+
+void MPU6886::readRaw(RawSample* sample) {
+  uint8_t buf[MPU6886_FIFO_FRAME_LEN];
+  readBytes(MPU6886_ACCEL_XOUT_H, MPU6886_FIFO_FRAME_LEN, buf);
+  decodeFrame(buf, sample);
+}
+
+void MPU6886::readAll(float* ax, float* ay, float* az,
+                      float* gx, float* gy, float* gz,
+                      float* temp) {
+  RawSample s;
+  readRaw(&s);
+  *ax = (float)s.accel[0] * accelRes_;
+  *ay = (float)s.accel[1] * accelRes_;
+  *az = (float)s.accel[2] * accelRes_;
+  *gx = (float)s.gyro[0] * gyroRes_;
+  *gy = (float)s.gyro[1] * gyroRes_;
+  *gz = (float)s.gyro[2] * gyroRes_;
+  *temp = rawToCelsius(s.temp);
 }
 
 void MPU6886::updateGyroRes() {
-  switch (gyroScale_) {
+  switch (config_.gyroScale) {
     case GFS_250DPS:  gyroRes_ = 250.0f / 32768.0f; break;
     case GFS_500DPS:  gyroRes_ = 500.0f / 32768.0f; break;
     case GFS_1000DPS: gyroRes_ = 1000.0f / 32768.0f; break;
@@ -137,7 +140,7 @@ void MPU6886::updateGyroRes() {
 }
 
 void MPU6886::updateAccelRes() {
-  switch (accelScale_) {
+  switch (config_.accelScale) {
     case AFS_2G:  accelRes_ = 2.0f / 32768.0f; break;
     case AFS_4G:  accelRes_ = 4.0f / 32768.0f; break;
     case AFS_8G:  accelRes_ = 8.0f / 32768.0f; break;
@@ -146,19 +149,49 @@ void MPU6886::updateAccelRes() {
 }
 
 void MPU6886::setGyroScale(GyroScale scale) {
-  uint8_t config = (scale << 3);
-  writeByte(MPU6886_GYRO_CONFIG, config);
-  delay(10);
-  gyroScale_ = scale;
-  updateGyroRes();
+  Config config = config_;
+  config.gyroScale = scale;
+  setConfig(config);
 }
 
 void MPU6886::setAccelScale(AccelScale scale) {
-  uint8_t config = (scale << 3);
-  writeByte(MPU6886_ACCEL_CONFIG, config);
-  delay(10);
-  accelScale_ = scale;
+  Config config = config_;
+  config.accelScale = scale;
+  setConfig(config);
+}
+
+void MPU6886::setConfig(const Config& config) {
+  if (wire_) {
+    writeConfig(config, false);
+  } else {
+    config_ = config;
+  }
   updateAccelRes();
+  updateGyroRes();
+}
+
+void MPU6886::writeConfig(const Config& config, bool force) {
+  Config c = config;
+  // DLPF_CFG 0 / 7 は内部サンプリング 8kHz になり SMPLRT_DIV が効かない
+  if (c.gyroDlpf < 1 || c.gyroDlpf > 6) c.gyroDlpf = 1;
+  c.accelDlpf &= 0x07;
+
+  if (force || c.accelScale != config_.accelScale) {
+    writeByte(MPU6886_ACCEL_CONFIG, c.accelScale << 3);
+  }
+  if (force || c.gyroScale != config_.gyroScale) {
+    writeByte(MPU6886_GYRO_CONFIG, c.gyroScale << 3);  // FCHOICE_B = 0（DLPF 有効）
+  }
+  if (force || c.gyroDlpf != config_.gyroDlpf) {
+    writeByte(MPU6886_CONFIG, c.gyroDlpf);
+  }
+  if (force || c.accelDlpf != config_.accelDlpf) {
+    writeByte(MPU6886_ACCEL_CONFIG2, c.accelDlpf);
+  }
+  if (force || c.sampleRateDiv != config_.sampleRateDiv) {
+    writeByte(MPU6886_SMPLRT_DIV, c.sampleRateDiv);
+  }
+  config_ = c;
 }
 
 void MPU6886::setGyroOffset(uint16_t x, uint16_t y, uint16_t z) {
@@ -177,6 +210,12 @@ void MPU6886::setFIFOEnabled(bool enable) {
   writeByte(MPU6886_USER_CTRL, enable ? 0x40 : 0x00);
 }
 
+void MPU6886::setDataReadyInterrupt(bool enable) {
+  // アクティブHigh・プッシュプル・パルス出力、どのレジスタ読み出しでもステータスをクリア
+  writeByte(MPU6886_INT_PIN_CFG, enable ? 0x10 : 0x22);
+  writeByte(MPU6886_INT_ENABLE, enable ? 0x01 : 0x00);
+}
+
 uint16_t MPU6886::getFIFOCount() {
   uint8_t buf[2];
   readBytes(MPU6886_FIFO_COUNT, 2, buf);
@@ -190,14 +229,23 @@ uint8_t MPU6886::readFIFO() {
 }
 
 void MPU6886::readFIFOBuffer(uint8_t* buffer, uint16_t length) {
-  uint16_t chunks = length / 210;
+  // Wire の受信バッファを超える要求は失敗するので分割して読む
+  uint16_t chunks = length / MPU6886_I2C_READ_MAX;
   for (uint16_t i = 0; i < chunks; i++) {
-    readBytes(MPU6886_FIFO_R_W, 210, &buffer[i * 210]);
+    readBytes(MPU6886_FIFO_R_W, MPU6886_I2C_READ_MAX, &buffer[i * MPU6886_I2C_READ_MAX]);
   }
-  uint16_t remainder = length % 210;
+  uint16_t remainder = length % MPU6886_I2C_READ_MAX;
   if (remainder > 0) {
-    readBytes(MPU6886_FIFO_R_W, remainder, &buffer[chunks * 210]);
+    readBytes(MPU6886_FIFO_R_W, remainder, &buffer[chunks * MPU6886_I2C_READ_MAX]);
+  }
+}
+
+void MPU6886::decodeFrame(const uint8_t* frame, RawSample* sample) {
+  for (int i = 0; i < 3; i++) {
+    sample->accel[i] = ((int16_t)frame[i * 2] << 8) | frame[i * 2 + 1];
+    sample->gyro[i] = ((int16_t)frame[8 + i * 2] << 8) | frame[8 + i * 2 + 1];
   }
+  sample->temp = ((int16_t)frame[6] << 8) | frame[7];
 }
 
 void MPU6886::resetFIFO() {
@@ -20,6 +20,7 @@
 #define MPU6886_ACCEL_CONFIG2     0x1D
 #define MPU6886_INT_PIN_CFG       0x37
 #define MPU6886_INT_ENABLE        0x38
+#define MPU6886_INT_STATUS        0x3A
 #define MPU6886_ACCEL_XOUT_H      0x3B
 #define MPU6886_TEMP_OUT_H        0x41
 #define MPU6886_GYRO_XOUT_H       0x43
@@ -30,6 +31,12 @@
 #define MPU6886_FIFO_R_W          0x74
 #define MPU6886_GYRO_OFFSET       0x13
 
+// FIFO（加速度+ジャイロ有効時は [ACCEL 6B][TEMP 2B][GYRO 6B] の14Bで1サンプル）
+#define MPU6886_FIFO_SIZE         1024
+#define MPU6886_FIFO_FRAME_LEN    14
+// 1回のI2C読み出しの上限（ESP32 Wire の受信バッファ128Bに収まるFIFOフレーム数の倍数）
+#define MPU6886_I2C_READ_MAX      (MPU6886_FIFO_FRAME_LEN * 8)
+
 /**
  * MPU6886 6軸IMUドライバクラス
  * 加速度計、ジャイロスコープ、温度センサーをサポート
@@ -39,6 +46,41 @@ public:
   enum AccelScale { AFS_2G = 0, AFS_4G, AFS_8G, AFS_16G };
   enum GyroScale { GFS_250DPS = 0, GFS_500DPS, GFS_1000DPS, GFS_2000DPS };
 
+  /**
+   * センサー設定（レンジ・DLPF・出力データレート）
+   */
+  struct Config {
+    AccelScale accelScale;
+    GyroScale gyroScale;
+    uint8_t gyroDlpf;       // CONFIG の DLPF_CFG（1～6、内部サンプリング1kHz。1=176Hz, 2=92Hz, 5=10Hz）
+    uint8_t accelDlpf;      // ACCEL_CONFIG2 の A_DLPF_CFG（0=218Hz, 2=99Hz, 5=10Hz）
+    uint8_t sampleRateDiv;  // SMPLRT_DIV（ODR = 1kHz / (1 + div)）
+  };
+
+  /**
+   * 用途別の設定
+   * GAIT は FIFO で 14KB/s を読むため、I2C バスは 400kHz 以上で使う
+   */
+  enum Profile : uint8_t {
+    PROFILE_DEFAULT = 0,  // ±8g / ±2000dps / 500Hz / DLPF 176Hz（従来の設定）
+    PROFILE_GAIT = 1,     // ±8g / ±2000dps / 1kHz / DLPF 176Hz（歩行: 速い動きと着地の衝撃）
+    PROFILE_BALANCE = 2,  // ±4g / ±500dps / 500Hz / DLPF 92Hz（バランス: ジャイロ分解能4倍）
+    PROFILE_IDLE = 3,     // ±8g / ±2000dps / 50Hz / DLPF 10Hz（待機: 取得・姿勢計算の負荷を1/10に）
+    PROFILE_COUNT
+  };
+  static const Config& profileConfig(Profile profile);
+  static const char* profileName(Profile profile);
+
+  /**
+   * 1サンプル分の生ADC値（0x3B～0x48 / FIFOフレームと同じ並び）
+   * 物理量への変換は getAccelRes() / getGyroRes() / rawToCelsius()
+   */
+  struct RawSample {
+    int16_t accel[3];
+    int16_t temp;
+    int16_t gyro[3];
+  };
+
   MPU6886();
 
   /**
@@ -64,14 +106,36 @@ public:
   void readGyro(float* gx, float* gy, float* gz);
   void readTemp(float* temp);
 
+  /**
+   * 加速度・温度・ジャイロ（0x3B～0x48 の14B）を1回のI2Cトランザクションで読む
+   * 3つを別々に読むより速く、同じサンプリング時点の値がそろう
+   */
+  void readRaw(RawSample* sample);
+  void readAll(float* ax, float* ay, float* az,
+               float* gx, float* gy, float* gz,
+               float* temp);
+
+  /**
+   * 温度の生値を °C に変換
+   */
+  static float rawToCelsius(int16_t raw) { return (float)raw / 326.8f + 25.0f; }
+
   /**
    * センサー範囲を設定
    */
   void setGyroScale(GyroScale scale);
   void setAccelScale(AccelScale scale);
 
+  /**
+   * レンジ・DLPF・ODR をまとめて設定（begin() 前なら begin() で書き込む）
+   * 前回から変わったレジスタだけを書き、待ち時間は入れない（次のサンプルから新しい設定になる）
+   */
+  void setConfig(const Config& config);
+  const Config& getConfig() const { return config_; }
+
   /**
    * FIFO操作
+   * setFIFOEnabled(true) で加速度+ジャイロ（温度込み14B/サンプル）をFIFOに積む
    */
   void setFIFOEnabled(bool enable);
   uint16_t getFIFOCount();
@@ -79,6 +143,22 @@ public:
   void readFIFOBuffer(uint8_t* buffer, uint16_t length);
   void resetFIFO();
 
+  /**
+   * FIFOの1フレーム（14B、0x3B～0x48 と同じ並び）を生ADC値に展開
+   */
+  static void decodeFrame(const uint8_t* frame, RawSample* sample);
+
+  /**
+   * 出力データレート（Hz）。SMPLRT_DIV から算出（1kHz / (1 + div)）
+   */
+  float getSampleRateHz() { return 1000.0f / (1 + config_.sampleRateDiv); }
+
+  /**
+   * データレディ割り込み（INTピン）の設定
+   * 有効時は 50us のパルス出力（ラッチなし）。エッジ割り込みでサンプルごとに起こせる
+   */
+  void setDataReadyInterrupt(bool enable);
+
   /**
    * ジャイロオフセットキャリブレーション
    */
@@ -100,14 +180,14 @@ private:
   uint8_t i2cAddress_;
   uint8_t deviceID_;
   
-  AccelScale accelScale_;
-  GyroScale gyroScale_;
+  Config config_;
   float accelRes_;
   float gyroRes_;
 
   void readBytes(uint8_t reg, uint8_t count, uint8_t* buffer);
   void writeBytes(uint8_t reg, uint8_t count, uint8_t* buffer);
   void writeByte(uint8_t reg, uint8_t value);
+  void writeConfig(const Config& config, bool force);
   void updateAccelRes();
   void updateGyroRes();
 };
@@ -5,13 +5,30 @@
 #include "MPU6886_AHRS.h"
 #include <Arduino.h>
 
+// バイアス信頼度が下がる時定数 [s]（静止しないまま動き続けた場合）
+static const float BIAS_CONFIDENCE_TAU = 600.0f;
+// 静止中の平均がこれ以上バイアスから離れていたら、ゆっくりした旋回とみなして使わない [deg/s]
+// （信頼度が低いほど広げる。信頼度 0 で 5 倍）
+static const float BIAS_MAX_STEP = 2.0f;
+
 MPU6886_AHRS::MPU6886_AHRS()
-  : accelX_(0), accelY_(0), accelZ_(0),
+  : filter_(&madgwick_), filterType_(FILTER_MADGWICK),
+    sampleRateHz_(100.0f), filterGain_(0.4f), profile_(MPU6886::PROFILE_DEFAULT),
+    accelX_(0), accelY_(0), accelZ_(0),
     gyroX_(0), gyroY_(0), gyroZ_(0),
-    temp_(0),
+    temp_(0), raw_(),
     gyroBiasX_(0), gyroBiasY_(0), gyroBiasZ_(0),
     roll_(0), pitch_(0), yaw_(0),
-    lastUpdateMicros_(0) {
+    lastUpdateMicros_(0),
+    fifoMode_(false), fifoStats_(),
+    sampleCallback_(nullptr), sampleCallbackCtx_(nullptr),
+    calState_(CAL_IDLE), calTarget_(0), calCount_(0), calMaxVar_(0),
+    calMean_(), calM2_(), calAccelMean_(),
+    biasTracking_(MPU6886_AHRS_BIAS_TRACKING != 0), stationary_(false),
+    biasTau_(10.0f), biasConfidence_(0.0f),
+    stillAccelDev_(0.02f), stillGyroStd_(0.25f), stillRes_(0.0f) {
+  setFilterType((FilterType)MPU6886_AHRS_DEFAULT_FILTER);
+  resetStillWindow();
 }
 
 int MPU6886_AHRS::begin(TwoWire* wire, uint8_t address,
@@ -22,13 +39,51 @@ int MPU6886_AHRS::begin(TwoWire* wire, uint8_t address,
   }
 
   // フィルタを初期化
-  filter_.begin(sampleRateHz);
-  filter_.setGain(filterGain);
+  sampleRateHz_ = sampleRateHz;
+  filterGain_ = filterGain;
+  filter_->begin(sampleRateHz);
+  filter_->setGain(filterGain);
 
   lastUpdateMicros_ = micros();
   return 0;
 }
 
+void MPU6886_AHRS::setFilterType(FilterType type) {
+  switch (type) {
+    case FILTER_MAHONY:        filter_ = &mahony_; break;
+    case FILTER_COMPLEMENTARY: filter_ = &complementary_; break;
+    case FILTER_EKF:           filter_ = &ekf_; break;
+    default:                   type = FILTER_MADGWICK; filter_ = &madgwick_; break;
+  }
+  filterType_ = type;
+  filter_->begin(sampleRateHz_);
+  filter_->setGain(filterGain_);
+  filter_->reset();
+}
+
+void MPU6886_AHRS::setProfile(MPU6886::Profile profile) {
+  if (profile >= MPU6886::PROFILE_COUNT) profile = MPU6886::PROFILE_DEFAULT;
+  sensor_.setConfig(MPU6886::profileConfig(profile));
+  profile_ = profile;
+  // 旧設定（レンジ）で積まれたサンプルを新しいレンジで読み違えないように捨てる
+  if (fifoMode_) {
+    sensor_.resetFIFO();
+  }
+  sampleRateHz_ = sensor_.getSampleRateHz();
+  filter_->begin(sampleRateHz_);
+  lastUpdateMicros_ = micros();
+}
+
+const char* MPU6886_AHRS::filterName(FilterType type) {
+  switch (type) {
+    case FILTER_MADGWICK:      return "Madgwick";
+    case FILTER_MAHONY:        return "Mahony";
+    case FILTER_COMPLEMENTARY: return "Complementary";
+    case FILTER_EKF:           return "EKF6";
+    default:                   return "?";
+  }
+}
+
 void MPU6886_AHRS::calibrateGyro(int samples) {
   float sumX = 0, sumY = 0, sumZ = 0;
 
@@ -44,32 +99,267 @@ void MPU6886_AHRS::calibrateGyro(int samples) {
   gyroBiasX_ = sumX / samples;
   gyroBiasY_ = sumY / samples;
   gyroBiasZ_ = sumZ / samples;
+  biasConfidence_ = 1.0f;
+  resetStillWindow();
+
+  // 校正中にたまった（あふれた）FIFOは捨てる
+  if (fifoMode_) {
+    sensor_.resetFIFO();
+  }
+}
+
+void MPU6886_AHRS::startCalibration(uint16_t samples, float maxStdDps) {
+  if (samples < 2) samples = 2;
+  calState_ = CAL_IDLE;  // 集計中の update() に途中の値を使わせない
+  calCount_ = 0;
+  for (int i = 0; i < 3; i++) {
+    calMean_[i] = 0.0f;
+    calM2_[i] = 0.0f;
+    calAccelMean_[i] = 0.0f;
+  }
+  calTarget_ = samples;
+  calMaxVar_ = maxStdDps * maxStdDps;
+  calState_ = CAL_RUNNING;
+}
+
+void MPU6886_AHRS::cancelCalibration() {
+  if (calState_ == CAL_RUNNING) calState_ = CAL_ABORTED;
+}
+
+void MPU6886_AHRS::stepCalibration() {
+  if (calState_ != CAL_RUNNING) return;
+  const float g[3] = { gyroX_, gyroY_, gyroZ_ };
+  const float a[3] = { accelX_, accelY_, accelZ_ };
+  uint16_t n = calCount_ + 1;
+  for (int i = 0; i < 3; i++) {
+    float d = g[i] - calMean_[i];
+    calMean_[i] += d / n;
+    calM2_[i] += d * (g[i] - calMean_[i]);
+    calAccelMean_[i] += (a[i] - calAccelMean_[i]) / n;
+  }
+  calCount_ = n;
+
+  // ある程度たまってから動き（分散の増加）を判定
+  if (n >= 20) {
+    for (int i = 0; i < 3; i++) {
+      if (calM2_[i] / (n - 1) > calMaxVar_) {
+        calState_ = CAL_ABORTED;
+        return;
+      }
+    }
+  }
+  if (n >= calTarget_) {
+    // 3軸まとめて差し替え（このサンプル以降は新しいバイアスで補正）
+    gyroBiasX_ = calMean_[0];
+    gyroBiasY_ = calMean_[1];
+    gyroBiasZ_ = calMean_[2];
+    biasConfidence_ = 1.0f;
+    calState_ = CAL_DONE;
+  }
+}
+
+bool MPU6886_AHRS::getCalibrationTilt(float* roll, float* pitch) const {
+  if (calState_ != CAL_DONE) return false;
+  // 姿勢フィルタ（ZYX オイラー角）が重力方向に収束したときと同じ定義
+  float ax = calAccelMean_[0], ay = calAccelMean_[1], az = calAccelMean_[2];
+  *roll = atan2f(ay, az) * 57.29578f;
+  *pitch = atan2f(-ax, sqrtf(ay * ay + az * az)) * 57.29578f;
+  return true;
+}
+
+void MPU6886_AHRS::setBiasTracking(bool enable, float tauSec) {
+  biasTau_ = (tauSec > 0.1f) ? tauSec : 0.1f;
+  biasTracking_ = enable;
+  resetStillWindow();
+}
+
+void MPU6886_AHRS::setStationaryThresholds(float accelDevG, float gyroStdDps) {
+  stillAccelDev_ = accelDevG;
+  stillGyroStd_ = gyroStdDps;
+}
+
+void MPU6886_AHRS::resetStillWindow() {
+  stillIndex_ = 0;
+  stillCount_ = 0;
+  stillMovingCount_ = 0;
+  for (int i = 0; i < 3; i++) {
+    stillSum_[i] = 0;
+    stillSumSq_[i] = 0;
+  }
+  stationary_ = false;
+}
+
+void MPU6886_AHRS::trackBias(float dtSec) {
+  // 静止できない間は信頼度を下げていく
+  biasConfidence_ -= biasConfidence_ * dtSec / BIAS_CONFIDENCE_TAU;
+  if (!biasTracking_) return;
+
+  // レンジが変わったら生値の比較ができないのでやり直し
+  const float res = sensor_.getGyroRes();
+  if (res != stillRes_) {
+    resetStillWindow();
+    stillRes_ = res;
+  }
+
+  // ウィンドウから一番古いサンプルを抜いて新しいサンプルを入れる
+  const int W = MPU6886_AHRS_STILL_WINDOW;
+  int16_t* slot = stillGyro_[stillIndex_];
+  if (stillCount_ == W) {
+    for (int i = 0; i < 3; i++) {
+      stillSum_[i] -= slot[i];
+      stillSumSq_[i] -= (int32_t)slot[i] * slot[i];
+    }
+    if (stillMoving_[stillIndex_]) stillMovingCount_--;
+  } else {
+    stillCount_++;
+  }
+  for (int i = 0; i < 3; i++) {
+    slot[i] = raw_.gyro[i];
+    stillSum_[i] += slot[i];
+    stillSumSq_[i] += (int32_t)slot[i] * slot[i];
+  }
+  // |a| が 1g から外れたサンプル（sqrt を避けて二乗で比較）
+  float norm2 = accelX_ * accelX_ + accelY_ * accelY_ + accelZ_ * accelZ_;
+  float lo = 1.0f - stillAccelDev_, hi = 1.0f + stillAccelDev_;
+  bool moving = (norm2 < lo * lo) || (norm2 > hi * hi);
+  stillMoving_[stillIndex_] = moving;
+  if (moving) stillMovingCount_++;
+  stillIndex_ = (stillIndex_ + 1) % W;
+
+  stationary_ = false;
+  if (stillCount_ < W || stillMovingCount_ > 0 || calState_ == CAL_RUNNING) return;
+
+  // 分散 × W^2 = W·Σx² − (Σx)²（整数で厳密に計算）
+  const float maxVar = (stillGyroStd_ / res) * (stillGyroStd_ / res) * W * W;
+  const float bias[3] = { gyroBiasX_, gyroBiasY_, gyroBiasZ_ };
+  const float maxStep = BIAS_MAX_STEP / (biasConfidence_ > 0.2f ? biasConfidence_ : 0.2f);
+  float mean[3];
+  for (int i = 0; i < 3; i++) {
+    int64_t v = (int64_t)W * stillSumSq_[i] - (int64_t)stillSum_[i] * stillSum_[i];
+    if ((float)v > maxVar) return;
+    mean[i] = stillSum_[i] * res / W;
+    if (fabsf(mean[i] - bias[i]) > maxStep) return;
+  }
+  stationary_ = true;
+
+  // 静止中は平均ジャイロ（= バイアス）へ一次遅れで近づける
+  float k = dtSec / biasTau_;
+  if (k > 1.0f) k = 1.0f;
+  gyroBiasX_ += (mean[0] - gyroBiasX_) * k;
+  gyroBiasY_ += (mean[1] - gyroBiasY_) * k;
+  gyroBiasZ_ += (mean[2] - gyroBiasZ_) * k;
+  biasConfidence_ += (1.0f - biasConfidence_) * k;
+}
+
+void MPU6886_AHRS::setFifoMode(bool enable) {
+  if (enable == fifoMode_) return;
+  sensor_.setFIFOEnabled(enable);
+  if (enable) {
+    sensor_.resetFIFO();
+  }
+  fifoMode_ = enable;
+  lastUpdateMicros_ = micros();
+}
+
+void MPU6886_AHRS::setSample(const MPU6886::RawSample& sample) {
+  const float accelRes = sensor_.getAccelRes();
+  const float gyroRes = sensor_.getGyroRes();
+  raw_ = sample;
+  accelX_ = sample.accel[0] * accelRes;
+  accelY_ = sample.accel[1] * accelRes;
+  accelZ_ = sample.accel[2] * accelRes;
+  gyroX_ = sample.gyro[0] * gyroRes;
+  gyroY_ = sample.gyro[1] * gyroRes;
+  gyroZ_ = sample.gyro[2] * gyroRes;
+  temp_ = MPU6886::rawToCelsius(sample.temp);
+}
+
+void MPU6886_AHRS::updateFromFifo() {
+  uint16_t count = sensor_.getFIFOCount();
+
+  // あふれると古いデータが上書きされフレーム境界がずれるので、リセットして捨てる
+  if (count + MPU6886_FIFO_FRAME_LEN > MPU6886_FIFO_SIZE) {
+    sensor_.resetFIFO();
+    fifoStats_.overflows++;
+    fifoStats_.lastBatch = 0;
+    return;
+  }
+
+  uint16_t frames = count / MPU6886_FIFO_FRAME_LEN;
+  fifoStats_.lastBatch = frames;
+  if (frames == 0) return;
+  if (frames > fifoStats_.maxBatch) fifoStats_.maxBatch = frames;
+
+  const float dtSec = 1.0f / sensor_.getSampleRateHz();
+  uint8_t buf[MPU6886_I2C_READ_MAX];
+  MPU6886::RawSample sample;
+  // 最後のフレームを読み出し時刻とし、それより前は ODR 周期ずつ遡った時刻とみなす
+  const uint32_t dtUs = (uint32_t)(dtSec * 1.0e6f);
+  uint32_t tUs = micros() - (uint32_t)(frames - 1) * dtUs;
+
+  // I2Cバッファに収まる単位でまとめて読み、1サンプルずつフィルタへ
+  while (frames > 0) {
+    uint16_t n = frames;
+    if (n > MPU6886_I2C_READ_MAX / MPU6886_FIFO_FRAME_LEN) {
+      n = MPU6886_I2C_READ_MAX / MPU6886_FIFO_FRAME_LEN;
+    }
+    sensor_.readFIFOBuffer(buf, n * MPU6886_FIFO_FRAME_LEN);
+    for (uint16_t i = 0; i < n; i++) {
+      MPU6886::decodeFrame(&buf[i * MPU6886_FIFO_FRAME_LEN], &sample);
+      setSample(sample);
+      stepCalibration();
+      trackBias(dtSec);
+      filter_->update(gyroX_ - gyroBiasX_, gyroY_ - gyroBiasY_, gyroZ_ - gyroBiasZ_,
+                     accelX_, accelY_, accelZ_,
+                     dtSec);
+      if (sampleCallback_) sampleCallback_(sampleCallbackCtx_, tUs);
+      tUs += dtUs;
+    }
+    fifoStats_.samples += n;
+    frames -= n;
+  }
+  lastUpdateMicros_ = micros();
+
+  // 姿勢はまとめて処理した後に1回だけ計算
+  roll_ = filter_->getRoll();
+  pitch_ = filter_->getPitch();
+  yaw_ = filter_->getYaw();
 }
 
 void MPU6886_AHRS::update() {
-  // センサーデータを読み取る
-  sensor_.readAccel(&accelX_, &accelY_, &accelZ_);
-  sensor_.readGyro(&gyroX_, &gyroY_, &gyroZ_);
-  sensor_.readTemp(&temp_);
+  if (fifoMode_) {
+    updateFromFifo();
+    return;
+  }
+  updateAt(micros());
+}
+
+void MPU6886_AHRS::updateAt(uint32_t sampleMicros) {
+  // センサーデータを読み取る（加速度・温度・ジャイロを1トランザクションで）
+  MPU6886::RawSample sample;
+  sensor_.readRaw(&sample);
+  setSample(sample);
+  stepCalibration();
+
+  // デルタ時間を計算（サンプル時刻の差）
+  float dtSec = (lastUpdateMicros_ == 0) ? 0.01f 
+                : (sampleMicros - lastUpdateMicros_) * 1.0e-6f;
+  lastUpdateMicros_ = sampleMicros;
+  trackBias(dtSec);
 
   // ジャイロバイアス補正を適用
   float correctedGx = gyroX_ - gyroBiasX_;
   float correctedGy = gyroY_ - gyroBiasY_;
   float correctedGz = gyroZ_ - gyroBiasZ_;
 
-  // デルタ時間を計算
-  uint32_t now = micros();
-  float dtSec = (lastUpdateMicros_ == 0) ? 0.01f 
-                : (now - lastUpdateMicros_) * 1.0e-6f;
-  lastUpdateMicros_ = now;
-
   // フィルタを更新
-  filter_.update(correctedGx, correctedGy, correctedGz,
+  filter_->update(correctedGx, correctedGy, correctedGz,
                  accelX_, accelY_, accelZ_,
                  dtSec);
+  if (sampleCallback_) sampleCallback_(sampleCallbackCtx_, sampleMicros);
 
   // 姿勢を取得
-  roll_ = filter_.getRoll();
-  pitch_ = filter_.getPitch();
-  yaw_ = filter_.getYaw();
+  roll_ = filter_->getRoll();
+  pitch_ = filter_->getPitch();
+  yaw_ = filter_->getYaw();
 }
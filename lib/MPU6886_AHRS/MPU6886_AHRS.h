@@ -1,6 +1,6 @@
 /**
  * MPU6886 AHRS - 高レベル姿勢追跡クラス
- * MPU6886センサードライバとMadgwickフィルタを組み合わせ
+ * MPU6886センサードライバと姿勢フィルタ（Madgwick / Mahony / 相補 / EKF）を組み合わせ
  * 姿勢推定のための使いやすいAPIを提供
  */
 
@@ -9,6 +9,24 @@
 
 #include "MPU6886.h"
 #include "MadgwickAHRS.h"
+#include "MahonyAHRS.h"
+#include "ComplementaryFilter.h"
+#include "Ekf6AHRS.h"
+
+// 起動時の姿勢フィルタ（MPU6886_AHRS::FilterType の値。ビルドフラグで変更可）
+#ifndef MPU6886_AHRS_DEFAULT_FILTER
+#define MPU6886_AHRS_DEFAULT_FILTER 0
+#endif
+
+// 静止検出によるジャイロバイアス追従（1で有効）
+#ifndef MPU6886_AHRS_BIAS_TRACKING
+#define MPU6886_AHRS_BIAS_TRACKING 1
+#endif
+
+// 静止判定のスライディングウィンドウ長（サンプル数。500Hz で 128 なら約0.26秒）
+#ifndef MPU6886_AHRS_STILL_WINDOW
+#define MPU6886_AHRS_STILL_WINDOW 128
+#endif
 
 /**
  * オールインワンIMU姿勢トラッカー
@@ -16,6 +34,37 @@
  */
 class MPU6886_AHRS {
 public:
+  /**
+   * FIFO取得モードの統計
+   */
+  struct FifoStats {
+    uint32_t samples;    // フィルタに入れたサンプル数
+    uint32_t overflows;  // FIFOあふれ（リセット）回数
+    uint16_t lastBatch;  // 直近の update() で処理したサンプル数
+    uint16_t maxBatch;   // 1回の update() で処理した最大サンプル数
+  };
+
+  /**
+   * 非ブロッキング校正の状態
+   */
+  enum CalibrationState : uint8_t {
+    CAL_IDLE = 0,     // 未実行
+    CAL_RUNNING = 1,  // サンプル収集中
+    CAL_DONE = 2,     // 完了（新しいバイアスを適用済み）
+    CAL_ABORTED = 3,  // 動きを検出して中止（バイアスは変更なし）
+  };
+
+  /**
+   * 姿勢フィルタの種類
+   */
+  enum FilterType : uint8_t {
+    FILTER_MADGWICK = 0,       // 既定
+    FILTER_MAHONY = 1,         // 比例 + 積分（残留バイアスを吸収）
+    FILTER_COMPLEMENTARY = 2,  // 最も軽い。大きな傾きでの速い回転に弱い
+    FILTER_EKF = 3,            // 6状態EKF（姿勢 + ジャイロバイアス）。最も重い
+    FILTER_COUNT
+  };
+
   MPU6886_AHRS();
 
   /**
@@ -23,7 +72,7 @@ public:
    * @param wire I2Cバスへのポインタ (デフォルト: &Wire)
    * @param address I2Cアドレス (デフォルト: 0x68)
    * @param sampleRateHz フィルタ更新レート (デフォルト: 100)
-   * @param filterGain Madgwickゲイン (デフォルト: 0.4)
+   * @param filterGain フィルタゲイン (デフォルト: 0.4)
    * @return 成功時0、失敗時-1
    */
   int begin(TwoWire* wire = &Wire,
@@ -33,16 +82,71 @@ public:
 
   /**
    * ジャイロスコープバイアスをキャリブレート（デバイスは静止状態を維持）
+   * 完了まで戻らない（samples × 5ms）。動作中は startCalibration() を使う
    * @param samples 平均化するサンプル数 (デフォルト: 200)
    */
   void calibrateGyro(int samples = 200);
 
+  /**
+   * 非ブロッキングのジャイロ校正を開始
+   * 以降の update() で取得した各サンプルを集計し、samples 個集まったら平均を新しいバイアスとして
+   * 3軸まとめて差し替える（途中のサンプルは従来のバイアスで補正）。
+   * 集計中にどれかの軸の標準偏差が maxStdDps を超えたら動いたとみなして中止する。
+   * update() と同じタスクから呼ぶか、別タスクで update() している場合はそのタスクを止めてから呼ぶこと。
+   * @param samples 平均化するサンプル数（500Hz FIFOモードで 500 なら約1秒）
+   * @param maxStdDps 静止とみなすジャイロ標準偏差の上限 (deg/s)
+   */
+  void startCalibration(uint16_t samples = 500, float maxStdDps = 1.0f);
+  void cancelCalibration();
+  CalibrationState getCalibrationState() const { return calState_; }
+  /**
+   * 校正の進捗（0.0～1.0）
+   */
+  float getCalibrationProgress() const {
+    return calTarget_ ? (float)calCount_ / calTarget_ : 0.0f;
+  }
+  /**
+   * 校正中の加速度の平均から求めた傾き（度）。CAL_DONE のときだけ true を返す
+   * 校正直後のフィルタは収束途中のことがあるので、ゼロ点はこちらを使う
+   */
+  bool getCalibrationTilt(float* roll, float* pitch) const;
+
   /**
    * 姿勢を更新（ループ内で呼び出す）
-   * 前回の更新からのdtを自動的に計算
+   * 通常モード: 最新値を1回読み、前回の更新からのdtを自動的に計算
+   * FIFOモード: たまっている全サンプルをODR周期のdtでフィルタに入れる
    */
   void update();
 
+  /**
+   * 1サンプル読んで姿勢を更新（FIFOモードでは使わない）
+   * dt はサンプル時刻 sampleMicros（データレディ割り込み時の micros() など）の差から計算
+   */
+  void updateAt(uint32_t sampleMicros);
+
+  /**
+   * FIFO取得モードの切り替え
+   * 有効にするとセンサーのODR（500Hz）の全サンプルをFIFO経由で取得する。
+   * ループ周期が揺れてもサンプルを取りこぼさず、dtも正確になる。
+   * FIFOがあふれた（約140ms以上 update() しなかった）場合はリセットして次から再開する。
+   */
+  void setFifoMode(bool enable);
+  bool isFifoMode() const { return fifoMode_; }
+  const FifoStats& fifoStats() const { return fifoStats_; }
+
+  /**
+   * 1サンプルごとの通知（フィルタ更新の直後に update() / updateAt() の中から呼ばれる）
+   * FIFOモードでまとめて処理する場合も全サンプル分呼ばれる。tUs はサンプル時刻の推定
+   * （FIFOモードでは読み出し時刻から ODR 周期で遡った値）。コールバック内では getAccel() /
+   * getRawGyro() / getGyroBias() と filter() の姿勢がそのサンプル時点の値を返す。
+   * 重い処理はせず、キューへ積む程度にすること。nullptr で解除
+   */
+  typedef void (*SampleCallback)(void* ctx, uint32_t tUs);
+  void setSampleCallback(SampleCallback fn, void* ctx) {
+    sampleCallback_ = fn;
+    sampleCallbackCtx_ = ctx;
+  }
+
   /**
    * 姿勢角を取得（度数法）
    */
@@ -61,50 +165,144 @@ public:
     *gy = gyroY_ - gyroBiasY_;
     *gz = gyroZ_ - gyroBiasZ_;
   }
+  void getRawGyro(float* gx, float* gy, float* gz) {
+    *gx = gyroX_; *gy = gyroY_; *gz = gyroZ_;
+  }
   void getTemp(float* temp) { *temp = temp_; }
   float getTemperature() { return temp_; }
 
+  /**
+   * 直近の update() で取得した生ADC値（浮動小数点を使わない処理向け）
+   */
+  const MPU6886::RawSample& getRawSample() const { return raw_; }
+
   /**
    * ジャイロバイアス値を取得
+   * confidence: バイアスの信頼度（0.0～1.0）。校正完了で1、静止中の追従で上がり、
+   * 静止しない時間が続くと下がる（温度変化でずれていくため）
    */
   void getGyroBias(float* bx, float* by, float* bz) {
     *bx = gyroBiasX_; *by = gyroBiasY_; *bz = gyroBiasZ_;
   }
+  void getGyroBias(float* bx, float* by, float* bz, float* confidence) {
+    *bx = gyroBiasX_; *by = gyroBiasY_; *bz = gyroBiasZ_;
+    *confidence = biasConfidence_;
+  }
   float getGyroBiasX() { return gyroBiasX_; }
   float getGyroBiasY() { return gyroBiasY_; }
   float getGyroBiasZ() { return gyroBiasZ_; }
+  float getGyroBiasConfidence() { return biasConfidence_; }
 
   /**
    * ジャイロバイアスを手動で設定
    */
-  void setGyroBias(float bx, float by, float bz) {
+  void setGyroBias(float bx, float by, float bz, float confidence = 1.0f) {
     gyroBiasX_ = bx; gyroBiasY_ = by; gyroBiasZ_ = bz;
+    biasConfidence_ = confidence;
   }
 
+  /**
+   * 静止検出によるバイアス追従（動作中の温度ドリフト対策）
+   * 直近 MPU6886_AHRS_STILL_WINDOW サンプルの全てで |a| が 1g ± accelDevG 以内、
+   * かつジャイロの標準偏差が全軸 gyroStdDps 以下なら静止とみなし、
+   * その間の平均ジャイロへバイアスを時定数 tauSec でゆっくり近づける。
+   * 校正（startCalibration）の実行中は追従しない。
+   */
+  void setBiasTracking(bool enable, float tauSec = 10.0f);
+  bool isBiasTracking() const { return biasTracking_; }
+  void setStationaryThresholds(float accelDevG, float gyroStdDps);
+  bool isStationary() const { return stationary_; }
+
   /**
    * 姿勢を初期状態にリセット
    */
-  void resetOrientation() { filter_.reset(); }
+  void resetOrientation() { filter_->reset(); }
 
   /**
    * 内部センサーとフィルタへのアクセス
    */
   MPU6886& sensor() { return sensor_; }
-  MadgwickAHRS& filter() { return filter_; }
+  AttitudeFilter& filter() { return *filter_; }
+
+  /**
+   * 姿勢フィルタを切り替え（begin() 前後どちらでもよい）
+   * 新しいフィルタはサンプルレートとゲインを引き継ぎ、姿勢は初期状態から収束し直す
+   */
+  void setFilterType(FilterType type);
+  FilterType getFilterType() const { return filterType_; }
+  static const char* filterName(FilterType type);
+
+  /**
+   * センサー設定のプロファイルを切り替え（begin() 前後どちらでもよい、動作中も可）
+   * FIFOに残った旧設定のサンプルは捨てる。ジャイロバイアス（deg/s）はそのまま引き継ぐ
+   */
+  void setProfile(MPU6886::Profile profile);
+  MPU6886::Profile getProfile() const { return profile_; }
+
+  /**
+   * フィルタ固有の設定用
+   */
+  MahonyAHRS& mahony() { return mahony_; }
+  Ekf6AHRS& ekf() { return ekf_; }
 
 private:
+  void updateFromFifo();
+  void setSample(const MPU6886::RawSample& sample);
+  void stepCalibration();
+  void trackBias(float dtSec);
+  void resetStillWindow();
+
   MPU6886 sensor_;
-  MadgwickAHRS filter_;
+  MadgwickAHRS madgwick_;
+  MahonyAHRS mahony_;
+  ComplementaryFilter complementary_;
+  Ekf6AHRS ekf_;
+  AttitudeFilter* filter_;
+  FilterType filterType_;
+  float sampleRateHz_;
+  float filterGain_;
+  MPU6886::Profile profile_;
 
   float accelX_, accelY_, accelZ_;
   float gyroX_, gyroY_, gyroZ_;
   float temp_;
+  MPU6886::RawSample raw_;
 
   float gyroBiasX_, gyroBiasY_, gyroBiasZ_;
 
   float roll_, pitch_, yaw_;
 
   uint32_t lastUpdateMicros_;
+
+  bool fifoMode_;
+  FifoStats fifoStats_;
+  SampleCallback sampleCallback_;
+  void* sampleCallbackCtx_;
+
+  // 非ブロッキング校正（平均・分散は Welford 法で逐次計算）
+  volatile CalibrationState calState_;
+  uint16_t calTarget_;
+  volatile uint16_t calCount_;
+  float calMaxVar_;
+  float calMean_[3];
+  float calM2_[3];
+  float calAccelMean_[3];
+
+  // 静止検出（ウィンドウは生ADC値で持ち、和・二乗和を整数で差分更新）
+  bool biasTracking_;
+  bool stationary_;
+  float biasTau_;
+  float biasConfidence_;
+  float stillAccelDev_;
+  float stillGyroStd_;
+  float stillRes_;
+  int16_t stillGyro_[MPU6886_AHRS_STILL_WINDOW][3];
+  bool stillMoving_[MPU6886_AHRS_STILL_WINDOW];
+  uint16_t stillIndex_;
+  uint16_t stillCount_;
+  uint16_t stillMovingCount_;
+  int32_t stillSum_[3];
+  int64_t stillSumSq_[3];
 };
 
 #endif // MPU6886_AHRS_H
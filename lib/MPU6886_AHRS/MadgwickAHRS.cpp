@@ -4,26 +4,6 @@
 
 #include "MadgwickAHRS.h"
 
-MadgwickAHRS::MadgwickAHRS()
-  : q0_(1.0f), q1_(0.0f), q2_(0.0f), q3_(0.0f),
-    beta_(0.1f), invSampleFreq_(0.01f) {
-}
-
-void MadgwickAHRS::begin(float sampleRateHz) {
-  invSampleFreq_ = 1.0f / sampleRateHz;
-}
-
-float MadgwickAHRS::invSqrt(float x) {
-  // 高速逆平方根（Quake IIIアルゴリズム）
-  float halfx = 0.5f * x;
-  float y = x;
-  long i = *(long*)&y;
-  i = 0x5f3759df - (i >> 1);
-  y = *(float*)&i;
-  y = y * (1.5f - (halfx * y * y));
-  return y;
-}
-
 void MadgwickAHRS::update(float gx, float gy, float gz,
                           float ax, float ay, float az,
                           float dtSec) {
@@ -32,31 +12,26 @@ void MadgwickAHRS::update(float gx, float gy, float gz,
   gy *= 0.01745329f;
   gz *= 0.01745329f;
 
-  // 加速度計計測を正規化
-  float norm = invSqrt(ax * ax + ay * ay + az * az);
-  ax *= norm;
-  ay *= norm;
-  az *= norm;
-
-  // 推定重力方向（半分）
-  float halfvx = q1_ * q3_ - q0_ * q2_;
-  float halfvy = q0_ * q1_ + q2_ * q3_;
-  float halfvz = q0_ * q0_ - 0.5f + q3_ * q3_;
-
-  // 誤差は推定重力と計測重力の外積
-  float halfex = (ay * halfvz - az * halfvy);
-  float halfey = (az * halfvx - ax * halfvz);
-  float halfez = (ax * halfvy - ay * halfvx);
-
-  // フィードバックゲインを適用
-  halfex *= beta_;
-  halfey *= beta_;
-  halfez *= beta_;
-
-  // フィードバックをジャイロレートに統合
-  gx += 2.0f * halfex;
-  gy += 2.0f * halfey;
-  gz += 2.0f * halfez;
+  // 加速度が0（自由落下・読み出し失敗）のときは補正せずジャイロだけで積分
+  float norm = ax * ax + ay * ay + az * az;
+  if (norm > 0.0f) {
+    // 加速度計計測を正規化
+    norm = invSqrt(norm);
+    ax *= norm;
+    ay *= norm;
+    az *= norm;
+
+    // 推定重力方向（半分）
+    float halfvx = q1_ * q3_ - q0_ * q2_;
+    float halfvy = q0_ * q1_ + q2_ * q3_;
+    float halfvz = q0_ * q0_ - 0.5f + q3_ * q3_;
+
+    // 誤差は推定重力と計測重力の外積。フィードバックゲインを掛けてジャイロレートに統合
+    float k = 2.0f * beta_;
+    gx += k * (ay * halfvz - az * halfvy);
+    gy += k * (az * halfvx - ax * halfvz);
+    gz += k * (ax * halfvy - ay * halfvx);
+  }
 
   // クォータニオンレートを統合
   float halfdt = 0.5f * dtSec;
@@ -72,21 +47,5 @@ void MadgwickAHRS::update(float gx, float gy, float gz,
   q1_ = qb * norm;
   q2_ = qc * norm;
   q3_ = qd * norm;
-}
-
-float MadgwickAHRS::getRoll() {
-  float roll = atan2f(2.0f * (q0_ * q1_ + q2_ * q3_),
-                      1.0f - 2.0f * (q1_ * q1_ + q2_ * q2_));
-  return roll * 57.29578f;  // radをdegに変換
-}
-
-float MadgwickAHRS::getPitch() {
-  float pitch = asinf(2.0f * (q0_ * q2_ - q3_ * q1_));
-  return pitch * 57.29578f;  // radをdegに変換
-}
-
-float MadgwickAHRS::getYaw() {
-  float yaw = atan2f(2.0f * (q0_ * q3_ + q1_ * q2_),
-                     1.0f - 2.0f * (q2_ * q2_ + q3_ * q3_));
-  return yaw * 57.29578f;  // radをdegに変換
+  invalidateAngles();
 }
@@ -0,0 +1,75 @@
+/**
+ * Mahony AHRSアルゴリズム実装
+ */
+
+#include "MahonyAHRS.h"
+
+MahonyAHRS::MahonyAHRS()
+  : ki_(0.02f), integralX_(0.0f), integralY_(0.0f), integralZ_(0.0f) {
+}
+
+void MahonyAHRS::reset() {
+  AttitudeFilter::reset();
+  integralX_ = 0.0f;
+  integralY_ = 0.0f;
+  integralZ_ = 0.0f;
+}
+
+void MahonyAHRS::update(float gx, float gy, float gz,
+                        float ax, float ay, float az,
+                        float dtSec) {
+  // ジャイロをdeg/sからrad/sに変換
+  gx *= 0.01745329f;
+  gy *= 0.01745329f;
+  gz *= 0.01745329f;
+
+  float norm = ax * ax + ay * ay + az * az;
+  if (norm > 0.0f) {
+    // 加速度計計測を正規化
+    norm = invSqrt(norm);
+    ax *= norm;
+    ay *= norm;
+    az *= norm;
+
+    // 推定重力方向（半分）
+    float halfvx = q1_ * q3_ - q0_ * q2_;
+    float halfvy = q0_ * q1_ + q2_ * q3_;
+    float halfvz = q0_ * q0_ - 0.5f + q3_ * q3_;
+
+    // 誤差は推定重力と計測重力の外積
+    float halfex = (ay * halfvz - az * halfvy);
+    float halfey = (az * halfvx - ax * halfvz);
+    float halfez = (ax * halfvy - ay * halfvx);
+
+    // 積分項（残留バイアス）を更新して適用
+    if (ki_ > 0.0f) {
+      integralX_ += 2.0f * ki_ * halfex * dtSec;
+      integralY_ += 2.0f * ki_ * halfey * dtSec;
+      integralZ_ += 2.0f * ki_ * halfez * dtSec;
+      gx += integralX_;
+      gy += integralY_;
+      gz += integralZ_;
+    }
+
+    // 比例項
+    float kp = 2.0f * beta_;
+    gx += kp * halfex;
+    gy += kp * halfey;
+    gz += kp * halfez;
+  }
+
+  // クォータニオンレートを統合
+  float halfdt = 0.5f * dtSec;
+  float qa = q0_ + (-q1_ * gx - q2_ * gy - q3_ * gz) * halfdt;
+  float qb = q1_ + ( q0_ * gx + q3_ * gy - q2_ * gz) * halfdt;
+  float qc = q2_ + (-q3_ * gx + q0_ * gy + q1_ * gz) * halfdt;
+  float qd = q3_ + ( q2_ * gx - q1_ * gy + q0_ * gz) * halfdt;
+
+  // クォータニオンを正規化
+  norm = invSqrt(qa * qa + qb * qb + qc * qc + qd * qd);
+  q0_ = qa * norm;
+  q1_ = qb * norm;
+  q2_ = qc * norm;
+  q3_ = qd * norm;
+  invalidateAngles();
+}
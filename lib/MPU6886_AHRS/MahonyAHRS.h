@@ -0,0 +1,46 @@
+/**
+ * Mahony AHRSアルゴリズム（比例 + 積分）
+ * 6軸IMU（加速度計 + ジャイロ）用の姿勢フィルタ
+ */
+
+#ifndef MAHONY_AHRS_H
+#define MAHONY_AHRS_H
+
+#include "AttitudeFilter.h"
+
+/**
+ * Mahony姿勢フィルタ
+ * 重力方向の誤差を PI 制御でジャイロに戻す。積分項が残留ジャイロバイアス（roll/pitch 軸）を吸収する
+ * ゲイン: setGain() が比例ゲイン Kp/2（Madgwick の beta と同じ尺度）、setIntegralGain() が Ki
+ */
+class MahonyAHRS : public AttitudeFilter {
+public:
+  MahonyAHRS();
+
+  const char* name() const override { return "Mahony"; }
+
+  using AttitudeFilter::update;
+  void update(float gx, float gy, float gz,
+              float ax, float ay, float az,
+              float dtSec) override;
+
+  /**
+   * 積分ゲイン Ki を設定（0で積分なし）
+   */
+  void setIntegralGain(float ki) { ki_ = ki; }
+
+  /**
+   * 積分項（推定した残留バイアス、rad/s）を取得
+   */
+  void getIntegral(float* ix, float* iy, float* iz) {
+    *ix = integralX_; *iy = integralY_; *iz = integralZ_;
+  }
+
+  void reset() override;
+
+private:
+  float ki_;
+  float integralX_, integralY_, integralZ_;
+};
+
+#endif // MAHONY_AHRS_H
@@ -0,0 +1,196 @@
+/**
+ * MPU6886_AHRS例 - 姿勢フィルタの比較・処理時間の計測
+ *
+ * センサーなしで全フィルタ（Madgwick / Mahony / 相補 / EKF6）を同じデータで回し、次を表示します。
+ * - 1回あたりの処理時間（サイクル数、1kHz / 2kHz 更新時のCPU使用率の目安）
+ * - 収束時間: 水平から roll=20°, pitch=-10° の静止状態へ 1° 以内に入るまで
+ * - 静止ドリフト: ジャイロに 0.5deg/s のバイアスを乗せたまま 10～60 秒で roll/pitch が動いた量
+ * - 記録データ: SDに /bench.bin（フライトレコーダーのダンプ）があれば再生し、
+ *   Madgwick との roll/pitch の最大差を表示（歩行中の実データでの挙動比較）。
+ *   ダンプは IMU の全サンプル（500Hz）で、ジャイロはバイアス補正前の生値なので実機と同じ入力になる
+ * ゲインは全フィルタ共通で GAIN（MPU6886_AHRS::begin() の filterGain と同じ意味）。
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <SPI.h>
+#include "MadgwickAHRS.h"
+#include "MahonyAHRS.h"
+#include "ComplementaryFilter.h"
+#include "Ekf6AHRS.h"
+
+static const float GAIN = 0.1f;
+static const float DT = 0.002f;      // 500Hz（MPU6886 の ODR）
+static const float TILT_ROLL = 20.0f;
+static const float TILT_PITCH = -10.0f;
+static const float GYRO_BIAS = 0.5f;  // deg/s
+
+// M5CoreS3 の microSD（他のボードはピンを合わせる）
+static const int SD_SCK = 12, SD_MISO = 13, SD_MOSI = 11, SD_CS = 4;
+
+// フライトレコーダーのレコード（src/system/FlightRecorder.h と同じ並び、40B）
+struct __attribute__((packed)) Record {
+  uint32_t tUs;
+  int16_t acc[3];     // [g × 4096]
+  int16_t gyro[3];    // [deg/s × 16]（バイアス補正前）
+  int16_t euler[3];
+  uint16_t servo[8];
+  uint16_t loopUs;    // 書き込んだ loop() の周期
+};
+static const int REC_HEADER_LEN = 32;
+static const int MAX_RECORDS = 32768;  // 1.3MB、500Hz で約65秒（PSRAM があれば確保）
+
+MadgwickAHRS madgwick;
+MahonyAHRS mahony;
+ComplementaryFilter complementary;
+Ekf6AHRS ekf;
+AttitudeFilter* filters[] = { &madgwick, &mahony, &complementary, &ekf };
+static const int FILTER_COUNT = sizeof(filters) / sizeof(filters[0]);
+
+volatile float sink;  // 最適化で計算が消えないように
+
+// 再現性のある簡易乱数（-1～1）
+static uint32_t rng = 1;
+static float noise() {
+  rng = rng * 1664525u + 1013904223u;
+  return (float)(int32_t)rng / 2147483648.0f;
+}
+
+// 傾いて静止した状態の加速度
+static void tiltAccel(float* a) {
+  float r = TILT_ROLL * 0.01745329f, p = TILT_PITCH * 0.01745329f;
+  a[0] = -sinf(p);
+  a[1] = sinf(r) * cosf(p);
+  a[2] = cosf(r) * cosf(p);
+}
+
+// 処理時間（サイクル/回）。揺れながら傾く合成データ
+static float measureCycles(AttitudeFilter* f) {
+  const int n = 2000;
+  f->reset();
+  uint32_t total = 0;
+  for (int i = 0; i < n; i++) {
+    float t = i * DT;
+    float gx = 90.0f * sinf(t * 3.0f), gy = 40.0f * cosf(t * 1.7f), gz = 10.0f * sinf(t);
+    float ax = 0.3f * sinf(t), ay = 0.2f * cosf(t * 2.0f), az = 0.95f + 0.05f * sinf(t * 5.0f);
+    uint32_t c0 = ESP.getCycleCount();
+    f->update(gx, gy, gz, ax, ay, az, DT);
+    sink = f->getRoll() + f->getPitch();
+    total += ESP.getCycleCount() - c0;
+  }
+  return (float)total / n;
+}
+
+// 収束時間[s]（収束しなければ -1）と 10～60 秒の静止ドリフト
+static void staticRun(AttitudeFilter* f, float* convSec, float* driftRoll, float* driftPitch) {
+  float a[3];
+  tiltAccel(a);
+  f->reset();
+  rng = 1;
+  *convSec = -1.0f;
+  float roll10 = 0, pitch10 = 0;
+  const int n = (int)(60.0f / DT);
+  for (int i = 0; i < n; i++) {
+    f->update(GYRO_BIAS + 0.05f * noise(), GYRO_BIAS + 0.05f * noise(), 0.05f * noise(),
+              a[0] + 0.01f * noise(), a[1] + 0.01f * noise(), a[2] + 0.01f * noise(), DT);
+    float roll = f->getRoll(), pitch = f->getPitch();
+    if (*convSec < 0 && fabsf(roll - TILT_ROLL) < 1.0f && fabsf(pitch - TILT_PITCH) < 1.0f) {
+      *convSec = i * DT;
+    }
+    if (i == (int)(10.0f / DT)) { roll10 = roll; pitch10 = pitch; }
+  }
+  *driftRoll = f->getRoll() - roll10;
+  *driftPitch = f->getPitch() - pitch10;
+}
+
+// 記録データを全フィルタで再生し、Madgwick（filters[0]）との最大差を出す
+static void replay(const Record* recs, int count) {
+  for (int k = 0; k < FILTER_COUNT; k++) filters[k]->reset();
+  float maxDiff[FILTER_COUNT] = { 0 };
+  for (int i = 1; i < count; i++) {
+    float dt = (recs[i].tUs - recs[i - 1].tUs) * 1.0e-6f;
+    if (dt <= 0.0f || dt > 0.1f) dt = DT;
+    float gx = recs[i].gyro[0] / 16.0f, gy = recs[i].gyro[1] / 16.0f, gz = recs[i].gyro[2] / 16.0f;
+    float ax = recs[i].acc[0] / 4096.0f, ay = recs[i].acc[1] / 4096.0f, az = recs[i].acc[2] / 4096.0f;
+    for (int k = 0; k < FILTER_COUNT; k++) {
+      filters[k]->update(gx, gy, gz, ax, ay, az, dt);
+    }
+    // 最初の2秒は収束待ちとして比較しない
+    if (recs[i].tUs - recs[0].tUs < 2000000) continue;
+    for (int k = 1; k < FILTER_COUNT; k++) {
+      float d = fmaxf(fabsf(filters[k]->getRoll() - filters[0]->getRoll()),
+                      fabsf(filters[k]->getPitch() - filters[0]->getPitch()));
+      if (d > maxDiff[k]) maxDiff[k] = d;
+    }
+  }
+  Serial.printf("replay: %d records, %.1f s\n", count, (recs[count - 1].tUs - recs[0].tUs) * 1.0e-6f);
+  for (int k = 1; k < FILTER_COUNT; k++) {
+    Serial.printf("  %-14s max |diff| vs Madgwick: %.2f deg\n", filters[k]->name(), maxDiff[k]);
+  }
+}
+
+static void replayFromSd() {
+  SPI.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
+  if (!SD.begin(SD_CS, SPI)) {
+    Serial.println("replay: no SD card");
+    return;
+  }
+  File f = SD.open("/bench.bin", FILE_READ);
+  if (!f) {
+    Serial.println("replay: /bench.bin not found (copy a /frec_*.bin to it)");
+    return;
+  }
+  char magic[4];
+  uint8_t recLen = 0;
+  f.read((uint8_t*)magic, 4);
+  f.seek(5);
+  f.read(&recLen, 1);
+  if (memcmp(magic, "FREC", 4) != 0 || recLen != sizeof(Record)) {
+    Serial.println("replay: not a flight recorder dump");
+    f.close();
+    return;
+  }
+  f.seek(REC_HEADER_LEN);
+  int count = (f.size() - REC_HEADER_LEN) / sizeof(Record);
+  if (count > MAX_RECORDS) count = MAX_RECORDS;
+  Record* recs = (Record*)ps_malloc(count * sizeof(Record));
+  if (!recs) recs = (Record*)malloc(count * sizeof(Record));
+  if (!recs || count < 2) {
+    Serial.println("replay: not enough memory / records");
+    free(recs);
+    f.close();
+    return;
+  }
+  f.read((uint8_t*)recs, count * sizeof(Record));
+  f.close();
+  replay(recs, count);
+  free(recs);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  Serial.println("Attitude filter benchmark");
+  Serial.println("=========================");
+  Serial.printf("gain=%.2f, tilt roll=%.0f pitch=%.0f, gyro bias=%.1f deg/s\n",
+                GAIN, TILT_ROLL, TILT_PITCH, GYRO_BIAS);
+
+  for (int k = 0; k < FILTER_COUNT; k++) {
+    AttitudeFilter* f = filters[k];
+    f->setGain(GAIN);
+    float cycles = measureCycles(f);
+    float us = cycles / ESP.getCpuFreqMHz();
+    float conv, driftRoll, driftPitch;
+    staticRun(f, &conv, &driftRoll, &driftPitch);
+    Serial.printf("%-14s %6.0f cycles %6.2f us (1kHz %4.1f%%, 2kHz %4.1f%%) | "
+                  "conv %5.2f s | drift roll %+6.2f pitch %+6.2f deg | final %.2f / %.2f\n",
+                  f->name(), cycles, us, us / 10.0f, us / 5.0f,
+                  conv, driftRoll, driftPitch, f->getRoll(), f->getPitch());
+  }
+
+  replayFromSd();
+}
+
+void loop() {
+  delay(1000);
+}
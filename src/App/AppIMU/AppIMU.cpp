@@ -175,15 +175,16 @@ void AppIMU::draw(M5Canvas &canvas) {
     // センサー更新は main.cpp loop() で行うため、ここでは呼ばない
     // imu6886_ahrs.update();  // 削除：ここで update しないこと
     
-    float rollDeg = imu6886_ahrs.getRoll();// 度数法, 0～360 度
-    float pitchDeg = imu6886_ahrs.getPitch();// 度数法, -180～180 度
-    float yawDeg = imu6886_ahrs.getYaw();// 度数法, 0～360 度
+    // 1回の更新でそろった推定値を取得（IMUタスク動作中でも I2C は読まない）
+    ImuSampler::Estimate est;
+    g_imuSampler.latest(est);
+    float rollDeg = est.roll;// 度数法, 0～360 度
+    float pitchDeg = est.pitch;// 度数法, -180～180 度
+    float yawDeg = est.yaw;// 度数法, 0～360 度
 
-    // 生センサー値取得（フィルタ適用前）
-    float rawAccelX, rawAccelY, rawAccelZ;
-    float rawGyroX, rawGyroY, rawGyroZ;
-    imu6886_ahrs.sensor().readAccel(&rawAccelX, &rawAccelY, &rawAccelZ);
-    imu6886_ahrs.sensor().readGyro(&rawGyroX, &rawGyroY, &rawGyroZ);
+    // 生センサー値（フィルタ適用前、ジャイロはバイアス補正前）
+    float rawAccelX = est.ax, rawAccelY = est.ay, rawAccelZ = est.az;
+    float rawGyroX = est.gx + est.bx, rawGyroY = est.gy + est.by, rawGyroZ = est.gz + est.bz;
 
     // ラジアン変換
     const float rollRad = rollDeg * kPI / 180.0f;
@@ -229,11 +230,12 @@ void AppIMU::draw(M5Canvas &canvas) {
     canvas.drawString(buf, 160, 96);
     
     // === フィルタ情報 ===
-    float temperature = imu6886_ahrs.getTemperature();
-    float gyroBiasX = imu6886_ahrs.getGyroBiasX();
+    float temperature = est.temp;
+    float gyroBiasX = est.bx;
     
     canvas.setTextColor(GREEN);
-    sprintf(buf, "Temp:%.1fC BiasX:%.3f", temperature, gyroBiasX);
+    sprintf(buf, "Temp:%.1fC BiasX:%.3f %3.0f%%%s", temperature, gyroBiasX,
+            est.biasConf * 100.0f, est.stationary ? " S" : "");
     canvas.drawString(buf, 10, 120);
 
     // === 下部: 3Dキューブ描画（画面中央に大きく表示） ===
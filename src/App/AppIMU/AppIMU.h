@@ -4,9 +4,12 @@
 #include <M5CoreS3.h>
 #include "../App.h"
 #include "MPU6886_AHRS.h"
+#include "../../system/ImuSampler.h"
 
 // IMU (filtered) defined in main.cpp
 extern MPU6886_AHRS imu6886_ahrs;
+// 最新の推定値（I2Cには触れずに読む）
+extern ImuSampler g_imuSampler;
 
 
 class AppIMU : public App {
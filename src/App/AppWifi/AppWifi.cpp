@@ -1,6 +1,7 @@
 #include "system/Settings.h"
 #include <M5CoreS3.h>
 #include <WiFi.h>
+#include <esp_wifi.h>
 #include "config.h"
 
 #include "UI/TopBar/TopBar.h"
@@ -46,7 +47,7 @@ void sanitizeText(char* dst, const char* src, size_t maxLen) {
 
 #include "system/comm/UdpSender.h"
 
-static UdpSender udpSender;
+extern UdpSender udpSender;  // main.cpp（接続状態は loop() の poll() で更新される）
 static bool pcConnected = false;
 static uint32_t lastSignalMs = 0;
 
@@ -95,19 +96,30 @@ void AppWifi::draw(M5Canvas &canvas) {
     static int lastScanResult = -2; // -2:未スキャン, -1:スキャン中, 0:見つからず, 1:見つかった
     static uint32_t lastScanTime = 0;
     static bool scanRequested = false;
-    // WiFi機能ONかつ未接続時のみスキャン
-    if (Settings::getInstance().isWifiEnabled() && WiFi.status() != WL_CONNECTED) {
-        if (!scanRequested || millis() - lastScanTime > 5000) {
-            lastScanResult = -1; // スキャン中
-            WiFi.mode(WIFI_STA);
-            WiFi.disconnect();
-            int n = WiFi.scanNetworks();
-            lastScanResult = 0;
-            for (int i = 0; i < n; ++i) {
-                if (WiFi.SSID(i) == String(WIFI_SSID)) {
-                    lastScanResult = 1;
-                    break;
+    static bool scanRunning = false;
+    // WiFi機能ONかつ再試行待ちの間のみスキャン（接続試行中にスキャンすると接続を中断してしまう）
+    // スキャンは非同期で開始し、描画のたびに完了を確認する（同期スキャンは数秒 UI を止める）
+    if (Settings::getInstance().isWifiEnabled() && udpSender.linkState() == UdpSender::LinkState::BACKOFF) {
+        if (scanRunning) {
+            int n = WiFi.scanComplete();
+            if (n != WIFI_SCAN_RUNNING) {
+                if (n >= 0) {  // WIFI_SCAN_FAILED なら前回結果のまま
+                    lastScanResult = 0;
+                    for (int i = 0; i < n; ++i) {
+                        if (WiFi.SSID(i) == String(WIFI_SSID)) {
+                            lastScanResult = 1;
+                            break;
+                        }
+                    }
                 }
+                WiFi.scanDelete();
+                scanRunning = false;
+                lastScanTime = millis();
+            }
+        } else if (!scanRequested || millis() - lastScanTime > 5000) {
+            if (WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING) {
+                if (!scanRequested) lastScanResult = -1; // 初回のみ「スキャン中」、以降は前回結果を表示し続ける
+                scanRunning = true;
             }
             lastScanTime = millis();
             scanRequested = true;
@@ -125,6 +137,12 @@ void AppWifi::draw(M5Canvas &canvas) {
         }
         canvas.setTextColor(WHITE);
     } else {
+        // 再接続が始まったらスキャンを打ち切る
+        if (scanRunning) {
+            esp_wifi_scan_stop();
+            WiFi.scanDelete();
+            scanRunning = false;
+        }
         scanRequested = false;
         lastScanResult = -2;
     }
@@ -199,7 +217,7 @@ void AppWifi::onTouch(int x, int y) {
     // WiFi未接続時はボタン領域のみ有効
     if (WiFi.status() != WL_CONNECTED) {
         if (x >= BTN_X && x < BTN_X + BTN_W && y >= BTN_Y && y < BTN_Y + BTN_H) {
-            udpSender.begin();
+            udpSender.begin();  // 待たずに接続をやり直す
         }
     } else {
         // 接続済み時は従来通りUDP送信
@@ -23,7 +23,11 @@
 // Comm
 #include "system/comm/UdpSender.h"
 #include "system/comm/SerialSender.h"
+#include "system/comm/UdpReceiver.h"
+#include "system/comm/TrajectoryBuffer.h"
 #include "system/Settings.h"
+#include "system/FlightRecorder.h"
+#include "system/ImuSampler.h"
 
 #include <WiFiUdp.h>
 
@@ -36,6 +40,17 @@ CRGB leds[WS2812_COUNT];
 static constexpr int LOGO_WIDTH = 240;
 static constexpr int LOGO_HEIGHT = 240;
 
+// 保存済みIMU校正値をそのまま使える温度差 [°C]（超えたら起動後に裏で校正し直す）
+#ifndef IMU_CAL_MAX_TEMP_DIFF
+#define IMU_CAL_MAX_TEMP_DIFF 8.0f
+#endif
+
+// PORT.A の I2C クロック [Hz]（IMU と PCA9685 で共用）
+// PROFILE_GAIT（1kHz）は FIFO から 14B×1000/s を読むため 400kHz が必要（100kHz では読み出しが追いつかない）
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ 400000
+#endif
+
 float imu_roll_offset = 0.0f;
 // サーボ・LED制御開始フラグ
 bool systemStarted = false;
@@ -46,12 +61,23 @@ const uint32_t led_blink_interval_ms = 1000;
 float imu_pitch_offset = 0.0f;
 float imu_yaw_offset = 0.0f;
 bool imu6886_connected = false;
-WiFiUDP udpReceiver;
+// 校正完了時に姿勢のゼロ点も取り直すか（保存済みのゼロ点で起動した後の裏の校正では取り直さない）
+static bool g_calSetsOffset = true;
+UdpReceiver udpReceiver;
 constexpr uint16_t UDP_LISTEN_PORT = 12345;
-uint8_t udpRecvBuf[128];
 uint16_t g_seq = 0;
+// UDP バッチ送信のサンプル連番（IMU サンプルごとに進める）
+uint16_t g_sampleSeq = 0;
+// メインループの統計（TYPE_TELEMETRY の SEC_LOOP、1秒ごとに更新）
+CommProtocol::LoopStats g_loopStats = {};
 uint16_t g_servoPos[8] = {90, 90, 90, 90, 90, 90, 90, 90};
 uint16_t g_servoOff[8] = {0};
+uint16_t g_servoCount[8] = {0};  // PCA9685 に書いたカウント（フライトレコーダー用）
+// 直近の制御状態の記録（転倒・停滞・ボタン・コマンドで凍結）
+FlightRecorder g_flightRec;
+bool g_sdReady = false;
+// ホストから先行送信された軌道（TRAJ_PUSH）をデバイスの時計で再生
+TrajectoryBuffer g_trajectory;
 bool pca9685_connected = false;
 Adafruit_PWMServoDriver pwmDriver(0x40);
 UdpSender udpSender;
@@ -61,6 +87,8 @@ SerialSender serialSender;
 M5Canvas canvas(&M5.Lcd);
 AppManager appManager;
 MPU6886_AHRS imu6886_ahrs;  // 外部参照可能にするためstaticを削除
+// IMU の取得・姿勢推定（割り込みタスク or loop()）と最新推定値の公開
+ImuSampler g_imuSampler;
 
 /**
  * @brief サーボをフリー（PWM出力OFF）にする
@@ -102,28 +130,93 @@ static void applyServoOutputs() {
 		// 50Hzでのカウント値に変換 (0-4095)
 		uint16_t count = (pulse * 4096) / 20000;  // 20ms周期
 		pwmDriver.setPWM(ch, 0, count);
+		g_servoCount[ch] = count;
 	}
 }
 
-// 受信パケットの簡易パース（g_servoPosを更新）
-void processUdpServoPacket(const uint8_t* data, size_t len) {
-	// 例: 先頭2バイト=SYNC(0xAA55), その後8ch分のu16(16バイト)
-	if (len < 2 + 16) return;
-	if (data[0] != 0xAA || data[1] != 0x55) return;
-	for (int i = 0; i < 8; ++i) {
-		uint16_t angle = data[2 + i * 2] | (data[2 + i * 2 + 1] << 8);
-		if (angle > 180) angle = 180;
-		if (angle < 0) angle = 0;
-		g_servoPos[i] = angle;
-	}
-	// g_servoPos[]の内容をシリアル出力
-	Serial.print("g_servoPos: [");
-	for (int i = 0; i < 8; ++i) {
-		Serial.print(g_servoPos[i]);
-		if (i < 7) Serial.print(", ");
-	}
-	Serial.println("]");
-	applyServoOutputs();
+// 凍結中のフライトレコーダーを SD の /frec_<millis>.bin へ保存
+static bool saveFlightRecording() {
+	if (!g_sdReady) return false;
+	char path[32];
+	snprintf(path, sizeof(path), "/frec_%lu.bin", (unsigned long)millis());
+	return g_flightRec.saveTo(SD, path);
+}
+
+// ジャイロ校正を開始（校正の状態は INT タスクのサンプル処理が進めるので、止めてから初期化する）
+// タスクが止まらなかった場合は開始せず false（setup() ではタスク起動前なので必ず開始する）
+static bool startGyroCalibration() {
+	if (!g_imuSampler.pause()) return false;
+	imu6886_ahrs.startCalibration(500);
+	g_imuSampler.resume();
+	return true;
+}
+
+// 設定のIMUプロファイルを、現在の I2C クロックで使えるものに丸める（GAIT は 400kHz 未満なら DEFAULT）
+static MPU6886::Profile usableImuProfile(uint8_t profile) {
+	if (profile >= MPU6886::PROFILE_COUNT) return MPU6886::PROFILE_DEFAULT;
+	if (profile == MPU6886::PROFILE_GAIT && Wire.getClock() < 400000) {
+		return MPU6886::PROFILE_DEFAULT;
+	}
+	return (MPU6886::Profile)profile;
+}
+
+// IMU_PROFILE コマンド: Settings に設定し（センサーへは loop() が適用）、実際に使われるプロファイルを返す
+static void setImuProfileFromCommand(uint8_t& profile) {
+	Settings& settings = Settings::getInstance();
+	if (profile < MPU6886::PROFILE_COUNT) settings.setImuProfile(profile);
+	profile = usableImuProfile(settings.getImuProfile());
+}
+
+// ジャイロ校正の完了・中止を検出（完了時は新しいバイアスでの姿勢をオフセットとして取り直す）
+static void pollCalibration() {
+	static MPU6886_AHRS::CalibrationState lastState = MPU6886_AHRS::CAL_IDLE;
+	MPU6886_AHRS::CalibrationState state = imu6886_ahrs.getCalibrationState();
+	if (state == lastState) return;
+	lastState = state;
+	if (state == MPU6886_AHRS::CAL_DONE) {
+		ImuSampler::Estimate e;
+		g_imuSampler.latest(e);
+		if (g_calSetsOffset) {
+			// 起動直後のフィルタは収束途中なので、ロール・ピッチは校正中の加速度の平均から取る
+			float roll, pitch;
+			if (!imu6886_ahrs.getCalibrationTilt(&roll, &pitch)) {
+				roll = e.roll;
+				pitch = e.pitch;
+			}
+			imu_roll_offset = roll;
+			imu_pitch_offset = pitch;
+			imu_yaw_offset = e.yaw;
+		}
+		Serial.printf("IMU gyro calibrated: bias %.3f %.3f %.3f deg/s%s\n",
+		              e.bx, e.by, e.bz, g_calSetsOffset ? ", offset updated." : "");
+		g_calSetsOffset = true;  // 以降（長押し）はゼロ点も取り直す
+		// 次回の起動ですぐ使えるように保存
+		Settings::ImuCalibration cal;
+		cal.gyroBias[0] = e.bx;
+		cal.gyroBias[1] = e.by;
+		cal.gyroBias[2] = e.bz;
+		cal.rollOffset = imu_roll_offset;
+		cal.pitchOffset = imu_pitch_offset;
+		cal.tempC = e.temp;
+		Settings::getInstance().saveImuCalibration(cal);
+	} else if (state == MPU6886_AHRS::CAL_ABORTED) {
+		g_calSetsOffset = true;
+		Serial.println("IMU calibration aborted (moved). Bias unchanged.");
+	}
+}
+
+// 校正中は画面下部に進捗バーを重ねて表示
+static void drawCalibrationOverlay() {
+	if (!imu6886_connected) return;
+	if (imu6886_ahrs.getCalibrationState() != MPU6886_AHRS::CAL_RUNNING) return;
+	const int x = 10, y = 200, w = 300, h = 30;
+	canvas.fillRect(x, y, w, h, BLACK);
+	canvas.drawRect(x, y, w, h, TFT_YELLOW);
+	canvas.fillRect(x + 2, y + 2, (int)((w - 4) * imu6886_ahrs.getCalibrationProgress()), h - 4, 0x4208);
+	canvas.setFont(&fonts::Font2);
+	canvas.setTextSize(1);
+	canvas.setTextColor(TFT_YELLOW);
+	canvas.drawCentreString("Calibrating... Keep still!", x + w / 2, y + 7);
 }
 
 /**
@@ -183,6 +276,7 @@ void setup() {
 	// SDカードをマウント（CoreS3のSDピンを明示）
 	SPI.begin(GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_11, GPIO_NUM_4);
 	bool sdReady = SD.begin(GPIO_NUM_4, SPI);
+	g_sdReady = sdReady;
 	
 
 	// WS2812の初期化
@@ -201,7 +295,7 @@ void setup() {
 	publicTimer.begin();    // タイマー初期化
 	
 	// PORT.A I2C初期化 (Wire: SDA=GPIO2, SCL=GPIO1) - 外部デバイス/IMU用
-	Wire.begin(SDA_PIN, SCL_PIN);
+	Wire.begin(SDA_PIN, SCL_PIN, I2C_CLOCK_HZ);
 	delay(50);
 
 	// PCA9685 初期化（サーボ駆動用）
@@ -257,34 +351,63 @@ void setup() {
 		M5.Lcd.drawString(ver, LCD_WIDTH / 2, LCD_HEIGHT / 2 + 50);
 	}
 
-	// WiFi/UDP初期化（ロゴ表示中に実施）
+	// 設定システムの初期化（NVSから読み込み。WiFi有効/無効の判定より前に行う）
+	Settings::getInstance().begin();
+
+	// WiFi/UDP初期化（接続は待たずに開始のみ。以降は loop() の udpSender.poll() で接続・再接続）
 	if (Settings::getInstance().isWifiEnabled()) {
 		udpSender.begin();
 		udpReceiver.begin(UDP_LISTEN_PORT); // UDP受信も開始
 	}
 
-	// 起動から3秒以上経過していなければロゴを表示したまま待機
+	// 保存済みのIMU校正値があればすぐ起動。なければロゴを表示したまま3秒待機（この間にロボットを置いて静止させる）
+	Settings::ImuCalibration imuCal;
+	bool imuCalLoaded = Settings::getInstance().getImuCalibration(imuCal);
 	uint32_t startMs = millis();
-	while (millis() - startMs < 3000) {
+	uint32_t logoMs = imuCalLoaded ? 0 : 3000;
+	while (millis() - startMs < logoMs) {
 		if (imu6886_connected) imu6886_ahrs.update();
+		udpSender.poll();
 		delay(10);
 	}
 
 	// IMU6886初期化
 	M5.Lcd.setFont(&fonts::Font2);//
 	int imu_init_result = imu6886_ahrs.begin(&Wire, 0x68, 100.0f, 0.1f);	
+	// 姿勢フィルタ（設定になければビルド時の既定 MPU6886_AHRS_DEFAULT_FILTER）
+	uint8_t imuFilter = Settings::getInstance().getImuFilter();
+	if (imuFilter < MPU6886_AHRS::FILTER_COUNT) {
+		imu6886_ahrs.setFilterType((MPU6886_AHRS::FilterType)imuFilter);
+	}
+	Serial.printf("IMU filter: %s\n", MPU6886_AHRS::filterName(imu6886_ahrs.getFilterType()));
 	if (imu_init_result == 0) {
 		imu6886_connected = true;
-		M5.Lcd.fillScreen(BLACK);
-		M5.Lcd.setCursor(10, 100);
-		M5.Lcd.setTextSize(2);
-		M5.Lcd.setTextColor(TFT_YELLOW);
-		M5.Lcd.print("Calibrating...");
-		M5.Lcd.setCursor(10, 130);
-		M5.Lcd.print("Keep still!");
-		
-		imu6886_ahrs.calibrateGyro(500);
-		M5.Lcd.fillScreen(BLACK);
+		// レンジ・DLPF・ODR のプロファイル（動作中の変更は loop() で適用）
+		imu6886_ahrs.setProfile(usableImuProfile(Settings::getInstance().getImuProfile()));
+		Serial.printf("IMU profile: %s (%.0f Hz)\n", MPU6886::profileName(imu6886_ahrs.getProfile()),
+		              imu6886_ahrs.sensor().getSampleRateHz());
+		// ODR の全サンプルを FIFO 経由で取得（ループ周期に依存しない姿勢推定）
+		imu6886_ahrs.setFifoMode(true);
+		if (imuCalLoaded) {
+			// 保存済みの校正値で即座に使える状態にする（温度差が小さいほどバイアスを信頼）
+			float tempC;
+			imu6886_ahrs.sensor().readTemp(&tempC);
+			float dT = fabsf(tempC - imuCal.tempC);
+			float conf = 1.0f - dT / IMU_CAL_MAX_TEMP_DIFF;
+			if (conf < 0.0f) conf = 0.0f;
+			imu6886_ahrs.setGyroBias(imuCal.gyroBias[0], imuCal.gyroBias[1], imuCal.gyroBias[2], conf);
+			imu_roll_offset = imuCal.rollOffset;
+			imu_pitch_offset = imuCal.pitchOffset;
+			Serial.printf("IMU calibration loaded (%.1fC, saved at %.1fC)\n", tempC, imuCal.tempC);
+			if (dT > IMU_CAL_MAX_TEMP_DIFF) {
+				// バイアスだけ裏で校正し直す（ゼロ点は保存値のまま）
+				g_calSetsOffset = false;
+				startGyroCalibration();
+			}
+		} else {
+			// ジャイロ校正は loop() の通常のサンプル取得で進める（約1秒。完了時にオフセットも取り直して保存）
+			startGyroCalibration();
+		}
 	} else {
 		imu6886_connected = false;
 		M5.Lcd.fillScreen(BLACK);
@@ -298,15 +421,22 @@ void setup() {
 		delay(2000);
 	}
 	
-	delay(100);
+	if (!imuCalLoaded) delay(100);
 
-	// ここでIMUオフセットを記録（値が安定したタイミング）
+	// ここでIMUオフセットを記録（値が安定したタイミング。保存済みなら roll / pitch は保存値を使う）
 	if (imu6886_connected) {
 		imu6886_ahrs.update();
-		imu_roll_offset = imu6886_ahrs.getRoll();
-		imu_pitch_offset = imu6886_ahrs.getPitch();
+		if (!imuCalLoaded) {
+			imu_roll_offset = imu6886_ahrs.getRoll();
+			imu_pitch_offset = imu6886_ahrs.getPitch();
+		}
 		imu_yaw_offset = imu6886_ahrs.getYaw();
 		Serial.println("IMU offset set after logo.");
+		g_imuSampler.attach(&imu6886_ahrs);
+#if IMU_USE_INT_TASK
+		// データレディ割り込みで専用タスクが取得（以降 loop() から IMU を直接読まない）
+		g_imuSampler.startTask();
+#endif
 	}
 
 	// ここで画面を黒くする
@@ -318,12 +448,56 @@ void setup() {
 	// 起動直後はHome画面を表示
 	appManager.showHomeScreen();
 
-	// 設定システムの初期化（NVSから読み込み）
-	Settings::getInstance().begin();
+	// フライトレコーダー（PSRAM優先で確保）。REC コマンドで凍結・取り出し・SD保存
+	g_flightRec.begin();
+	udpReceiver.setRecorder(&g_flightRec);
+	serialSender.setRecorder(&g_flightRec);
+	udpReceiver.setRecordingSaver(saveFlightRecording);
+	serialSender.setRecordingSaver(saveFlightRecording);
+	udpReceiver.setImuProfileHandler(setImuProfileFromCommand);
+	serialSender.setImuProfileHandler(setImuProfileFromCommand);
 
 	// 通信初期化（WiFi/UDPとシリアルの排他制御）
+	g_trajectory.setLead(Settings::getInstance().getTrajectoryLeadMs());
+	udpReceiver.setTrajectory(&g_trajectory);
+	serialSender.setTrajectory(&g_trajectory);
 	if (Settings::getInstance().isWifiEnabled()) {
-		udpSender.begin();
+		udpSender.setBatching(Settings::getInstance().getUdpBatchSize(),
+		                      Settings::getInstance().getUdpBatchMaxAgeMs());
+		// UDPコマンドの送信形式・バッチ設定は UdpSender に反映
+		udpReceiver.setFormatHandler([](uint8_t type) {
+			if (type) udpSender.setTelemetryType(type);
+			return udpSender.telemetryType();
+		});
+		udpReceiver.setBatchHandler([](uint8_t& count, uint16_t& maxAgeMs) {
+			udpSender.setBatching(count, maxAgeMs);
+			count = udpSender.batchSize();
+			maxAgeMs = udpSender.batchMaxAgeMs();
+		});
+		// テレメトリ送信先は HELLO で登録された購読者（いなければ設定時のみブロードキャスト）
+		udpReceiver.setPeerHandler([](IPAddress ip, uint16_t port, uint8_t streams) {
+			return udpSender.subscribe(ip, port, streams);
+		}, UdpSender::MAX_PEERS, UdpSender::PEER_IDLE_MS / 1000);
+		udpReceiver.setPeerStatsSource([](uint8_t slot, uint32_t& packets, uint32_t& failures) {
+			if (slot >= UdpSender::MAX_PEERS || !udpSender.peer(slot).active) return false;
+			packets = udpSender.peer(slot).packets;
+			failures = udpSender.peer(slot).failures;
+			return true;
+		});
+		udpSender.setBroadcastFallback(Settings::getInstance().isUdpBroadcastFallback());
+		// チャネル別レート（SUBSCRIBE）と SEC_LINK の受信側の統計
+		udpReceiver.setScheduler(&udpSender.scheduler());
+		udpSender.setRxStatsSource([](CommProtocol::LinkStats& link) {
+			const auto& rx = udpReceiver.stats();
+			link.rxGood = rx.datagrams - rx.malformed - rx.oversize;
+			link.rxBad = rx.malformed + rx.oversize;
+			link.rxSeqGaps = rx.seqGaps;
+			link.rxSeqReorders = rx.seqReorders;
+			link.rxSeqResyncs = rx.seqResyncs;
+			link.rxSuperseded = rx.superseded;
+			link.rxAgeUs = rx.lastAgeUs;
+			link.rxMaxAgeUs = rx.maxAgeUs;
+		});
 		// WiFi有効時はシリアル制御を強制OFF
 		Settings::getInstance().setSerialEnabled(false);
 	} else {
@@ -331,24 +505,122 @@ void setup() {
 		Settings::getInstance().setSerialEnabled(true);
 		serialSender.begin();
 	}
+
+	Serial.printf("Boot: interactive after %lu ms (WiFi %s)\n", (unsigned long)millis(),
+		udpSender.isReady() ? "up" : "pending");
+}
+
+// ループ周期を集計して1秒ごとに g_loopStats へ反映。戻り値は前回からの周期（μs、初回は0）
+static uint32_t updateLoopStats() {
+	static uint32_t lastUs = 0;
+	static uint32_t windowStartUs = 0;
+	static uint32_t count = 0;
+	static uint32_t maxUs = 0;
+	uint32_t now = micros();
+	uint32_t dt = 0;
+	if (lastUs != 0) {
+		dt = now - lastUs;
+		if (dt > maxUs) maxUs = dt;
+		count++;
+	} else {
+		windowStartUs = now;
+	}
+	lastUs = now;
+	uint32_t window = now - windowStartUs;
+	if (window >= 1000000UL && count > 0) {
+		g_loopStats.loopHz = (uint16_t)((uint64_t)count * 1000000ULL / window);
+		uint32_t avg = window / count;
+		g_loopStats.avgUs = (uint16_t)(avg > 0xFFFF ? 0xFFFF : avg);
+		g_loopStats.maxUs = (uint16_t)(maxUs > 0xFFFF ? 0xFFFF : maxUs);
+		g_loopStats.freeHeap = ESP.getFreeHeap();
+		windowStartUs = now;
+		count = 0;
+		maxUs = 0;
+	}
+	return dt;
+}
+
+static int16_t toI16(float v, float scale) {
+	float x = v * scale;
+	if (x > 32767.0f) return 32767;
+	if (x < -32768.0f) return -32768;
+	return (int16_t)lroundf(x);
+}
+
+// IMU の1サンプルをフライトレコーダーの1レコードにし、転倒を判定
+static void recordFlightSample(const ImuSampler::Sample& s, uint32_t loopUs) {
+	FlightRecorder::Record r;
+	r.tUs = s.tUs;
+	r.acc[0] = toI16(s.ax, CommProtocol::V2_ACCEL_LSB_PER_G);
+	r.acc[1] = toI16(s.ay, CommProtocol::V2_ACCEL_LSB_PER_G);
+	r.acc[2] = toI16(s.az, CommProtocol::V2_ACCEL_LSB_PER_G);
+	r.gyro[0] = toI16(s.gx, CommProtocol::V2_GYRO_LSB_PER_DPS);
+	r.gyro[1] = toI16(s.gy, CommProtocol::V2_GYRO_LSB_PER_DPS);
+	r.gyro[2] = toI16(s.gz, CommProtocol::V2_GYRO_LSB_PER_DPS);
+	r.euler[0] = toI16(s.roll, CommProtocol::V2_EULER_LSB_PER_DEG);
+	r.euler[1] = toI16(s.pitch, CommProtocol::V2_EULER_LSB_PER_DEG);
+	r.euler[2] = toI16(s.yaw, CommProtocol::V2_EULER_LSB_PER_DEG);
+	memcpy(r.servo, g_servoCount, sizeof(r.servo));
+	r.loopUs = (uint16_t)(loopUs > 0xFFFF ? 0xFFFF : loopUs);
+	g_flightRec.record(r);
+	g_flightRec.checkFall(s.roll - imu_roll_offset, s.pitch - imu_pitch_offset);
+}
+
+// UDP バッチ送信中なら IMU の1サンプルをバッチへ積む（ジャイロはバイアス補正後、姿勢はオフセット補正後）
+static bool streamImuSample(const ImuSampler::Sample& s, uint8_t t8) {
+	CommProtocol::ControlSample sample = {
+		s.tUs, s.ax, s.ay, s.az, s.gx - s.bx, s.gy - s.by, s.gz - s.bz,
+		s.roll - imu_roll_offset, s.pitch - imu_pitch_offset, s.yaw - imu_yaw_offset,
+		t8, g_servoPos, g_servoOff, &g_loopStats
+	};
+	return udpSender.pushSample(sample, g_sampleSeq++);
+}
+
+// 前回の loop() 以降に取得した IMU サンプルを全て取り出して記録し、UDP バッチへ渡す
+static void drainImuSamples(uint32_t loopUs) {
+	bool stream = udpSender.batchSize() > 1 && Settings::getInstance().isWifiEnabled() &&
+	              Settings::getInstance().isImuOutputEnabled();
+	uint8_t t8 = 0;
+	if (stream) {
+		ImuSampler::Estimate e;
+		g_imuSampler.latest(e);
+		float tf = e.temp;
+		if (tf < 0) tf = 0; if (tf > 255) tf = 255; t8 = (uint8_t)(tf);
+	}
+	bool sent = false;
+	ImuSampler::Sample s;
+	while (g_imuSampler.popSample(s)) {
+		recordFlightSample(s, loopUs);
+		if (stream) sent = streamImuSample(s, t8) || sent;
+	}
+	if (sent) appManager.getTopBar().notifyUdpSent();
 }
 
-void sendImuUdp(float ax, float ay, float az, float gx, float gy, float gz, uint8_t temp) {
-	// PC側の受信形式: [AA 55][roll][pitch][yaw][gx][gy][gz][temp] (float*6+uint8)
-	uint8_t buf[2 + 4*6 + 1];
-	buf[0] = 0xAA; buf[1] = 0x55;
-	memcpy(&buf[2],  &ax, 4);   // roll
-	memcpy(&buf[6],  &ay, 4);   // pitch
-	memcpy(&buf[10], &az, 4);   // yaw
-	memcpy(&buf[14], &gx, 4);   // gx
-	memcpy(&buf[18], &gy, 4);   // gy
-	memcpy(&buf[22], &gz, 4);   // gz
-	buf[26] = temp;
-	IPAddress pc_broadcast(192,168,0,255);
-	udpSender.sendImuPacket(buf, sizeof(buf), pc_broadcast, 12346);
+// ループ停滞の判定と凍結後のSD保存（IMU 未接続時はループごとに1レコード記録）
+static void recordFlight(uint32_t loopUs) {
+	if (imu6886_connected) {
+		drainImuSamples(loopUs);
+	} else {
+		FlightRecorder::Record r = {};
+		r.tUs = micros();
+		memcpy(r.servo, g_servoCount, sizeof(r.servo));
+		r.loopUs = (uint16_t)(loopUs > 0xFFFF ? 0xFFFF : loopUs);
+		g_flightRec.record(r);
+	}
+	g_flightRec.checkStall(loopUs);
+
+	// 凍結したら1回だけSDへ保存（SDがなければREC コマンドで取り出す）
+	static bool saved = false;
+	if (g_flightRec.state() != FlightRecorder::State::FROZEN) {
+		saved = false;
+	} else if (!saved) {
+		saved = true;
+		saveFlightRecording();
+	}
 }
 
 void loop() {
+	uint32_t loopUs = updateLoopStats();
 	// loop開始時に1回だけ通常制御へ切り替え
 	if (!systemStarted) {
 		updateLedPattern(true, true);
@@ -366,13 +638,9 @@ void loop() {
 	// ハードウェアの状態を更新（ボタン、電源など）
 	CoreS3.update();
 
-	// --- UDP受信: サーボ制御コマンド ---
-	int packetSize = udpReceiver.parsePacket();
-	if (packetSize > 0 && packetSize <= (int)sizeof(udpRecvBuf)) {
-		int len = udpReceiver.read(udpRecvBuf, sizeof(udpRecvBuf));
-		if (len > 0) {
-			processUdpServoPacket(udpRecvBuf, len);
-		}
+	// --- UDP受信: コマンド（溜まった分を全て処理し、最新の状態のみ反映） ---
+	if (udpReceiver.poll(g_servoPos, g_servoOff)) {
+		applyServoOutputs();
 	}
 	
 	// 電源ボタン長押しで電源オフ（3秒以上）
@@ -390,9 +658,9 @@ void loop() {
 	// タッチパネルの状態を更新（座標取得と基本フラグのみ）
 	touchManager.update();
 	
-	// === IMU センサー更新（IMU接続時のみ） ===
+	// === IMU センサー更新（IMU接続時のみ。割り込みタスク動作中は何もしない） ===
 	if (imu6886_connected) {
-		imu6886_ahrs.update();
+		g_imuSampler.poll();
 	}
 	
 	// シリアルコマンド受信処理（アプリloopより前に実行！）
@@ -408,97 +676,135 @@ void loop() {
 		}
 	}
 
+	// 軌道再生（再生中は受信コマンドより優先して姿勢を上書き）
+	if (g_trajectory.update(micros(), g_servoPos)) {
+		applyServoOutputs();
+	}
+
+	// UDPバッチの期限送信・送信レート集計
+	udpSender.poll();
+
 	// ボタンB（物理ボタン）が離されたらホーム画面を表示
 	if (M5.BtnB.wasReleased()) {
 		appManager.showHomeScreen();
 	}
+	// ボタンAダブルクリックでフライトレコーダーを凍結
+	if (M5.BtnA.wasDoubleClicked()) {
+		g_flightRec.trigger(FlightRecorder::REASON_BUTTON);
+	}
 
 	// 現在のアプリのメインロジック実行
 	appManager.loop();
 	
 	// 画面に描画
 	appManager.draw(canvas);
+	drawCalibrationOverlay();
 	canvas.pushSprite(&M5.Lcd, 0, 0);
 
-	// --- 制御データ送信（UDP / Serial 並行）---
-	static uint32_t lastSendMs = 0;
-	const uint32_t intervalMs = 1000 / CONTROL_RATE_HZ;
-	uint32_t nowMs = millis();
-	if (nowMs - lastSendMs >= intervalMs) {
-		lastSendMs = nowMs;
+	// --- 制御データ送信（UDP / Serial 並行、送信先ごとのレート）---
+	// TYPE_TELEMETRY ではチャネル（姿勢/IMU/サーボ/ループ/リンク）ごとに PC が SUBSCRIBE したレートで、
+	// それ以外の形式では CONTROL_RATE_HZ で送信する
+	static bool lastUdpOk = false;
+	static bool lastSerialOk = false;
+	uint32_t nowUs = micros();
+	bool wifiOn = Settings::getInstance().isWifiEnabled();
+	bool serialOn = Settings::getInstance().isSerialEnabled();
+	bool udpDue = wifiOn && udpSender.telemetryDue(nowUs);
+	bool serialDue = serialOn && serialSender.telemetryDue(nowUs);
+	// IMU出力設定（OFFの場合は送信自体をスキップ）
+	if ((udpDue || serialDue) && Settings::getInstance().isImuOutputEnabled()) {
 		float roll=0, pitch=0, yaw=0, gx=0, gy=0, gz=0;
 		float ax=0, ay=0, az=0;
 		uint8_t t8 = 0;
 		if (imu6886_connected) {
-			roll = imu6886_ahrs.getRoll();
-			pitch = imu6886_ahrs.getPitch();
-			yaw = imu6886_ahrs.getYaw();
-			imu6886_ahrs.getGyro(&gx, &gy, &gz);
-			imu6886_ahrs.getAccel(&ax, &ay, &az);
-			float tf = imu6886_ahrs.getTemperature();
+			ImuSampler::Estimate e;
+			g_imuSampler.latest(e);
+			roll = e.roll; pitch = e.pitch; yaw = e.yaw;
+			gx = e.gx; gy = e.gy; gz = e.gz;
+			ax = e.ax; ay = e.ay; az = e.az;
+			float tf = e.temp;
 			if (tf < 0) tf = 0; if (tf > 255) tf = 255; t8 = (uint8_t)(tf);
 		}
 		// オフセット補正
 		float roll_deg = roll - imu_roll_offset;
 		float pitch_deg = pitch - imu_pitch_offset;
 		float yaw_deg = yaw - imu_yaw_offset;
-		// デバッグ: 送信値をシリアル出力
-		Serial.printf("IMU_SEND: roll=%.2f pitch=%.2f yaw=%.2f gx=%.2f gy=%.2f gz=%.2f temp=%d\n", roll_deg, pitch_deg, yaw_deg, gx, gy, gz, t8);
-		sendImuUdp(roll_deg, pitch_deg, yaw_deg, gx, gy, gz, t8);
-			// ボタンA（物理ボタン）でIMU初期値（オフセット）再設定
-			// ボタンA長押し（2秒以上）でのみキャリブレーション実行
-			if (M5.BtnA.pressedFor(2000)) {
-				if (imu6886_connected) {
-					// サーボをフリーに
-					setServoFree();
-					M5.Lcd.fillScreen(BLACK);
-					M5.Lcd.setCursor(10, 100);
-					M5.Lcd.setTextSize(2);
-					M5.Lcd.setTextColor(TFT_YELLOW);
-					M5.Lcd.print("Calibrating...");
-					M5.Lcd.setCursor(10, 130);
-					M5.Lcd.print("Keep still!");
-					imu6886_ahrs.calibrateGyro(500);
-					delay(500); // キャリブ後少し待つ
-					imu6886_ahrs.update();
-					imu_roll_offset = imu6886_ahrs.getRoll();
-					imu_pitch_offset = imu6886_ahrs.getPitch();
-					imu_yaw_offset = imu6886_ahrs.getYaw();
-					M5.Lcd.fillScreen(BLACK);
-					Serial.println("IMU offset updated & gyro calibrated.");
-					// サーボ制御値を復帰
-					applyServoOutputs();
-				}
-			}
-		// ここで g_servoPos / g_servoOff を必要に応じて更新してください（AppManual連携想定）
-		// IMU出力設定を取得（OFFの場合は送信自体をスキップ）
-		bool imuOutputEnabled = Settings::getInstance().isImuOutputEnabled();
+		CommProtocol::ControlSample sample = {
+			nowUs, ax, ay, az, gx, gy, gz, roll_deg, pitch_deg, yaw_deg, t8, g_servoPos, g_servoOff, &g_loopStats
+		};
 		bool udpOk = false;
 		bool serialOk = false;
-		// IMU出力ONの時のみデータ送信
-		if (imuOutputEnabled) {
-			// UDP送信（有効時のみ）
-			if (Settings::getInstance().isWifiEnabled()) {
-				udpOk = udpSender.sendControl(ax, ay, az, gx, gy, gz, t8, g_servoPos, g_servoOff, g_seq, true);
+		// UDP送信（有効時のみ）
+		// バッチ送信中の制御データは drainImuSamples() が IMU の全サンプルを積む（IMU 未接続時だけここで積む）
+		if (udpDue) {
+			udpOk = udpSender.sendControl(sample, g_seq);
+			if (!imu6886_connected && udpSender.batchSize() > 1) {
+				udpOk = udpSender.pushSample(sample, g_sampleSeq++) || udpOk;
 			}
-			// シリアル送信（有効時のみ、モード切り替え）
-			if (Settings::getInstance().isSerialEnabled()) {
-				if (Settings::getInstance().getSerialMode() == Settings::SERIAL_TEXT) {
-					serialOk = serialSender.sendControlText(ax, ay, az, gx, gy, gz, t8, g_servoPos, g_servoOff, g_seq, true);
-				} else {
-					serialOk = serialSender.sendControl(ax, ay, az, gx, gy, gz, t8, g_servoPos, g_servoOff, g_seq, true);
-				}
+		}
+		// シリアル送信（有効時のみ、モード切り替え）
+		if (serialDue) {
+			if (Settings::getInstance().getSerialMode() == Settings::SERIAL_TEXT) {
+				serialOk = serialSender.sendControlText(ax, ay, az, gx, gy, gz, t8, g_servoPos, g_servoOff, g_seq, true);
+			} else {
+				serialOk = serialSender.sendControl(sample, g_seq);
 			}
-			g_seq++;
 		}
+		g_seq++;
 		// TopBarに送信状態を通知
 		if (udpOk) appManager.getTopBar().notifyUdpSent();
 		if (serialOk) appManager.getTopBar().notifySerialSent();
+		lastUdpOk = lastUdpOk || udpOk;
+		lastSerialOk = lastSerialOk || serialOk;
+	}
+
+	// --- キャリブレーション・接続状態表示（CONTROL_RATE_HZ）---
+	static uint32_t lastUiMs = 0;
+	const uint32_t intervalMs = 1000 / CONTROL_RATE_HZ;
+	uint32_t nowMs = millis();
+	if (nowMs - lastUiMs >= intervalMs) {
+		lastUiMs = nowMs;
+		// ボタンA長押し（2秒以上）でジャイロ校正を開始（押し続けても1回だけ）
+		// 校正中もサーボ・通信・ループは止めない
+		static bool calButtonHeld = false;
+		if (M5.BtnA.pressedFor(2000)) {
+			if (imu6886_connected && !calButtonHeld &&
+			    imu6886_ahrs.getCalibrationState() != MPU6886_AHRS::CAL_RUNNING) {
+				if (startGyroCalibration()) {
+					Serial.println("IMU calibration started. Keep still!");
+				}
+			}
+			calButtonHeld = true;
+		} else {
+			calButtonHeld = false;
+		}
+		if (imu6886_connected) {
+			pollCalibration();
+			// IMUプロファイルの変更（IMU_PROFILE コマンドなど）を適用
+			MPU6886::Profile imuProfile = usableImuProfile(Settings::getInstance().getImuProfile());
+			// タスクが止まらなかったときは1秒おいて再試行（pause() は最大 200ms 待つため）
+			static uint32_t profileRetryMs = 0;
+			if (imuProfile != imu6886_ahrs.getProfile() && (int32_t)(nowMs - profileRetryMs) >= 0) {
+				if (g_imuSampler.pause()) {
+					imu6886_ahrs.setProfile(imuProfile);
+					g_imuSampler.resume();
+					Serial.printf("IMU profile: %s (%.0f Hz)\n", MPU6886::profileName(imu6886_ahrs.getProfile()),
+					              imu6886_ahrs.sensor().getSampleRateHz());
+				} else {
+					profileRetryMs = nowMs + 1000;
+				}
+			}
+		}
 		// UDP接続状態を更新
 		appManager.getTopBar().setUdpConnected(udpSender.isReady());
-		// LEDパターンを更新（通信状態を視覚化）
-		updateLedPattern(udpOk, serialOk);
+		// LEDパターンを更新（直近の周期で送信できたか）
+		updateLedPattern(lastUdpOk, lastSerialOk);
+		lastUdpOk = false;
+		lastSerialOk = false;
 	}
+
+	// --- フライトレコーダー（loop 1回につき1レコード）---
+	recordFlight(loopUs);
 }
 
 /*********************************** END OF FILE ******************************/
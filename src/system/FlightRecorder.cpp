@@ -0,0 +1,114 @@
+#include "FlightRecorder.h"
+#include <esp_heap_caps.h>
+
+bool FlightRecorder::begin(uint32_t records) {
+    if (buf_) return true;
+    if (records == 0) records = FLIGHT_REC_RECORDS;
+    if (psramFound()) {
+        buf_ = (Record*)heap_caps_malloc((size_t)records * sizeof(Record), MALLOC_CAP_SPIRAM);
+    }
+    if (!buf_) {
+        // PSRAM なし（または確保失敗）: 内部RAMに小さく確保
+        if (records > FLIGHT_REC_RECORDS_NO_PSRAM) records = FLIGHT_REC_RECORDS_NO_PSRAM;
+        buf_ = (Record*)malloc((size_t)records * sizeof(Record));
+    }
+    if (!buf_) {
+        Serial.println("FlightRec: allocation failed");
+        return false;
+    }
+    capacity_ = records;
+    rearm();
+    Serial.printf("FlightRec: %lu records (%lu bytes)\n",
+        (unsigned long)capacity_, (unsigned long)(capacity_ * sizeof(Record)));
+    return true;
+}
+
+void FlightRecorder::record(const Record& r) {
+    if (state_ != State::RECORDING && state_ != State::POST_TRIGGER) return;
+    buf_[head_] = r;
+    head_ = (head_ + 1) % capacity_;
+    if (count_ < capacity_) count_++;
+
+    if (state_ == State::POST_TRIGGER) {
+        if (--postLeft_ == 0 || r.tUs - triggerUs_ >= postMs_ * 1000) {
+            state_ = State::FROZEN;
+            Serial.printf("FlightRec: frozen (reason=%u, %lu records)\n", reason_, (unsigned long)count_);
+        }
+    }
+}
+
+void FlightRecorder::trigger(uint8_t reason) {
+    if (state_ != State::RECORDING) return;
+    reason_ = reason;
+    triggerPos_ = head_;
+    triggerUs_ = micros();
+    // トリガー後の様子も残す（postMs_ か容量の半分まで）
+    postLeft_ = capacity_ / 2;
+    state_ = (postMs_ && postLeft_) ? State::POST_TRIGGER : State::FROZEN;
+    Serial.printf("FlightRec: trigger reason=%u\n", reason);
+}
+
+void FlightRecorder::rearm() {
+    if (!buf_) return;
+    head_ = 0;
+    count_ = 0;
+    postLeft_ = 0;
+    triggerPos_ = 0;
+    triggerUs_ = 0;
+    reason_ = REASON_NONE;
+    state_ = State::RECORDING;
+}
+
+void FlightRecorder::checkFall(float rollDeg, float pitchDeg) {
+    if (fallDeg_ <= 0.0f || state_ != State::RECORDING) return;
+    if (fabsf(rollDeg) > fallDeg_ || fabsf(pitchDeg) > fallDeg_) trigger(REASON_FALL);
+}
+
+void FlightRecorder::checkStall(uint32_t loopUs) {
+    if (stallUs_ && loopUs >= stallUs_) trigger(REASON_STALL);
+}
+
+uint32_t FlightRecorder::triggerIndex() const {
+    if (count_ == 0 || reason_ == REASON_NONE) return 0;
+    uint32_t oldest = (head_ + capacity_ - count_) % capacity_;
+    // トリガー直前に記録したレコード
+    return (triggerPos_ + capacity_ - 1 - oldest) % capacity_;
+}
+
+bool FlightRecorder::read(uint32_t index, Record& out) const {
+    if (index >= count_) return false;
+    uint32_t oldest = (head_ + capacity_ - count_) % capacity_;
+    out = buf_[(oldest + index) % capacity_];
+    return true;
+}
+
+void FlightRecorder::fillHeader(FileHeader& h) const {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "FREC", 4);
+    h.version = FILE_VERSION;
+    h.recordLen = sizeof(Record);
+    h.reason = reason_;
+    h.count = count_;
+    h.triggerIndex = triggerIndex();
+    h.triggerUs = triggerUs_;
+    h.capacity = capacity_;
+}
+
+bool FlightRecorder::saveTo(fs::FS& fs, const char* path) const {
+    if (state_ != State::FROZEN) return false;
+    File f = fs.open(path, FILE_WRITE);
+    if (!f) return false;
+    FileHeader h;
+    fillHeader(h);
+    bool ok = f.write((const uint8_t*)&h, sizeof(h)) == sizeof(h);
+    // リングは最大2区間に分かれている
+    uint32_t oldest = (head_ + capacity_ - count_) % capacity_;
+    uint32_t first = count_ < capacity_ - oldest ? count_ : capacity_ - oldest;
+    size_t n1 = (size_t)first * sizeof(Record);
+    size_t n2 = (size_t)(count_ - first) * sizeof(Record);
+    if (ok && n1) ok = f.write((const uint8_t*)(buf_ + oldest), n1) == n1;
+    if (ok && n2) ok = f.write((const uint8_t*)buf_, n2) == n2;
+    f.close();
+    Serial.printf("FlightRec: saved %lu records to %s (%s)\n", (unsigned long)count_, path, ok ? "ok" : "error");
+    return ok;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+
+// 記録数の既定値（500Hz で約65秒、1.3MB。PSRAMがない場合は FLIGHT_REC_RECORDS_NO_PSRAM に縮小）
+#ifndef FLIGHT_REC_RECORDS
+#define FLIGHT_REC_RECORDS 32768
+#endif
+#ifndef FLIGHT_REC_RECORDS_NO_PSRAM
+#define FLIGHT_REC_RECORDS_NO_PSRAM 512
+#endif
+
+/**
+ * @brief フライトレコーダー（直近の制御状態をバイナリでリングに記録）
+ *
+ * IMU の1サンプル（ODR の全サンプル）につき1レコードを記録する。中身はバイアス補正前の生IMU、
+ * そのサンプルで更新した直後のフィルタ出力、その時点のサーボ指令カウント、そのサンプルを書き込んだ loop() の周期。
+ * サンプルは ImuSampler のキュー（SpscQueue）経由で受け取り、loop() がまとめて record() する
+ * （IMU 未接続時は loop() 1回につき1レコード）。ループ周期は loopUs で別に追える。
+ * トリガー（転倒検知・ボタン・コマンド・ループ停滞）がかかると、トリガー後 postTriggerMs
+ * （容量の半分まで）記録を続けてから凍結し、以降は dump 用に内容を保持する（rearm() で記録再開）。
+ * 取り出しは read() でレコード単位（シリアル/UDP の REC コマンド）か、saveTo() でファイル（SD）へ。
+ * ファイル形式は [FileHeader][Record × count]（古い順）。tools/pc_client/flightrec_decode.py で CSV に変換できる。
+ * loop() からのみ呼ぶこと（排他なし）。
+ */
+class FlightRecorder {
+public:
+    // 1レコード 40B（スケールは TYPE_CONTROL_V2 / TELEMETRY と同じ）
+    struct __attribute__((packed)) Record {
+        uint32_t tUs;           // サンプル時刻 micros()
+        int16_t acc[3];         // [g × 4096]
+        int16_t gyro[3];        // [deg/s × 16]（バイアス補正前の生値）
+        int16_t euler[3];       // roll, pitch, yaw [deg × 100]（オフセット補正前）
+        uint16_t servo[8];      // PCA9685 に書いたカウント（0-4095）
+        uint16_t loopUs;        // このレコードを書いた loop() の周期（65535で飽和）
+    };
+    static_assert(sizeof(Record) == 40, "Record layout changed");
+
+    // ダンプファイルの先頭（32B）
+    struct __attribute__((packed)) FileHeader {
+        char magic[4];          // "FREC"
+        uint8_t version;        // FILE_VERSION
+        uint8_t recordLen;      // sizeof(Record)
+        uint8_t reason;         // Reason
+        uint8_t reserved;
+        uint32_t count;         // レコード数
+        uint32_t triggerIndex;  // トリガー時点のレコード位置（古い順の index）
+        uint32_t triggerUs;     // トリガー時刻 micros()
+        uint32_t capacity;
+        uint8_t pad[8];
+    };
+    static_assert(sizeof(FileHeader) == 32, "FileHeader layout changed");
+    static constexpr uint8_t FILE_VERSION = 2;  // 2: IMU サンプル単位・生ジャイロ（1: loop() 単位）
+
+    enum Reason : uint8_t {
+        REASON_NONE = 0,
+        REASON_COMMAND = 1,  // REC コマンド
+        REASON_BUTTON = 2,   // ボタン操作
+        REASON_FALL = 3,     // 転倒検知（姿勢角が閾値超え）
+        REASON_STALL = 4,    // ループ停滞（周期が閾値超え）
+    };
+
+    enum class State : uint8_t {
+        DISABLED = 0,      // バッファ未確保
+        RECORDING = 1,
+        POST_TRIGGER = 2,  // トリガー後の記録中
+        FROZEN = 3,        // 凍結（dump 待ち）
+    };
+
+    // バッファを確保（PSRAM 優先）。records=0 なら既定値
+    bool begin(uint32_t records = 0);
+
+    void record(const Record& r);
+    // 記録を凍結（RECORDING 中のみ有効。以降のトリガーは無視）
+    void trigger(uint8_t reason);
+    // 内容を破棄して記録を再開
+    void rearm();
+
+    // 自動トリガーの閾値（0で無効）
+    void setFallThresholdDeg(float deg) { fallDeg_ = deg; }
+    void setStallThresholdUs(uint32_t us) { stallUs_ = us; }
+    // トリガー後も記録を続ける時間（0で即時凍結）
+    void setPostTriggerMs(uint32_t ms) { postMs_ = ms; }
+    // 姿勢角で転倒検知（|roll| か |pitch| が閾値を超えたらトリガー）
+    void checkFall(float rollDeg, float pitchDeg);
+    // ループ周期で停滞検知（閾値を超えたらトリガー）
+    void checkStall(uint32_t loopUs);
+
+    State state() const { return state_; }
+    uint8_t reason() const { return reason_; }
+    uint32_t count() const { return count_; }
+    uint32_t capacity() const { return capacity_; }
+    uint32_t triggerIndex() const;
+    // 古い順に index 番目のレコード
+    bool read(uint32_t index, Record& out) const;
+    void fillHeader(FileHeader& h) const;
+
+    // 凍結中の内容をファイルへ書き出す（FROZEN 以外は false）
+    bool saveTo(fs::FS& fs, const char* path) const;
+
+private:
+    Record* buf_ = nullptr;
+    uint32_t capacity_ = 0;
+    uint32_t head_ = 0;       // 次に書く位置
+    uint32_t count_ = 0;
+    uint32_t postLeft_ = 0;   // トリガー後に記録する残り数
+    uint32_t triggerPos_ = 0; // トリガー時点の head_
+    uint32_t triggerUs_ = 0;
+    uint8_t reason_ = REASON_NONE;
+    State state_ = State::DISABLED;
+    float fallDeg_ = 60.0f;
+    uint32_t stallUs_ = 200000;
+    uint32_t postMs_ = 1000;
+};
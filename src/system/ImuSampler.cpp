@@ -0,0 +1,117 @@
+#include "ImuSampler.h"
+
+ImuSampler* ImuSampler::instance_ = nullptr;
+
+bool ImuSampler::startTask(int intPin) {
+    if (!imu_ || task_) return task_ != nullptr;
+    instance_ = this;
+    // 1サンプルずつ読むので FIFO は止め、INT をパルス出力にする
+    imu_->setFifoMode(false);
+    imu_->sensor().setDataReadyInterrupt(true);
+    if (xTaskCreatePinnedToCore(taskEntry, "imu", 4096, this, TASK_PRIORITY, &task_, TASK_CORE) != pdPASS) {
+        task_ = nullptr;
+        imu_->sensor().setDataReadyInterrupt(false);
+        imu_->setFifoMode(true);
+        Serial.println("IMU: task create failed, using loop mode");
+        return false;
+    }
+    pinMode(intPin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(intPin), onDataReady, RISING);
+    Serial.printf("IMU: data-ready task on core %d (INT=GPIO%d, %.0fHz)\n",
+        (int)TASK_CORE, intPin, imu_->sensor().getSampleRateHz());
+    return true;
+}
+
+void IRAM_ATTR ImuSampler::onDataReady() {
+    ImuSampler* self = instance_;
+    if (!self || !self->task_) return;
+    self->isrUs_ = micros();
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(self->task_, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+void ImuSampler::taskEntry(void* arg) {
+    static_cast<ImuSampler*>(arg)->taskLoop();
+}
+
+void ImuSampler::taskLoop() {
+    for (;;) {
+        uint32_t n = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TASK_TIMEOUT_MS));
+        if (pauseReq_) {
+            // 要求を見た後に世代を読む（pause() は世代を進めてから要求を立てる）
+            pausedGen_ = pauseGen_;
+            continue;
+        }
+        if (n == 0) {
+            timeouts_++;
+            continue;
+        }
+        // 複数回通知されていたら、その分のサンプルは上書きされて失われている
+        if (n > 1) missed_ += n - 1;
+        uint32_t tUs = isrUs_;
+        imu_->updateAt(tUs);
+        samples_++;
+        publish(tUs);
+    }
+}
+
+void ImuSampler::poll() {
+    if (task_ || !imu_) return;
+    imu_->update();
+    publish(micros());
+}
+
+bool ImuSampler::pause() {
+    if (!task_) return true;
+    uint32_t gen = pauseGen_ + 1;
+    pauseGen_ = gen;
+    pauseReq_ = true;
+    xTaskNotifyGive(task_);
+    // 読み出し中のサンプルが終わり、タスクが今回の要求で止まるのを待つ
+    uint32_t startMs = millis();
+    while (pausedGen_ != gen) {
+        if (millis() - startMs >= TASK_TIMEOUT_MS * 2) {
+            pauseReq_ = false;
+            Serial.println("IMU: sampler task did not pause");
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+void ImuSampler::resume() {
+    pauseReq_ = false;
+}
+
+void ImuSampler::publish(uint32_t tUs) {
+    Estimate e;
+    e.tUs = tUs;
+    e.roll = imu_->getRoll();
+    e.pitch = imu_->getPitch();
+    e.yaw = imu_->getYaw();
+    imu_->getAccel(&e.ax, &e.ay, &e.az);
+    imu_->getGyro(&e.gx, &e.gy, &e.gz);
+    imu_->getGyroBias(&e.bx, &e.by, &e.bz, &e.biasConf);
+    e.stationary = imu_->isStationary();
+    e.temp = imu_->getTemperature();
+    e.seq = ++published_;
+    snapshot_.write(e);
+}
+
+// MPU6886_AHRS から1サンプルごとに呼ばれる（割り込みタスクか、ループモードでは loop()）
+void ImuSampler::onSample(void* ctx, uint32_t tUs) {
+    ImuSampler* self = static_cast<ImuSampler*>(ctx);
+    MPU6886_AHRS* imu = self->imu_;
+    Sample s;
+    s.tUs = tUs;
+    imu->getAccel(&s.ax, &s.ay, &s.az);
+    imu->getRawGyro(&s.gx, &s.gy, &s.gz);
+    imu->getGyroBias(&s.bx, &s.by, &s.bz);
+    AttitudeFilter& f = imu->filter();
+    s.roll = f.getRoll();
+    s.pitch = f.getPitch();
+    s.yaw = f.getYaw();
+    if (!self->queue_.push(s)) self->queueDrops_++;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <Arduino.h>
+#include "MPU6886_AHRS.h"
+#include "StateSnapshot.h"
+#include "SpscQueue.h"
+
+// MPU6886 の INT ピン（PORT.A 拡張の GPIO39）
+#ifndef IMU_INT_PIN
+#define IMU_INT_PIN 39
+#endif
+// 1: データレディ割り込みで起こす専用タスクでIMUを処理 / 0: loop() から FIFO を読む
+#ifndef IMU_USE_INT_TASK
+#define IMU_USE_INT_TASK 0
+#endif
+// サンプル単位キューの長さ（2のべき乗。500Hz で約0.5秒分、loop() が止まってもこの分は取りこぼさない）
+#ifndef IMU_SAMPLE_QUEUE_LEN
+#define IMU_SAMPLE_QUEUE_LEN 256
+#endif
+
+/**
+ * @brief IMU の取得・姿勢推定の実行と、最新推定値の公開
+ *
+ * 2つの動作モードがある。
+ * - 割り込みタスク（startTask()）: MPU6886 のデータレディ割り込みで優先度の高い専用タスクを起こし、
+ *   1サンプル読んで割り込み時刻を dt にフィルタを更新、結果を公開する。表示処理の負荷に関係なく
+ *   フィルタ周期が一定になる。I2C は Wire 側の排他でサーボ（PCA9685）書き込みと共存する。
+ * - ループ（poll()）: タスクが動いていないときは loop() から imu.update()（FIFOモード）を呼んで公開する。
+ * 利用側（loop()・AppIMU・テレメトリ）はどちらのモードでも latest() で読み、I2C には触れない。
+ * 公開は StateSnapshot（seqlock）なので、別コアから読んでも1回の更新でそろった組が得られる。
+ * 加えて、ODR の全サンプルを SpscQueue に積む（フライトレコーダー・UDPバッチ用）。
+ * 取り出しは popSample() で、loop() だけから呼ぶこと（満杯なら新しいサンプルを捨てて数える）。
+ */
+class ImuSampler {
+public:
+    // 公開する推定値（1回の更新でそろった組）
+    struct Estimate {
+        uint32_t tUs;              // サンプル時刻 micros()（割り込みタスクでは割り込み時刻）
+        uint32_t seq;              // 更新回数
+        float roll, pitch, yaw;    // [deg]（オフセット補正前）
+        float ax, ay, az;          // [g]
+        float gx, gy, gz;          // [deg/s]（バイアス補正後）
+        float bx, by, bz;          // ジャイロバイアス [deg/s]
+        float biasConf;            // バイアスの信頼度 0～1
+        bool stationary;           // 静止中（バイアス追従中）
+        float temp;                // [°C]
+    };
+
+    // 1サンプルごとの値（キューで loop() へ渡す）
+    struct Sample {
+        uint32_t tUs;              // サンプル時刻 micros()（FIFO では ODR 周期から推定）
+        float ax, ay, az;          // [g]
+        float gx, gy, gz;          // [deg/s]（バイアス補正前の生値）
+        float bx, by, bz;          // このサンプルの補正に使ったバイアス [deg/s]
+        float roll, pitch, yaw;    // このサンプルで更新した直後の姿勢 [deg]（オフセット補正前）
+    };
+
+    struct Stats {
+        uint32_t samples;   // タスクで処理したサンプル数
+        uint32_t missed;    // タスクが間に合わず読み飛ばした割り込み数
+        uint32_t timeouts;  // 割り込みが来なかった回数（INT 未接続など）
+        uint32_t queueDrops; // サンプルキューが満杯で捨てたサンプル数
+    };
+
+    // IMU を設定し、サンプルごとの通知を受け取る
+    void attach(MPU6886_AHRS* imu) {
+        imu_ = imu;
+        imu_->setSampleCallback(onSample, this);
+    }
+
+    // 割り込みタスクを開始（FIFOモードは解除する）。失敗時は false（ループモードのまま）
+    bool startTask(int intPin = IMU_INT_PIN);
+    bool taskRunning() const { return task_ != nullptr; }
+
+    // ループモード時の更新（タスク動作中は何もしない）
+    void poll();
+
+    // タスクを一時停止（キャリブレーションなど loop() から直接 IMU を触る間）。停止を確認してから戻る
+    // タスクが TASK_TIMEOUT_MS×2 以内に止まらなければ停止要求を取り下げて false（IMU に触れないこと）。
+    // true を返したら、触り終えたあと resume() を呼ぶ
+    bool pause();
+    void resume();
+
+    // 最新の推定値をコピーして世代を返す（どのタスクから呼んでもよい。0 は未公開）
+    uint32_t latest(Estimate& out) const { return snapshot_.read(out); }
+    // 現在の世代（前回の latest() と比べて新しい推定値があるか判定する）
+    uint32_t generation() const { return snapshot_.generation(); }
+    // キューから古い順に1サンプル取り出す（loop() からのみ）。空なら false
+    bool popSample(Sample& out) { return queue_.pop(out); }
+    Stats stats() const { return Stats{ samples_, missed_, timeouts_, queueDrops_ }; }
+
+private:
+    static constexpr UBaseType_t TASK_PRIORITY = 5;
+    static constexpr BaseType_t TASK_CORE = 1;          // WiFi（コア0）の影響を避ける
+    static constexpr uint32_t TASK_TIMEOUT_MS = 100;
+
+    static void IRAM_ATTR onDataReady();
+    static void taskEntry(void* arg);
+    void taskLoop();
+    void publish(uint32_t tUs);
+    static void onSample(void* ctx, uint32_t tUs);
+
+    static ImuSampler* instance_;  // ISR から参照
+    MPU6886_AHRS* imu_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    volatile uint32_t isrUs_ = 0;
+    // 停止要求ごとに pauseGen_ を進め、タスクは停止した時点の値を pausedGen_ へ返す
+    // （前回の停止の応答を今回の応答と取り違えないため）
+    volatile bool pauseReq_ = false;
+    volatile uint32_t pauseGen_ = 0;
+    volatile uint32_t pausedGen_ = 0;
+    volatile uint32_t samples_ = 0;
+    volatile uint32_t missed_ = 0;
+    volatile uint32_t timeouts_ = 0;
+    volatile uint32_t queueDrops_ = 0;
+
+    uint32_t published_ = 0;  // 書き込み側のみが触る
+    StateSnapshot<Estimate> snapshot_;
+    SpscQueue<Sample, IMU_SAMPLE_QUEUE_LEN> queue_;
+};
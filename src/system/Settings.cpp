@@ -1,4 +1,5 @@
 #include "Settings.h"
+#include <math.h>
 
 void Settings::begin() {
     prefs_.begin("rovate", false);  // 名前空間 "rovate"
@@ -10,6 +11,15 @@ void Settings::begin() {
     imuOutputEnabled_ = prefs_.getBool("imuOutput", true);
     controlRate_ = prefs_.getUShort("controlRate", 100);
     serialBaud_ = prefs_.getULong("serialBaud", 921600);
+    udpBatchSize_ = prefs_.getUChar("udpBatch", 1);
+    udpBatchMaxAgeMs_ = prefs_.getUShort("udpBatchAge", 20);
+    udpBroadcastFallback_ = prefs_.getBool("udpBcast", false);
+    trajLeadMs_ = prefs_.getUShort("trajLead", 100);
+    imuFilter_ = prefs_.getUChar("imuFilter", IMU_FILTER_BUILD_DEFAULT);
+    imuProfile_ = prefs_.getUChar("imuProfile", 0);
+    imuCalValid_ = prefs_.getBytesLength("imuCal") == sizeof(imuCal_) &&
+                   prefs_.getBytes("imuCal", &imuCal_, sizeof(imuCal_)) == sizeof(imuCal_) &&
+                   isValidImuCalibration(imuCal_);
     
     Serial.println("Settings: loaded from NVS");
     Serial.printf("  Serial Mode: %s\n", serialMode_ == SERIAL_BINARY ? "Binary" : "Text");
@@ -18,6 +28,58 @@ void Settings::begin() {
     Serial.printf("  IMU Output: %s\n", imuOutputEnabled_ ? "ON" : "OFF");
     Serial.printf("  Control Rate: %d Hz\n", controlRate_);
     Serial.printf("  Serial Baud: %lu bps\n", (unsigned long)serialBaud_);
+    Serial.printf("  UDP Batch: %u samples / %u ms\n", udpBatchSize_, udpBatchMaxAgeMs_);
+    Serial.printf("  UDP Broadcast Fallback: %s\n", udpBroadcastFallback_ ? "ON" : "OFF");
+    Serial.printf("  Trajectory Lead: %u ms\n", trajLeadMs_);
+    if (imuFilter_ == IMU_FILTER_BUILD_DEFAULT) {
+        Serial.println("  IMU Filter: build default");
+    } else {
+        Serial.printf("  IMU Filter: %u\n", imuFilter_);
+    }
+    Serial.printf("  IMU Profile: %u\n", imuProfile_);
+    if (imuCalValid_) {
+        Serial.printf("  IMU Cal: bias %.3f %.3f %.3f deg/s, offset %.2f %.2f deg @ %.1fC\n",
+                      imuCal_.gyroBias[0], imuCal_.gyroBias[1], imuCal_.gyroBias[2],
+                      imuCal_.rollOffset, imuCal_.pitchOffset, imuCal_.tempC);
+    } else {
+        Serial.println("  IMU Cal: none");
+    }
+}
+
+bool Settings::isValidImuCalibration(const ImuCalibration& cal) {
+    if (cal.version != IMU_CAL_VERSION) return false;
+    // 壊れた値・明らかにおかしい値は使わない（MPU6886 のバイアスは通常 ±数 deg/s）
+    for (int i = 0; i < 3; i++) {
+        if (!isfinite(cal.gyroBias[i]) || fabsf(cal.gyroBias[i]) > 20.0f) return false;
+    }
+    if (!isfinite(cal.rollOffset) || fabsf(cal.rollOffset) > 180.0f) return false;
+    if (!isfinite(cal.pitchOffset) || fabsf(cal.pitchOffset) > 90.0f) return false;
+    if (!isfinite(cal.tempC) || cal.tempC < -40.0f || cal.tempC > 100.0f) return false;
+    return true;
+}
+
+bool Settings::getImuCalibration(ImuCalibration& cal) const {
+    if (!imuCalValid_) return false;
+    cal = imuCal_;
+    return true;
+}
+
+void Settings::saveImuCalibration(const ImuCalibration& cal) {
+    ImuCalibration c = cal;
+    c.version = IMU_CAL_VERSION;
+    if (!isValidImuCalibration(c)) {
+        Serial.println("Settings: IMU calibration rejected (out of range)");
+        return;
+    }
+    imuCal_ = c;
+    imuCalValid_ = true;
+    prefs_.putBytes("imuCal", &imuCal_, sizeof(imuCal_));
+    Serial.println("Settings: IMU calibration saved to NVS");
+}
+
+void Settings::clearImuCalibration() {
+    imuCalValid_ = false;
+    prefs_.remove("imuCal");
 }
 
 void Settings::save() {
@@ -27,6 +89,12 @@ void Settings::save() {
     prefs_.putBool("imuOutput", imuOutputEnabled_);
     prefs_.putUShort("controlRate", controlRate_);
     prefs_.putULong("serialBaud", serialBaud_);
+    prefs_.putUChar("udpBatch", udpBatchSize_);
+    prefs_.putUShort("udpBatchAge", udpBatchMaxAgeMs_);
+    prefs_.putBool("udpBcast", udpBroadcastFallback_);
+    prefs_.putUShort("trajLead", trajLeadMs_);
+    prefs_.putUChar("imuFilter", imuFilter_);
+    prefs_.putUChar("imuProfile", imuProfile_);
     
     Serial.println("Settings: saved to NVS");
 }
@@ -12,6 +12,19 @@ public:
         SERIAL_TEXT = 1     // テキスト（JSON）通信
     };
 
+    /**
+     * @brief IMU校正値（NVS の "imuCal" に1ブロックで保存）
+     * yaw は起動ごとに 0 から始まるため、姿勢オフセットは roll / pitch のみ保存する
+     */
+    struct ImuCalibration {
+        uint8_t version;       // IMU_CAL_VERSION
+        float gyroBias[3];     // ジャイロバイアス [deg/s]
+        float rollOffset;      // 姿勢のゼロ点 [deg]
+        float pitchOffset;
+        float tempC;           // 校正時のセンサー温度 [°C]
+    };
+    static constexpr uint8_t IMU_CAL_VERSION = 1;
+
     static Settings& getInstance() {
         static Settings instance;
         return instance;
@@ -44,6 +57,35 @@ public:
     bool isImuOutputEnabled() const { return imuOutputEnabled_; }
     void setImuOutputEnabled(bool enabled) { imuOutputEnabled_ = enabled; }
 
+    // UDPバッチ送信（サンプル数<=1で無効、最大待ち時間ms）
+    uint8_t getUdpBatchSize() const { return udpBatchSize_; }
+    void setUdpBatchSize(uint8_t n) { udpBatchSize_ = n; }
+    uint16_t getUdpBatchMaxAgeMs() const { return udpBatchMaxAgeMs_; }
+    void setUdpBatchMaxAgeMs(uint16_t ms) { udpBatchMaxAgeMs_ = ms; }
+
+    // UDP購読者がいない時のブロードキャスト送信（既定OFF）
+    bool isUdpBroadcastFallback() const { return udpBroadcastFallback_; }
+    void setUdpBroadcastFallback(bool enabled) { udpBroadcastFallback_ = enabled; }
+
+    // 軌道再生の先行バッファ時間（ms、通信の揺らぎを吸収する分）
+    uint16_t getTrajectoryLeadMs() const { return trajLeadMs_; }
+    void setTrajectoryLeadMs(uint16_t ms) { trajLeadMs_ = ms; }
+
+    // IMU姿勢フィルタ（MPU6886_AHRS::FilterType の値、IMU_FILTER_BUILD_DEFAULT ならビルド時の既定）
+    static constexpr uint8_t IMU_FILTER_BUILD_DEFAULT = 0xFF;
+    uint8_t getImuFilter() const { return imuFilter_; }
+    void setImuFilter(uint8_t type) { imuFilter_ = type; }
+
+    // IMUセンサー設定のプロファイル（MPU6886::Profile の値）。動作中に変更すると loop() で適用される
+    uint8_t getImuProfile() const { return imuProfile_; }
+    void setImuProfile(uint8_t profile) { imuProfile_ = profile; }
+
+    // IMU校正値（起動時に読み込み済み。有効な値がなければ false）
+    bool getImuCalibration(ImuCalibration& cal) const;
+    // 校正値をすぐにNVSへ保存（save() とは別。校正完了時のみ書き込む）
+    void saveImuCalibration(const ImuCalibration& cal);
+    void clearImuCalibration();
+
 private:
     Settings() = default;
     Settings(const Settings&) = delete;
@@ -56,4 +98,14 @@ private:
     bool imuOutputEnabled_ = true;  // IMUデータ出力
     uint16_t controlRate_ = 100;  // Hz
     uint32_t serialBaud_ = 921600;  // bps
+    uint8_t udpBatchSize_ = 1;       // 1 = バッチ無効
+    uint16_t udpBatchMaxAgeMs_ = 20; // ms
+    bool udpBroadcastFallback_ = false;
+    uint16_t trajLeadMs_ = 100;      // ms
+    uint8_t imuFilter_ = IMU_FILTER_BUILD_DEFAULT;
+    uint8_t imuProfile_ = 0;         // MPU6886::PROFILE_DEFAULT
+    ImuCalibration imuCal_ = {};
+    bool imuCalValid_ = false;
+
+    static bool isValidImuCalibration(const ImuCalibration& cal);
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 1プロデューサー・1コンシューマーの固定長キュー（ロックなし）
+ *
+ * push() は1つのタスク（IMU の割り込みタスクなど）から、pop() は別の1つのタスク（loop()）からだけ呼ぶこと。
+ * 書き込み位置・読み出し位置はそれぞれ片側だけが進めるので、ロックもクリティカルセクションも要らない。
+ * 満杯のときの push() は false を返して新しい要素を捨てる（取りこぼしは呼び出し側で数える）。
+ * N は2のべき乗。T はコピーできる型であること。
+ */
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+    bool push(const T& value) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= N) return false;
+        buf_[head & (N - 1)] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        out = buf_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 滞留数（どちらの側から読んでもよいが、目安）
+    size_t size() const {
+        return (size_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    std::atomic<uint32_t> head_{0};  // プロデューサーだけが進める
+    std::atomic<uint32_t> tail_{0};  // コンシューマーだけが進める
+    T buf_[N];
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <string.h>
+
+/**
+ * @brief 1ライター・複数リーダーの状態スナップショット（seqlock）
+ *
+ * ライターは書き込み中だけ世代カウンタを奇数にし、書き終えたら偶数に戻す。
+ * リーダーは前後で同じ偶数が読めたときだけコピーを採用するので、別の更新が混ざった値（ちぎれた読み）は返らない。
+ * ライターはロックもリーダー待ちもしない（ISR以外のタスクから、1つのタスクだけが write() すること）。
+ * リーダーは書き込みと重なったときだけ読み直す（書き込みはコピー1回分なので通常はすぐ終わる）。
+ * T は memcpy でコピーできる型であること。
+ */
+template <typename T>
+class StateSnapshot {
+public:
+    // 新しい値を公開
+    void write(const T& value) {
+        uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&data_, &value, sizeof(T));
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // 最新の値をコピーし、その世代を返す（0 ならまだ一度も書かれていない）
+    uint32_t read(T& out) const {
+        for (;;) {
+            uint32_t s1 = seq_.load(std::memory_order_acquire);
+            if (s1 & 1) continue;  // 書き込み中
+            memcpy(&out, &data_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == s1) return s1 / 2;
+        }
+    }
+
+    // 現在の世代（前回 read() の戻り値と比べて新しい値があるか判定する）
+    uint32_t generation() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+private:
+    std::atomic<uint32_t> seq_{0};
+    T data_ = T();
+};
@@ -1,5 +1,6 @@
 #include "CommProtocol.h"
 #include <string.h>
+#include <math.h>
 
 namespace CommProtocol {
 
@@ -8,8 +9,159 @@ static inline void write_u16le(uint8_t* p, uint16_t v) {
     p[1] = (uint8_t)((v >> 8) & 0xFF);
 }
 
-uint16_t crc16_ccitt(const uint8_t* data, size_t len) {
-    uint16_t crc = 0xFFFF;
+static inline void write_u32le(uint8_t* p, uint32_t v) {
+    write_u16le(p, (uint16_t)(v & 0xFFFF));
+    write_u16le(p + 2, (uint16_t)(v >> 16));
+}
+
+// CRC16-CCITT (poly 0x1021) の参照テーブル。
+// T0[x] = 1バイト x を処理した結果、Tn[x] = T0[x] の後に 0x00 を n バイト処理した結果。
+// static const のためフラッシュ（.rodata）に配置される。
+#if COMM_CRC16_IMPL >= 1
+static const uint16_t kCrc16Table0[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+#endif
+
+#if COMM_CRC16_IMPL >= 2
+static const uint16_t kCrc16Table1[256] = {
+    0x0000, 0x3331, 0x6662, 0x5553, 0xCCC4, 0xFFF5, 0xAAA6, 0x9997,
+    0x89A9, 0xBA98, 0xEFCB, 0xDCFA, 0x456D, 0x765C, 0x230F, 0x103E,
+    0x0373, 0x3042, 0x6511, 0x5620, 0xCFB7, 0xFC86, 0xA9D5, 0x9AE4,
+    0x8ADA, 0xB9EB, 0xECB8, 0xDF89, 0x461E, 0x752F, 0x207C, 0x134D,
+    0x06E6, 0x35D7, 0x6084, 0x53B5, 0xCA22, 0xF913, 0xAC40, 0x9F71,
+    0x8F4F, 0xBC7E, 0xE92D, 0xDA1C, 0x438B, 0x70BA, 0x25E9, 0x16D8,
+    0x0595, 0x36A4, 0x63F7, 0x50C6, 0xC951, 0xFA60, 0xAF33, 0x9C02,
+    0x8C3C, 0xBF0D, 0xEA5E, 0xD96F, 0x40F8, 0x73C9, 0x269A, 0x15AB,
+    0x0DCC, 0x3EFD, 0x6BAE, 0x589F, 0xC108, 0xF239, 0xA76A, 0x945B,
+    0x8465, 0xB754, 0xE207, 0xD136, 0x48A1, 0x7B90, 0x2EC3, 0x1DF2,
+    0x0EBF, 0x3D8E, 0x68DD, 0x5BEC, 0xC27B, 0xF14A, 0xA419, 0x9728,
+    0x8716, 0xB427, 0xE174, 0xD245, 0x4BD2, 0x78E3, 0x2DB0, 0x1E81,
+    0x0B2A, 0x381B, 0x6D48, 0x5E79, 0xC7EE, 0xF4DF, 0xA18C, 0x92BD,
+    0x8283, 0xB1B2, 0xE4E1, 0xD7D0, 0x4E47, 0x7D76, 0x2825, 0x1B14,
+    0x0859, 0x3B68, 0x6E3B, 0x5D0A, 0xC49D, 0xF7AC, 0xA2FF, 0x91CE,
+    0x81F0, 0xB2C1, 0xE792, 0xD4A3, 0x4D34, 0x7E05, 0x2B56, 0x1867,
+    0x1B98, 0x28A9, 0x7DFA, 0x4ECB, 0xD75C, 0xE46D, 0xB13E, 0x820F,
+    0x9231, 0xA100, 0xF453, 0xC762, 0x5EF5, 0x6DC4, 0x3897, 0x0BA6,
+    0x18EB, 0x2BDA, 0x7E89, 0x4DB8, 0xD42F, 0xE71E, 0xB24D, 0x817C,
+    0x9142, 0xA273, 0xF720, 0xC411, 0x5D86, 0x6EB7, 0x3BE4, 0x08D5,
+    0x1D7E, 0x2E4F, 0x7B1C, 0x482D, 0xD1BA, 0xE28B, 0xB7D8, 0x84E9,
+    0x94D7, 0xA7E6, 0xF2B5, 0xC184, 0x5813, 0x6B22, 0x3E71, 0x0D40,
+    0x1E0D, 0x2D3C, 0x786F, 0x4B5E, 0xD2C9, 0xE1F8, 0xB4AB, 0x879A,
+    0x97A4, 0xA495, 0xF1C6, 0xC2F7, 0x5B60, 0x6851, 0x3D02, 0x0E33,
+    0x1654, 0x2565, 0x7036, 0x4307, 0xDA90, 0xE9A1, 0xBCF2, 0x8FC3,
+    0x9FFD, 0xACCC, 0xF99F, 0xCAAE, 0x5339, 0x6008, 0x355B, 0x066A,
+    0x1527, 0x2616, 0x7345, 0x4074, 0xD9E3, 0xEAD2, 0xBF81, 0x8CB0,
+    0x9C8E, 0xAFBF, 0xFAEC, 0xC9DD, 0x504A, 0x637B, 0x3628, 0x0519,
+    0x10B2, 0x2383, 0x76D0, 0x45E1, 0xDC76, 0xEF47, 0xBA14, 0x8925,
+    0x991B, 0xAA2A, 0xFF79, 0xCC48, 0x55DF, 0x66EE, 0x33BD, 0x008C,
+    0x13C1, 0x20F0, 0x75A3, 0x4692, 0xDF05, 0xEC34, 0xB967, 0x8A56,
+    0x9A68, 0xA959, 0xFC0A, 0xCF3B, 0x56AC, 0x659D, 0x30CE, 0x03FF,
+};
+
+static const uint16_t kCrc16Table2[256] = {
+    0x0000, 0x3730, 0x6E60, 0x5950, 0xDCC0, 0xEBF0, 0xB2A0, 0x8590,
+    0xA9A1, 0x9E91, 0xC7C1, 0xF0F1, 0x7561, 0x4251, 0x1B01, 0x2C31,
+    0x4363, 0x7453, 0x2D03, 0x1A33, 0x9FA3, 0xA893, 0xF1C3, 0xC6F3,
+    0xEAC2, 0xDDF2, 0x84A2, 0xB392, 0x3602, 0x0132, 0x5862, 0x6F52,
+    0x86C6, 0xB1F6, 0xE8A6, 0xDF96, 0x5A06, 0x6D36, 0x3466, 0x0356,
+    0x2F67, 0x1857, 0x4107, 0x7637, 0xF3A7, 0xC497, 0x9DC7, 0xAAF7,
+    0xC5A5, 0xF295, 0xABC5, 0x9CF5, 0x1965, 0x2E55, 0x7705, 0x4035,
+    0x6C04, 0x5B34, 0x0264, 0x3554, 0xB0C4, 0x87F4, 0xDEA4, 0xE994,
+    0x1DAD, 0x2A9D, 0x73CD, 0x44FD, 0xC16D, 0xF65D, 0xAF0D, 0x983D,
+    0xB40C, 0x833C, 0xDA6C, 0xED5C, 0x68CC, 0x5FFC, 0x06AC, 0x319C,
+    0x5ECE, 0x69FE, 0x30AE, 0x079E, 0x820E, 0xB53E, 0xEC6E, 0xDB5E,
+    0xF76F, 0xC05F, 0x990F, 0xAE3F, 0x2BAF, 0x1C9F, 0x45CF, 0x72FF,
+    0x9B6B, 0xAC5B, 0xF50B, 0xC23B, 0x47AB, 0x709B, 0x29CB, 0x1EFB,
+    0x32CA, 0x05FA, 0x5CAA, 0x6B9A, 0xEE0A, 0xD93A, 0x806A, 0xB75A,
+    0xD808, 0xEF38, 0xB668, 0x8158, 0x04C8, 0x33F8, 0x6AA8, 0x5D98,
+    0x71A9, 0x4699, 0x1FC9, 0x28F9, 0xAD69, 0x9A59, 0xC309, 0xF439,
+    0x3B5A, 0x0C6A, 0x553A, 0x620A, 0xE79A, 0xD0AA, 0x89FA, 0xBECA,
+    0x92FB, 0xA5CB, 0xFC9B, 0xCBAB, 0x4E3B, 0x790B, 0x205B, 0x176B,
+    0x7839, 0x4F09, 0x1659, 0x2169, 0xA4F9, 0x93C9, 0xCA99, 0xFDA9,
+    0xD198, 0xE6A8, 0xBFF8, 0x88C8, 0x0D58, 0x3A68, 0x6338, 0x5408,
+    0xBD9C, 0x8AAC, 0xD3FC, 0xE4CC, 0x615C, 0x566C, 0x0F3C, 0x380C,
+    0x143D, 0x230D, 0x7A5D, 0x4D6D, 0xC8FD, 0xFFCD, 0xA69D, 0x91AD,
+    0xFEFF, 0xC9CF, 0x909F, 0xA7AF, 0x223F, 0x150F, 0x4C5F, 0x7B6F,
+    0x575E, 0x606E, 0x393E, 0x0E0E, 0x8B9E, 0xBCAE, 0xE5FE, 0xD2CE,
+    0x26F7, 0x11C7, 0x4897, 0x7FA7, 0xFA37, 0xCD07, 0x9457, 0xA367,
+    0x8F56, 0xB866, 0xE136, 0xD606, 0x5396, 0x64A6, 0x3DF6, 0x0AC6,
+    0x6594, 0x52A4, 0x0BF4, 0x3CC4, 0xB954, 0x8E64, 0xD734, 0xE004,
+    0xCC35, 0xFB05, 0xA255, 0x9565, 0x10F5, 0x27C5, 0x7E95, 0x49A5,
+    0xA031, 0x9701, 0xCE51, 0xF961, 0x7CF1, 0x4BC1, 0x1291, 0x25A1,
+    0x0990, 0x3EA0, 0x67F0, 0x50C0, 0xD550, 0xE260, 0xBB30, 0x8C00,
+    0xE352, 0xD462, 0x8D32, 0xBA02, 0x3F92, 0x08A2, 0x51F2, 0x66C2,
+    0x4AF3, 0x7DC3, 0x2493, 0x13A3, 0x9633, 0xA103, 0xF853, 0xCF63,
+};
+
+static const uint16_t kCrc16Table3[256] = {
+    0x0000, 0x76B4, 0xED68, 0x9BDC, 0xCAF1, 0xBC45, 0x2799, 0x512D,
+    0x85C3, 0xF377, 0x68AB, 0x1E1F, 0x4F32, 0x3986, 0xA25A, 0xD4EE,
+    0x1BA7, 0x6D13, 0xF6CF, 0x807B, 0xD156, 0xA7E2, 0x3C3E, 0x4A8A,
+    0x9E64, 0xE8D0, 0x730C, 0x05B8, 0x5495, 0x2221, 0xB9FD, 0xCF49,
+    0x374E, 0x41FA, 0xDA26, 0xAC92, 0xFDBF, 0x8B0B, 0x10D7, 0x6663,
+    0xB28D, 0xC439, 0x5FE5, 0x2951, 0x787C, 0x0EC8, 0x9514, 0xE3A0,
+    0x2CE9, 0x5A5D, 0xC181, 0xB735, 0xE618, 0x90AC, 0x0B70, 0x7DC4,
+    0xA92A, 0xDF9E, 0x4442, 0x32F6, 0x63DB, 0x156F, 0x8EB3, 0xF807,
+    0x6E9C, 0x1828, 0x83F4, 0xF540, 0xA46D, 0xD2D9, 0x4905, 0x3FB1,
+    0xEB5F, 0x9DEB, 0x0637, 0x7083, 0x21AE, 0x571A, 0xCCC6, 0xBA72,
+    0x753B, 0x038F, 0x9853, 0xEEE7, 0xBFCA, 0xC97E, 0x52A2, 0x2416,
+    0xF0F8, 0x864C, 0x1D90, 0x6B24, 0x3A09, 0x4CBD, 0xD761, 0xA1D5,
+    0x59D2, 0x2F66, 0xB4BA, 0xC20E, 0x9323, 0xE597, 0x7E4B, 0x08FF,
+    0xDC11, 0xAAA5, 0x3179, 0x47CD, 0x16E0, 0x6054, 0xFB88, 0x8D3C,
+    0x4275, 0x34C1, 0xAF1D, 0xD9A9, 0x8884, 0xFE30, 0x65EC, 0x1358,
+    0xC7B6, 0xB102, 0x2ADE, 0x5C6A, 0x0D47, 0x7BF3, 0xE02F, 0x969B,
+    0xDD38, 0xAB8C, 0x3050, 0x46E4, 0x17C9, 0x617D, 0xFAA1, 0x8C15,
+    0x58FB, 0x2E4F, 0xB593, 0xC327, 0x920A, 0xE4BE, 0x7F62, 0x09D6,
+    0xC69F, 0xB02B, 0x2BF7, 0x5D43, 0x0C6E, 0x7ADA, 0xE106, 0x97B2,
+    0x435C, 0x35E8, 0xAE34, 0xD880, 0x89AD, 0xFF19, 0x64C5, 0x1271,
+    0xEA76, 0x9CC2, 0x071E, 0x71AA, 0x2087, 0x5633, 0xCDEF, 0xBB5B,
+    0x6FB5, 0x1901, 0x82DD, 0xF469, 0xA544, 0xD3F0, 0x482C, 0x3E98,
+    0xF1D1, 0x8765, 0x1CB9, 0x6A0D, 0x3B20, 0x4D94, 0xD648, 0xA0FC,
+    0x7412, 0x02A6, 0x997A, 0xEFCE, 0xBEE3, 0xC857, 0x538B, 0x253F,
+    0xB3A4, 0xC510, 0x5ECC, 0x2878, 0x7955, 0x0FE1, 0x943D, 0xE289,
+    0x3667, 0x40D3, 0xDB0F, 0xADBB, 0xFC96, 0x8A22, 0x11FE, 0x674A,
+    0xA803, 0xDEB7, 0x456B, 0x33DF, 0x62F2, 0x1446, 0x8F9A, 0xF92E,
+    0x2DC0, 0x5B74, 0xC0A8, 0xB61C, 0xE731, 0x9185, 0x0A59, 0x7CED,
+    0x84EA, 0xF25E, 0x6982, 0x1F36, 0x4E1B, 0x38AF, 0xA373, 0xD5C7,
+    0x0129, 0x779D, 0xEC41, 0x9AF5, 0xCBD8, 0xBD6C, 0x26B0, 0x5004,
+    0x9F4D, 0xE9F9, 0x7225, 0x0491, 0x55BC, 0x2308, 0xB8D4, 0xCE60,
+    0x1A8E, 0x6C3A, 0xF7E6, 0x8152, 0xD07F, 0xA6CB, 0x3D17, 0x4BA3,
+};
+#endif
+
+uint16_t crc16_ccitt_bitwise(uint16_t crc, const uint8_t* data, size_t len) {
     for (size_t i = 0; i < len; ++i) {
         crc ^= (uint16_t)data[i] << 8;
         for (int j = 0; j < 8; ++j) {
@@ -20,6 +172,32 @@ uint16_t crc16_ccitt(const uint8_t* data, size_t len) {
     return crc;
 }
 
+uint16_t crc16_ccitt_update(uint16_t crc, const uint8_t* data, size_t len) {
+#if COMM_CRC16_IMPL == 0
+    return crc16_ccitt_bitwise(crc, data, len);
+#else
+#if COMM_CRC16_IMPL >= 2
+    // slice-by-4: 4バイトごとに4テーブル参照で一括処理
+    while (len >= 4) {
+        uint16_t c = crc ^ (uint16_t)(((uint16_t)data[0] << 8) | data[1]);
+        crc = kCrc16Table3[c >> 8] ^ kCrc16Table2[c & 0xFF]
+            ^ kCrc16Table1[data[2]] ^ kCrc16Table0[data[3]];
+        data += 4;
+        len -= 4;
+    }
+#endif
+    // 1バイトずつテーブル参照（slice-by-4 の端数もここで処理）
+    while (len--) {
+        crc = (uint16_t)(crc << 8) ^ kCrc16Table0[(uint8_t)(crc >> 8) ^ *data++];
+    }
+    return crc;
+#endif
+}
+
+uint16_t crc16_ccitt(const uint8_t* data, size_t len) {
+    return crc16_ccitt_update(CRC16_INIT, data, len);
+}
+
 size_t buildControlPacket(
     uint8_t* out, size_t outMax,
     float ax, float ay, float az,
@@ -80,4 +258,328 @@ size_t buildControlPacket(
     return (size_t)(p - out);
 }
 
+static inline int16_t to_q15(float v, float lsbPerUnit) {
+    float q = v * lsbPerUnit;
+    if (q > 32767.0f) return 32767;
+    if (q < -32768.0f) return -32768;
+    return (int16_t)lroundf(q);
+}
+
+size_t ControlV2Encoder::writeRecord(uint8_t* out, size_t outMax, const ControlSample& s) {
+    // 変化したサーボを抽出
+    bool full = !primed_ || sinceFull_ >= FULL_INTERVAL;
+    uint8_t mask = 0;
+    size_t changed = 0;
+    for (int i = 0; i < 8; ++i) {
+        uint16_t pos = s.servoPos8 ? s.servoPos8[i] : 0;
+        uint16_t off = s.servoOff8 ? s.servoOff8[i] : 0;
+        if (full || pos != lastPos_[i] || off != lastOff_[i]) {
+            mask |= (uint8_t)(1u << i);
+            changed++;
+        }
+    }
+
+    const size_t recordLen = FIXED_PAYLOAD_LEN + changed * 4;
+    if (!out || outMax < recordLen) return 0;
+
+    uint8_t* p = out;
+    // timestamp
+    write_u16le(p, (uint16_t)(s.timestampUs & 0xFFFF)); p += 2;
+    write_u16le(p, (uint16_t)(s.timestampUs >> 16)); p += 2;
+    // accel / gyro / euler
+    const float vals[9] = { s.ax, s.ay, s.az, s.gx, s.gy, s.gz, s.roll, s.pitch, s.yaw };
+    const float scales[3] = { V2_ACCEL_LSB_PER_G, V2_GYRO_LSB_PER_DPS, V2_EULER_LSB_PER_DEG };
+    for (int i = 0; i < 9; ++i) {
+        write_u16le(p, (uint16_t)to_q15(vals[i], scales[i / 3])); p += 2;
+    }
+    *p++ = s.tempByte;
+    // servo delta
+    *p++ = mask;
+    for (int i = 0; i < 8; ++i) {
+        if (!(mask & (1u << i))) continue;
+        uint16_t pos = s.servoPos8 ? s.servoPos8[i] : 0;
+        uint16_t off = s.servoOff8 ? s.servoOff8[i] : 0;
+        write_u16le(p, pos); p += 2;
+        write_u16le(p, off); p += 2;
+        lastPos_[i] = pos;
+        lastOff_[i] = off;
+    }
+    primed_ = true;
+    sinceFull_ = full ? 0 : (uint8_t)(sinceFull_ + 1);
+
+    return (size_t)(p - out);
+}
+
+size_t ControlV2Encoder::build(uint8_t* out, size_t outMax, const ControlSample& s, uint16_t seq, bool addEtx) {
+    const size_t trailer = 2 + (addEtx ? 1 : 0);
+    if (!out || outMax < HEADER_LEN + trailer) return 0;
+
+    size_t payloadLen = writeRecord(out + HEADER_LEN, outMax - HEADER_LEN - trailer, s);
+    if (payloadLen == 0) return 0;
+
+    uint8_t* p = out;
+    *p++ = SYNC0;
+    *p++ = SYNC1;
+    *p++ = VERSION;
+    *p++ = TYPE_CONTROL_V2;
+    write_u16le(p, seq); p += 2;
+    write_u16le(p, (uint16_t)payloadLen); p += 2;
+    p += payloadLen;
+
+    // CRC over header+payload（TYPE_CONTROL と同じ範囲）
+    uint16_t crc = crc16_ccitt(out, HEADER_LEN + payloadLen);
+    write_u16le(p, crc); p += 2;
+    if (addEtx) { *p++ = ETX; }
+
+    return (size_t)(p - out);
+}
+
+bool TelemetryWriter::begin(uint16_t seq, uint32_t timestampUs) {
+    const size_t trailer = 2 + (addEtx_ ? 1 : 0);
+    if (!out_ || outMax_ < HEADER_LEN + 4 + trailer) return false;
+    uint8_t* p = out_;
+    *p++ = SYNC0;
+    *p++ = SYNC1;
+    *p++ = VERSION;
+    *p++ = TYPE_TELEMETRY;
+    write_u16le(p, seq); p += 2;
+    p += 2;  // LEN は finish() で埋める
+    write_u16le(p, (uint16_t)(timestampUs & 0xFFFF)); p += 2;
+    write_u16le(p, (uint16_t)(timestampUs >> 16)); p += 2;
+    len_ = (size_t)(p - out_);
+    return true;
+}
+
+uint8_t* TelemetryWriter::section(uint8_t id, uint8_t len) {
+    const size_t trailer = 2 + (addEtx_ ? 1 : 0);
+    if (len_ == 0 || len_ + 2 + len + trailer > outMax_) return nullptr;
+    uint8_t* p = out_ + len_;
+    p[0] = id;
+    p[1] = len;
+    len_ += 2 + len;
+    return p + 2;
+}
+
+size_t TelemetryWriter::finish() {
+    if (len_ == 0) return 0;
+    write_u16le(out_ + 6, (uint16_t)(len_ - HEADER_LEN));
+    uint16_t crc = crc16_ccitt(out_, len_);
+    uint8_t* p = out_ + len_;
+    write_u16le(p, crc); p += 2;
+    if (addEtx_) { *p++ = ETX; }
+    size_t n = (size_t)(p - out_);
+    len_ = 0;
+    return n;
+}
+
+bool writeStandardSections(TelemetryWriter& w, const ControlSample& s, uint8_t mask) {
+    if (mask & secBit(SEC_ATTITUDE)) {
+        uint8_t* p = w.section(SEC_ATTITUDE, 6);
+        if (!p) return false;
+        write_u16le(p + 0, (uint16_t)to_q15(s.roll, V2_EULER_LSB_PER_DEG));
+        write_u16le(p + 2, (uint16_t)to_q15(s.pitch, V2_EULER_LSB_PER_DEG));
+        write_u16le(p + 4, (uint16_t)to_q15(s.yaw, V2_EULER_LSB_PER_DEG));
+    }
+    if (mask & secBit(SEC_IMU)) {
+        uint8_t* p = w.section(SEC_IMU, 13);
+        if (!p) return false;
+        const float vals[6] = { s.ax, s.ay, s.az, s.gx, s.gy, s.gz };
+        for (int i = 0; i < 6; ++i) {
+            float scale = i < 3 ? V2_ACCEL_LSB_PER_G : V2_GYRO_LSB_PER_DPS;
+            write_u16le(p + i * 2, (uint16_t)to_q15(vals[i], scale));
+        }
+        p[12] = s.tempByte;
+    }
+    if (mask & secBit(SEC_SERVO)) {
+        uint8_t* p = w.section(SEC_SERVO, 32);
+        if (!p) return false;
+        for (int i = 0; i < 8; ++i) {
+            write_u16le(p + i * 2, s.servoPos8 ? s.servoPos8[i] : 0);
+            write_u16le(p + 16 + i * 2, s.servoOff8 ? s.servoOff8[i] : 0);
+        }
+    }
+    if ((mask & secBit(SEC_LOOP)) && s.loop) {
+        uint8_t* p = w.section(SEC_LOOP, 10);
+        if (!p) return false;
+        write_u16le(p + 0, s.loop->loopHz);
+        write_u16le(p + 2, s.loop->avgUs);
+        write_u16le(p + 4, s.loop->maxUs);
+        write_u32le(p + 6, s.loop->freeHeap);
+    }
+    return true;
+}
+
+bool writeLinkSection(TelemetryWriter& w, const LinkStats& link) {
+    uint8_t* p = w.section(SEC_LINK, LINK_SECTION_LEN);
+    if (!p) return false;
+    write_u32le(p + 0, link.txPackets);
+    write_u32le(p + 4, link.txDropped);
+    write_u32le(p + 8, link.rxGood);
+    write_u32le(p + 12, link.rxBad);
+    p[16] = (uint8_t)link.rssi;
+    // 17B 以降は後から追加した項目（旧クライアントは先頭17Bだけ読めばよい）
+    write_u16le(p + 17, link.txPacketsPerSec);
+    write_u32le(p + 19, link.txBytesPerSec);
+    write_u32le(p + 23, link.rxSeqGaps);
+    write_u32le(p + 27, link.rxSeqReorders);
+    write_u32le(p + 31, link.rxSeqResyncs);
+    write_u32le(p + 35, link.rxSuperseded);
+    write_u32le(p + 39, link.rxAgeUs);
+    write_u32le(p + 43, link.rxMaxAgeUs);
+    return true;
+}
+
+size_t buildTelemetryFrame(uint8_t* out, size_t outMax, const ControlSample& s,
+    uint16_t seq, uint8_t mask, bool addEtx, const LinkStats* link) {
+    TelemetryWriter w(out, outMax, addEtx);
+    if (!w.begin(seq, s.timestampUs)) return 0;
+    if (!writeStandardSections(w, s, mask)) return 0;
+    if (link && (mask & secBit(SEC_LINK)) && !writeLinkSection(w, *link)) return 0;
+    return w.finish();
+}
+
+size_t buildLegacyImuPacket(uint8_t* out, size_t outMax, const ControlSample& s) {
+    if (!out || outMax < LEGACY_IMU_LEN) return 0;
+    out[0] = SYNC0;
+    out[1] = SYNC1;
+    const float vals[6] = { s.roll, s.pitch, s.yaw, s.gx, s.gy, s.gz };
+    memcpy(out + 2, vals, sizeof(vals));
+    out[26] = s.tempByte;
+    return LEGACY_IMU_LEN;
+}
+
+size_t buildCommandFrame(
+    uint8_t* out, size_t outMax,
+    uint8_t type, uint16_t seq,
+    const uint8_t* payload, uint16_t payloadLen,
+    bool addEtx) {
+
+    const size_t totalLen = HEADER_LEN + payloadLen + 2 + (addEtx ? 1 : 0);
+    if (!out || outMax < totalLen) return 0;
+
+    uint8_t* p = out;
+    *p++ = SYNC0;
+    *p++ = SYNC1;
+    *p++ = VERSION;
+    *p++ = type;
+    write_u16le(p, seq); p += 2;
+    write_u16le(p, payloadLen); p += 2;
+    if (payloadLen > 0) { memcpy(p, payload, payloadLen); p += payloadLen; }
+
+    // CRC over VER～PAYLOAD（SYNC除く）
+    uint16_t crc = crc16_ccitt(out + 2, HEADER_LEN - 2 + payloadLen);
+    write_u16le(p, crc); p += 2;
+    if (addEtx) { *p++ = ETX; }
+
+    return (size_t)(p - out);
+}
+
+bool parseFrame(const uint8_t* data, size_t len, Frame& out) {
+    if (!data || len < HEADER_LEN + 2) return false;
+    if (data[0] != SYNC0 || data[1] != SYNC1) return false;
+    uint16_t payloadLen = (uint16_t)(data[6] | (data[7] << 8));
+    size_t body = HEADER_LEN + payloadLen + 2;
+    if (len != body && !(len == body + 1 && data[body] == ETX)) return false;
+
+    uint16_t calc = crc16_ccitt(data + 2, HEADER_LEN - 2 + payloadLen);
+    uint16_t recv = (uint16_t)(data[HEADER_LEN + payloadLen] | (data[HEADER_LEN + payloadLen + 1] << 8));
+    if (calc != recv) return false;
+
+    out.ver = data[2];
+    out.type = data[3];
+    out.seq = (uint16_t)(data[4] | (data[5] << 8));
+    out.payload = data + HEADER_LEN;
+    out.len = payloadLen;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FrameDecoder
+// ---------------------------------------------------------------------------
+
+// 次の判定に必要なバイト数（buf_ に溜まるまで待つ量）
+size_t FrameDecoder::needed() const {
+    if (n_ < 2) return 2 - n_;
+    if (n_ < HEADER_LEN) return HEADER_LEN - n_;
+    uint16_t len = (uint16_t)(buf_[6] | (buf_[7] << 8));
+    return frameSize(len) - n_;
+}
+
+// buf_[1..n_) から次の SYNC 候補を探し、先頭へ詰める
+void FrameDecoder::rescan() {
+    stats_.resync++;
+    size_t i = 1;
+    for (; i < n_; ++i) {
+        if (buf_[i] != SYNC0) continue;
+        if (i + 1 == n_ || buf_[i + 1] == SYNC1) break;
+    }
+    n_ -= i;
+    if (n_ > 0) memmove(buf_, buf_ + i, n_);
+}
+
+// buf_ の内容で判定を1段進める。進めた場合 true
+bool FrameDecoder::step() {
+    if (n_ >= 1 && buf_[0] != SYNC0) {
+        rescan();
+        return true;
+    }
+    if (n_ >= 2 && buf_[1] != SYNC1) {
+        rescan();
+        return true;
+    }
+    if (n_ < HEADER_LEN) return false;
+
+    uint16_t len = (uint16_t)(buf_[6] | (buf_[7] << 8));
+    if (len > MAX_RX_PAYLOAD) {
+        stats_.overflow++;
+        rescan();
+        return true;
+    }
+    size_t total = frameSize(len);
+    if (n_ < total) return false;
+
+    uint16_t calc = crc16_ccitt(buf_ + 2, HEADER_LEN - 2 + len);
+    uint16_t recv = (uint16_t)(buf_[HEADER_LEN + len] | (buf_[HEADER_LEN + len + 1] << 8));
+    bool etxOk = !requireEtx_ || buf_[total - 1] == ETX;
+    if (calc != recv || !etxOk) {
+        stats_.crcFail++;
+        rescan();
+        return true;
+    }
+
+    stats_.good++;
+    if (handler_) {
+        Frame f;
+        f.ver = buf_[2];
+        f.type = buf_[3];
+        f.seq = (uint16_t)(buf_[4] | (buf_[5] << 8));
+        f.payload = buf_ + HEADER_LEN;
+        f.len = len;
+        handler_(f);
+    }
+    // 再走査で後続フレームの一部が残っている場合は先頭へ詰める
+    n_ -= total;
+    if (n_ > 0) memmove(buf_, buf_ + total, n_);
+    return true;
+}
+
+void FrameDecoder::feed(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        // SYNC待ち中は SYNC0 まで一気に読み飛ばす
+        if (n_ == 0) {
+            const uint8_t* s = (const uint8_t*)memchr(data, SYNC0, len);
+            if (!s) return;
+            len -= (size_t)(s - data);
+            data = s;
+        }
+        size_t take = needed();
+        if (take > len) take = len;
+        memcpy(buf_ + n_, data, take);
+        n_ += take;
+        data += take;
+        len -= take;
+        while (step()) {}
+    }
+}
+
 } // namespace CommProtocol
@@ -1,21 +1,100 @@
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include <functional>
 
 // 簡易プロトコル定義
 // [SYNC(2) AA 55][VER(1)=1][TYPE(1)=1][SEQ(2)][LEN(2)=57][PAYLOAD(57)][CRC16(2)][(optional ETX 1)]
 
+// CRC16 実装の選択（ビルドフラグ -DCOMM_CRC16_IMPL=n で上書き可）
+//   0: ビット単位（テーブル無し、1バイトあたり8回シフト）
+//   1: 256エントリテーブル（512B、フラッシュ配置）
+//   2: slice-by-4（4x256エントリテーブル、2KB、4バイト単位で処理）
+// いずれも結果はビット単位実装と完全一致する。
+#ifndef COMM_CRC16_IMPL
+#define COMM_CRC16_IMPL 1
+#endif
+
 namespace CommProtocol {
 
 static constexpr uint8_t SYNC0 = 0xAA;
 static constexpr uint8_t SYNC1 = 0x55;
 static constexpr uint8_t VERSION = 0x01;
 static constexpr uint8_t TYPE_CONTROL = 0x01;
+static constexpr uint8_t TYPE_COMMAND = 0x02;
+static constexpr uint8_t TYPE_CONTROL_V2 = 0x03;  // 固定小数点＋サーボ差分（要ネゴシエーション）
+static constexpr uint8_t TYPE_CONTROL_BATCH = 0x04; // [count:1] + V2レコード×count（UDPバッチ送信）
+static constexpr uint8_t TYPE_TELEMETRY = 0x05;   // [TS:4] + セクション[id:1][len:1][data]×n（要ネゴシエーション）
+static constexpr uint8_t ETX = 0x7E;
 static constexpr uint16_t PAYLOAD_LEN = 57; // IMU(25) + servo pos(16) + servo off(16)
+static constexpr size_t HEADER_LEN = 8;     // SYNC2 + VER + TYPE + SEQ2 + LEN2
+
+// コマンド（TYPE_COMMAND のペイロード先頭1バイト）
+static constexpr uint8_t CMD_SET_SERVO = 0x01;  // [id:1][val:2]
+static constexpr uint8_t CMD_SET_ALL = 0x02;    // [pos0:2]...[pos7:2]
+static constexpr uint8_t CMD_RESET = 0x03;
+static constexpr uint8_t CMD_PING = 0x04;
+static constexpr uint8_t CMD_SET_FORMAT = 0x05; // [type:1] TYPE_CONTROL / V2 / TELEMETRY。同じ内容で応答
+static constexpr uint8_t CMD_SET_OFFSETS = 0x06; // [off0:2]...[off7:2]（int16, μs）
+static constexpr uint8_t CMD_SET_BATCH = 0x07;   // [count:1][maxAgeMs:2]（UDPのみ）。適用後の値で応答
+static constexpr uint8_t CMD_PING_TS = 0x08;     // [hostTxUs:4][prevRttUs:4] → [hostTxUs:4][devRxUs:4][devTxUs:4]
+static constexpr uint8_t CMD_LATENCY = 0x09;     // [clear:1 省略可] → [count:4][min:4][max:4][mean:4][bin×16:4]
+static constexpr uint8_t CMD_HELLO = 0x0A;       // [port:2][streams:1]（UDPのみ）→ [slot][maxPeers][idleS:2][caps:1][packets:4][failures:4]
+static constexpr uint8_t CMD_BYE = 0x0B;         // 購読解除（UDPのみ）
+static constexpr uint8_t CMD_SUBSCRIBE = 0x0C;   // ([sec:1][hz:2])×n → TYPE_TELEMETRY に切り替え、全チャネルのレートで応答
+static constexpr uint8_t CMD_TRAJ_PUSH = 0x0D;   // [flags:1][n:1]([tMs:4][pos:2×8])×n → 軌道バッファの状態で応答
+static constexpr uint8_t CMD_TRAJ_CTRL = 0x0E;   // [op:1][arg:2 省略可] → 軌道バッファの状態で応答
+
+static constexpr uint8_t CMD_REC = 0x0F;         // [op:1][arg...] フライトレコーダーの操作（REC_OP_*）
+static constexpr uint8_t CMD_IMU_PROFILE = 0x10; // [profile:1]（0xFF で問い合わせ）→ [profile]（MPU6886::Profile）
+
+// REC の op
+static constexpr uint8_t REC_OP_STATUS = 0x00;   // → [0x0F][0x00][state][reason][count:4][capacity:4][triggerIndex:4][triggerUs:4]
+static constexpr uint8_t REC_OP_TRIGGER = 0x01;  // 凍結（状態で応答）
+static constexpr uint8_t REC_OP_REARM = 0x02;    // 破棄して記録再開（状態で応答）
+static constexpr uint8_t REC_OP_READ = 0x03;     // [index:4][n:1] → [0x0F][0x03][index:4][n][Record(40B)×n]（凍結中のみ）
+static constexpr uint8_t REC_OP_SAVE = 0x04;     // SDへ保存 → [0x0F][0x04][ok:1]
+static constexpr uint8_t REC_READ_MAX = 5;       // 1応答あたりのレコード数上限
+
+// TRAJ_PUSH の flags
+static constexpr uint8_t TRAJ_FLAG_START = 0x01;  // 新しいストリーム（残りを破棄してから追加）
+static constexpr uint8_t TRAJ_FLAG_END = 0x02;    // ストリーム終端（最後まで再生したら停止）
+static constexpr size_t TRAJ_KEYFRAME_LEN = 4 + 2 * 8;
+
+// TRAJ_CTRL の op
+static constexpr uint8_t TRAJ_OP_STATUS = 0x00;
+static constexpr uint8_t TRAJ_OP_STOP = 0x01;
+static constexpr uint8_t TRAJ_OP_SET_LEAD = 0x02;  // arg = lead[ms]
+
+// HELLO の streams（購読するテレメトリ）
+static constexpr uint8_t STREAM_CONTROL = 0x01;  // TYPE_CONTROL / V2 / BATCH
+static constexpr uint8_t STREAM_IMU = 0x02;      // 旧IMUパケット [AA55][roll][pitch][yaw][gx][gy][gz][temp]
+
+// HELLO 応答の caps（対応機能）
+static constexpr uint8_t CAP_CONTROL_V2 = 0x01;
+static constexpr uint8_t CAP_BATCH = 0x02;
+static constexpr uint8_t CAP_PING_TS = 0x04;
+static constexpr uint8_t CAP_TELEMETRY = 0x08;
+static constexpr uint8_t CAP_TRAJECTORY = 0x10;
+
+// 受信フレームのペイロード上限（これを超えるLENは即座に破棄して再同期）
+#ifndef COMM_MAX_RX_PAYLOAD
+#define COMM_MAX_RX_PAYLOAD 256
+#endif
+static constexpr uint16_t MAX_RX_PAYLOAD = COMM_MAX_RX_PAYLOAD;
+
+static constexpr uint16_t CRC16_INIT = 0xFFFF;
 
 // CRC16-CCITT (0x1021), init 0xFFFF
 uint16_t crc16_ccitt(const uint8_t* data, size_t len);
 
+// 途中経過の crc を引き継いで計算（分割されたデータ用）。
+// crc16_ccitt(d, n) == crc16_ccitt_update(CRC16_INIT, d, n)
+uint16_t crc16_ccitt_update(uint16_t crc, const uint8_t* data, size_t len);
+
+// ビット単位の参照実装（COMM_CRC16_IMPL に関係なく常に利用可能、検証用）
+uint16_t crc16_ccitt_bitwise(uint16_t crc, const uint8_t* data, size_t len);
+
 // 制御パケット生成（out に書き込み）。
 // addEtx=true の場合、末尾に 0x7E を追加（UART用フレーミング）。
 // 戻り値: 生成されたバイト数（ヘッダ+ペイロード+CRC(+ETX)）
@@ -29,4 +108,201 @@ size_t buildControlPacket(
     uint16_t seq,
     bool addEtx);
 
+// TYPE_CONTROL_V2 の固定小数点スケール（int16）
+static constexpr float V2_ACCEL_LSB_PER_G = 4096.0f;   // ±8g
+static constexpr float V2_GYRO_LSB_PER_DPS = 16.0f;   // ±2048dps
+static constexpr float V2_EULER_LSB_PER_DEG = 100.0f; // ±327deg
+
+// SEC_LOOP の内容（メインループの統計、1秒ごとに更新）
+struct LoopStats {
+    uint16_t loopHz;
+    uint16_t avgUs;
+    uint16_t maxUs;
+    uint32_t freeHeap;
+};
+
+// SEC_LINK の内容（送信経路ごと）
+struct LinkStats {
+    uint32_t txPackets;
+    uint32_t txDropped;
+    uint32_t rxGood;
+    uint32_t rxBad;
+    int8_t rssi;        // WiFi以外は0
+    uint16_t txPacketsPerSec;  // 直近1秒の送信レート（UDPのみ、シリアルは0）
+    uint32_t txBytesPerSec;
+    // 受信指令の SEQ・遅延（UDPのみ、シリアルは0）
+    uint32_t rxSeqGaps;        // 欠番数
+    uint32_t rxSeqReorders;    // 逆転・重複で捨てた数
+    uint32_t rxSeqResyncs;     // 追跡をやり直した数
+    uint32_t rxSuperseded;     // 同じ poll 内の新しい指令に上書きされた数
+    uint32_t rxAgeUs;          // 直近に適用した指令の経過時間の上限 [μs]
+    uint32_t rxMaxAgeUs;
+};
+
+// 送信1回分のサンプル
+struct ControlSample {
+    uint32_t timestampUs;      // デバイス時刻 micros()
+    float ax, ay, az;          // g
+    float gx, gy, gz;          // deg/s
+    float roll, pitch, yaw;    // deg
+    uint8_t tempByte;
+    const uint16_t* servoPos8; // 長さ8
+    const uint16_t* servoOff8; // 長さ8
+    const LoopStats* loop;     // SEC_LOOP 用（省略可）
+};
+
+/**
+ * @brief TYPE_CONTROL_V2 フレーム生成（送信先ごとに1つ持つ）
+ * ペイロード:
+ *   [TS(4) micros][ax,ay,az(int16*3)][gx,gy,gz(int16*3)][roll,pitch,yaw(int16*3)][temp(1)]
+ *   [MASK(1)] + MASK の立っているサーボごとに [pos(u16)][off(u16)]
+ * サーボは前回送信から変化した分のみ載せる。FULL_INTERVAL レコードごと、
+ * および forceFull() 後は全8ch を載せる（途中から受信したクライアント用）。
+ * CRC は TYPE_CONTROL と同じく SYNC～PAYLOAD を対象とする。
+ */
+class ControlV2Encoder {
+public:
+    static constexpr size_t FIXED_PAYLOAD_LEN = 4 + 6 + 6 + 6 + 1 + 1;  // 24
+    static constexpr size_t MAX_PAYLOAD_LEN = FIXED_PAYLOAD_LEN + 8 * 4;
+    static constexpr uint8_t FULL_INTERVAL = 50;
+
+    size_t build(uint8_t* out, size_t outMax, const ControlSample& s, uint16_t seq, bool addEtx);
+
+    // ペイロード部（1レコード）のみ書き込む。TYPE_CONTROL_BATCH で複数並べる用。
+    // 戻り値: 書き込んだバイト数、容量不足なら0（その場合は状態を変更しない）
+    size_t writeRecord(uint8_t* out, size_t outMax, const ControlSample& s);
+
+    void forceFull() { primed_ = false; }
+
+private:
+    uint16_t lastPos_[8] = {0};
+    uint16_t lastOff_[8] = {0};
+    bool primed_ = false;
+    uint8_t sinceFull_ = 0;
+};
+
+// TYPE_TELEMETRY のセクションID（未知のIDは len で読み飛ばせる）
+static constexpr uint8_t SEC_ATTITUDE = 0x01;  // roll,pitch,yaw int16（V2_EULER_LSB_PER_DEG）= 6B
+static constexpr uint8_t SEC_IMU = 0x02;       // ax,ay,az / gx,gy,gz int16（V2スケール）+ temp u8 = 13B
+static constexpr uint8_t SEC_SERVO = 0x03;     // pos u16×8 + off u16×8 = 32B
+static constexpr uint8_t SEC_LOOP = 0x04;      // loopHz u16 / avgUs u16 / maxUs u16 / freeHeap u32 = 10B
+static constexpr uint8_t SEC_LINK = 0x05;      // txPackets / txDropped / rxGood / rxBad u32 + rssi int8 + pkt/s u16 + B/s u32 + SEQ・遅延 u32×6 = 47B
+static constexpr uint8_t SEC_COUNT = 5;
+
+// セクションマスク（bit = 1 << (id-1)）
+static constexpr uint8_t secBit(uint8_t id) { return (uint8_t)(1u << (id - 1)); }
+static constexpr uint8_t SEC_MASK_ALL = secBit(SEC_ATTITUDE) | secBit(SEC_IMU) | secBit(SEC_SERVO);
+
+
+/**
+ * @brief TYPE_TELEMETRY フレームの組み立て
+ * ペイロード: [TS(4) micros] + [id(1)][len(1)][data(len)] の並び。
+ * 受信側は未知の id を len で読み飛ばせるため、セクションを追加しても旧クライアントは壊れない。
+ * CRC は他のテレメトリと同じく SYNC～PAYLOAD を対象とする。
+ */
+class TelemetryWriter {
+public:
+    TelemetryWriter(uint8_t* out, size_t outMax, bool addEtx)
+        : out_(out), outMax_(outMax), addEtx_(addEtx) {}
+
+    bool begin(uint16_t seq, uint32_t timestampUs);
+    // セクション領域を確保してデータ部の先頭を返す。容量不足なら nullptr（フレームは変更しない）
+    uint8_t* section(uint8_t id, uint8_t len);
+    // ヘッダの LEN と CRC(+ETX) を埋める。戻り値: フレーム長（失敗時0）
+    size_t finish();
+
+    size_t payloadLen() const { return len_ > HEADER_LEN ? len_ - HEADER_LEN : 0; }
+
+private:
+    uint8_t* out_;
+    size_t outMax_;
+    bool addEtx_;
+    size_t len_ = 0;
+};
+
+// 標準セクション（ATTITUDE / IMU / SERVO / LOOP のうち mask の分）を書き込む。容量不足なら false
+// LOOP は s.loop が nullptr なら省略する
+bool writeStandardSections(TelemetryWriter& w, const ControlSample& s, uint8_t mask);
+bool writeLinkSection(TelemetryWriter& w, const LinkStats& link);
+static constexpr uint8_t LINK_SECTION_LEN = 47;  // SEC_LINK のデータ長
+
+// sample から TYPE_TELEMETRY フレームを生成。戻り値: バイト数（失敗時0）
+// mask に SEC_LINK が含まれ link が指定されていれば LINK セクションも載せる
+size_t buildTelemetryFrame(uint8_t* out, size_t outMax, const ControlSample& s,
+    uint16_t seq, uint8_t mask, bool addEtx, const LinkStats* link = nullptr);
+
+// 全セクションを載せた TYPE_TELEMETRY フレームの最大長（ETX込み）
+static constexpr size_t TELEMETRY_MAX_LEN =
+    HEADER_LEN + 4 + (2 + 6) + (2 + 13) + (2 + 32) + (2 + 10) + (2 + LINK_SECTION_LEN) + 2 + 1;
+
+// 旧クライアント向けIMUパケット [AA55][roll][pitch][yaw][gx][gy][gz][temp]（float*6+uint8, 27B）
+static constexpr size_t LEGACY_IMU_LEN = 2 + 4 * 6 + 1;
+size_t buildLegacyImuPacket(uint8_t* out, size_t outMax, const ControlSample& s);
+
+// コマンド系フレーム生成（PONG等の応答用）。CRCは VER～PAYLOAD（SYNC除く）。
+// 戻り値: 生成されたバイト数、out が足りなければ0
+size_t buildCommandFrame(
+    uint8_t* out, size_t outMax,
+    uint8_t type, uint16_t seq,
+    const uint8_t* payload, uint16_t payloadLen,
+    bool addEtx);
+
+// 受信フレームのビュー（デコーダ内部バッファを直接指す。ハンドラ内でのみ有効）
+struct Frame {
+    uint8_t ver;
+    uint8_t type;
+    uint16_t seq;
+    const uint8_t* payload;
+    uint16_t len;
+};
+
+// データグラム（UDP等、1パケット=1フレーム）を検証してビューを返す。
+// CRC は VER～PAYLOAD、末尾の ETX(0x7E) は有っても無くてもよい。
+bool parseFrame(const uint8_t* data, size_t len, Frame& out);
+
+/**
+ * @brief ストリーム用フレームデコーダ
+ * [AA55][VER][TYPE][SEQ2][LEN2][PAYLOAD][CRC16][7E] を任意長のバイト列から切り出す。
+ * - LEN が MAX_RX_PAYLOAD を超えたら即座に破棄（overflow）
+ * - CRC/ETX 不一致時はフレーム全体を捨てず、SYNC の次のバイトから再走査（resync）
+ * - 完成したフレームはコピーせずハンドラへ渡す
+ * CRC は VER～PAYLOAD（SYNC除く）を対象とする（コマンド方向の仕様）。
+ */
+class FrameDecoder {
+public:
+    using Handler = std::function<void(const Frame&)>;
+
+    struct Stats {
+        uint32_t good;      // 正常フレーム数
+        uint32_t crcFail;   // CRC/ETX 不一致
+        uint32_t resync;    // 再同期（バイト破棄）回数
+        uint32_t overflow;  // LEN 上限超過
+    };
+
+    explicit FrameDecoder(bool requireEtx = true) : requireEtx_(requireEtx) {}
+
+    void setHandler(Handler handler) { handler_ = handler; }
+
+    // バイト列を投入。完成したフレームごとにハンドラを呼ぶ。
+    void feed(const uint8_t* data, size_t len);
+
+    void reset() { n_ = 0; }
+    const Stats& stats() const { return stats_; }
+    void clearStats() { stats_ = Stats(); }
+
+private:
+    static constexpr size_t BUF_SIZE = HEADER_LEN + MAX_RX_PAYLOAD + 2 + 1;
+
+    size_t frameSize(uint16_t len) const { return HEADER_LEN + len + 2 + (requireEtx_ ? 1 : 0); }
+    size_t needed() const;
+    bool step();
+    void rescan();
+
+    uint8_t buf_[BUF_SIZE];
+    size_t n_ = 0;
+    bool requireEtx_;
+    Stats stats_ = Stats();
+    Handler handler_;
+};
+
 } // namespace CommProtocol
@@ -0,0 +1,379 @@
+#include "CommandDispatcher.h"
+
+namespace CommandDispatcher {
+
+namespace {
+
+using CommProtocol::Frame;
+
+static inline uint16_t rd_u16le(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t rd_u32le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void wr_u32le(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// 応答ペイロードの最大（CMD_REC の READ）
+static constexpr uint16_t REC_READ_REPLY_LEN =
+    2 + 4 + 1 + CommProtocol::REC_READ_MAX * sizeof(FlightRecorder::Record);
+static constexpr uint16_t LATENCY_REPLY_LEN = 1 + 4 * 4 + LatencyHistogram::BINS * 4;
+static constexpr uint16_t MAX_REPLY_PAYLOAD =
+    REC_READ_REPLY_LEN > LATENCY_REPLY_LEN ? REC_READ_REPLY_LEN : LATENCY_REPLY_LEN;
+
+static void sendReply(CommandSink& s, uint16_t seq, const uint8_t* payload, uint16_t len) {
+    if (!s.reply) return;
+    uint8_t frame[CommProtocol::HEADER_LEN + MAX_REPLY_PAYLOAD + 3];
+    size_t n = CommProtocol::buildCommandFrame(frame, sizeof(frame),
+        CommProtocol::TYPE_COMMAND, seq, payload, len, s.addEtx);
+    if (n) s.reply(frame, n);
+}
+
+// SET_SERVO (id, val)
+static bool cmdSetServo(const Frame& f, CommandSink& s) {
+    uint8_t id = f.payload[1];
+    uint16_t val = rd_u16le(f.payload + 2);
+    if (id >= 8 || !s.servoPos8) return false;
+    s.servoPos8[id] = val;
+    if (s.verbose) Serial.printf("%s: servo[%d] = %u\n", s.tag, id, val);
+    return true;
+}
+
+// SET_ALL_SERVOS (8*2)
+static bool cmdSetAll(const Frame& f, CommandSink& s) {
+    if (!s.servoPos8) return false;
+    for (int i = 0; i < 8; i++) {
+        s.servoPos8[i] = rd_u16le(f.payload + 1 + i * 2);
+    }
+    if (s.verbose) Serial.printf("%s: all servos updated\n", s.tag);
+    return true;
+}
+
+// RESET
+static bool cmdReset(const Frame&, CommandSink& s) {
+    if (!s.servoPos8) return false;
+    for (int i = 0; i < 8; i++) {
+        s.servoPos8[i] = 90; // 中立角度（0～180度）
+        if (s.servoOff8) s.servoOff8[i] = 0;
+    }
+    if (s.verbose) Serial.printf("%s: reset\n", s.tag);
+    return true;
+}
+
+// PING: 受信SEQをそのまま返す [0x04]
+static bool cmdPing(const Frame& f, CommandSink& s) {
+    const uint8_t pong = CommProtocol::CMD_PING;
+    sendReply(s, f.seq, &pong, 1);
+    if (s.verbose) Serial.printf("%s: ping (binary pong sent)\n", s.tag);
+    return true;
+}
+
+// SET_FORMAT (type): 現在の形式を応答（未対応の値なら変更せずに現状を返す）
+static bool cmdSetFormat(const Frame& f, CommandSink& s) {
+    if (!s.setFormat) return false;
+    uint8_t req = f.payload[1];
+    if (req != CommProtocol::TYPE_CONTROL && req != CommProtocol::TYPE_CONTROL_V2 &&
+        req != CommProtocol::TYPE_TELEMETRY) req = 0;
+    uint8_t ack[2] = { CommProtocol::CMD_SET_FORMAT, s.setFormat(req) };
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose) Serial.printf("%s: telemetry type = 0x%02X\n", s.tag, ack[1]);
+    return true;
+}
+
+// SET_OFFSETS (8*2)
+static bool cmdSetOffsets(const Frame& f, CommandSink& s) {
+    if (!s.servoOff8) return false;
+    for (int i = 0; i < 8; i++) {
+        s.servoOff8[i] = rd_u16le(f.payload + 1 + i * 2);
+    }
+    if (s.verbose) Serial.printf("%s: servo offsets updated\n", s.tag);
+    return true;
+}
+
+// SET_BATCH (count, maxAgeMs): 適用後の値を応答
+static bool cmdSetBatch(const Frame& f, CommandSink& s) {
+    if (!s.setBatch) return false;
+    uint8_t count = f.payload[1];
+    uint16_t age = rd_u16le(f.payload + 2);
+    s.setBatch(count, age);
+    uint8_t ack[4] = { CommProtocol::CMD_SET_BATCH, count, (uint8_t)(age & 0xFF), (uint8_t)(age >> 8) };
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose) Serial.printf("%s: batch = %u samples / %u ms\n", s.tag, count, age);
+    return true;
+}
+
+// PING_TS: ホスト送信時刻をそのまま返し、デバイスの受信・送信時刻を付ける。
+// ホストは前回の往復遅延を載せてくるのでヒストグラムへ記録する（0 は未計測）
+static bool cmdPingTs(const Frame& f, CommandSink& s) {
+    uint32_t prevRtt = rd_u32le(f.payload + 5);
+    if (prevRtt && s.latency) s.latency->record(prevRtt);
+    uint8_t ack[13];
+    ack[0] = CommProtocol::CMD_PING_TS;
+    memcpy(ack + 1, f.payload + 1, 4);
+    wr_u32le(ack + 5, s.rxUs);
+    // 送信時刻はフレーム生成時点（UART はこの後 uartTx タスクが書き出す）
+    wr_u32le(ack + 9, micros());
+    sendReply(s, f.seq, ack, sizeof(ack));
+    return true;
+}
+
+// LATENCY: 往復遅延ヒストグラムを返す。[clear]=1 なら応答後にクリア
+static bool cmdLatency(const Frame& f, CommandSink& s) {
+    if (!s.latency) return false;
+    const LatencyHistogram& h = *s.latency;
+    uint8_t ack[MAX_REPLY_PAYLOAD];
+    ack[0] = CommProtocol::CMD_LATENCY;
+    wr_u32le(ack + 1, h.count());
+    wr_u32le(ack + 5, h.minUs());
+    wr_u32le(ack + 9, h.maxUs());
+    wr_u32le(ack + 13, h.meanUs());
+    for (uint8_t i = 0; i < LatencyHistogram::BINS; i++) {
+        wr_u32le(ack + 17 + i * 4, h.bin(i));
+    }
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose) Serial.printf("%s: latency n=%lu min=%lu max=%lu mean=%lu us\n", s.tag,
+        (unsigned long)h.count(), (unsigned long)h.minUs(), (unsigned long)h.maxUs(), (unsigned long)h.meanUs());
+    if (f.len >= 2 && f.payload[1]) s.latency->clear();
+    return true;
+}
+
+// HELLO (port, streams): 送信元を購読者として登録し、対応機能を応答。port=0 なら送信元ポート
+// 登録できた場合は、そのスロットへのこれまでの送信数・送信失敗数を末尾に付ける
+static bool cmdHello(const Frame& f, CommandSink& s) {
+    if (!s.subscribe) return false;
+    uint16_t port = rd_u16le(f.payload + 1);
+    uint8_t streams = f.payload[3];
+    int slot = s.subscribe(port, streams);
+    uint8_t ack[14] = {
+        CommProtocol::CMD_HELLO,
+        (uint8_t)(slot < 0 ? 0xFF : slot),
+        s.maxPeers,
+        (uint8_t)(s.peerIdleS & 0xFF), (uint8_t)(s.peerIdleS >> 8),
+        (uint8_t)(CommProtocol::CAP_CONTROL_V2 | CommProtocol::CAP_BATCH | CommProtocol::CAP_PING_TS |
+                  CommProtocol::CAP_TELEMETRY | (s.trajectory ? CommProtocol::CAP_TRAJECTORY : 0)),
+    };
+    size_t n = 6;
+    uint32_t packets = 0, failures = 0;
+    if (slot >= 0 && s.peerStats && s.peerStats((uint8_t)slot, packets, failures)) {
+        wr_u32le(ack + 6, packets);
+        wr_u32le(ack + 10, failures);
+        n = sizeof(ack);
+    }
+    sendReply(s, f.seq, ack, n);
+    if (s.verbose) Serial.printf("%s: hello port=%u streams=0x%02X slot=%d tx=%lu fail=%lu\n", s.tag, port, streams,
+        slot, (unsigned long)packets, (unsigned long)failures);
+    return true;
+}
+
+// BYE: 送信元の購読を解除
+static bool cmdBye(const Frame& f, CommandSink& s) {
+    if (!s.subscribe) return false;
+    s.subscribe(0, 0);
+    const uint8_t ack = CommProtocol::CMD_BYE;
+    sendReply(s, f.seq, &ack, 1);
+    return true;
+}
+
+// SUBSCRIBE ([sec][hz:2])×n: チャネル別レートを設定して TYPE_TELEMETRY に切り替え、全チャネルのレートを応答
+static bool cmdSubscribe(const Frame& f, CommandSink& s) {
+    if (!s.scheduler) return false;
+    for (uint16_t i = 1; i + 3 <= f.len; i += 3) {
+        s.scheduler->setRate(f.payload[i], rd_u16le(f.payload + i + 1));
+    }
+    // 切り替え後の実際の送信形式を末尾に付けて返す（UDP はバッチ送信も無効になる）
+    uint8_t type = s.setFormat ? s.setFormat(CommProtocol::TYPE_TELEMETRY) : 0;
+    uint8_t ack[1 + CommProtocol::SEC_COUNT * 3 + 1];
+    ack[0] = CommProtocol::CMD_SUBSCRIBE;
+    for (uint8_t sec = 1; sec <= CommProtocol::SEC_COUNT; ++sec) {
+        uint16_t hz = s.scheduler->rate(sec);
+        uint8_t* p = ack + 1 + (sec - 1) * 3;
+        p[0] = sec;
+        p[1] = (uint8_t)(hz & 0xFF);
+        p[2] = (uint8_t)(hz >> 8);
+    }
+    ack[sizeof(ack) - 1] = type;
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose) Serial.printf("%s: subscribe mask=0x%02X\n", s.tag, s.scheduler->activeMask());
+    return true;
+}
+
+// 軌道バッファの状態を応答: [cmd][state][depth][free][underruns:4][playMs:4][aheadMs:2][leadMs:2]
+static void replyTrajStatus(const Frame& f, CommandSink& s, uint8_t cmd) {
+    const TrajectoryBuffer& t = *s.trajectory;
+    uint32_t ahead = t.aheadMs();
+    uint8_t ack[16];
+    ack[0] = cmd;
+    ack[1] = (uint8_t)t.state();
+    ack[2] = t.depth();
+    ack[3] = t.freeSlots();
+    wr_u32le(ack + 4, t.stats().underruns);
+    wr_u32le(ack + 8, t.playMs());
+    ack[12] = (uint8_t)(ahead > 0xFFFF ? 0xFF : ahead & 0xFF);
+    ack[13] = (uint8_t)(ahead > 0xFFFF ? 0xFF : ahead >> 8);
+    ack[14] = (uint8_t)(t.lead() & 0xFF);
+    ack[15] = (uint8_t)(t.lead() >> 8);
+    sendReply(s, f.seq, ack, sizeof(ack));
+}
+
+// TRAJ_PUSH (flags, n, ([tMs:4][pos:2×8])×n): キーフレームを軌道バッファへ追加
+static bool cmdTrajPush(const Frame& f, CommandSink& s) {
+    if (!s.trajectory) return false;
+    uint8_t flags = f.payload[1];
+    uint8_t n = f.payload[2];
+    if (3 + (size_t)n * CommProtocol::TRAJ_KEYFRAME_LEN > f.len) return false;
+    if (flags & CommProtocol::TRAJ_FLAG_START) s.trajectory->start();
+    const uint8_t* p = f.payload + 3;
+    for (uint8_t i = 0; i < n; ++i, p += CommProtocol::TRAJ_KEYFRAME_LEN) {
+        TrajectoryBuffer::Keyframe k;
+        k.tMs = rd_u32le(p);
+        for (uint8_t ch = 0; ch < TrajectoryBuffer::SERVO_COUNT; ++ch) {
+            k.pos[ch] = rd_u16le(p + 4 + ch * 2);
+        }
+        s.trajectory->push(k);
+    }
+    if (flags & CommProtocol::TRAJ_FLAG_END) s.trajectory->end();
+    replyTrajStatus(f, s, CommProtocol::CMD_TRAJ_PUSH);
+    if (s.verbose && (flags & (CommProtocol::TRAJ_FLAG_START | CommProtocol::TRAJ_FLAG_END))) {
+        Serial.printf("%s: trajectory %s (depth=%u)\n", s.tag,
+            (flags & CommProtocol::TRAJ_FLAG_START) ? "start" : "end", s.trajectory->depth());
+    }
+    return true;
+}
+
+// TRAJ_CTRL (op, arg): 状態問い合わせ / 停止 / lead 変更
+static bool cmdTrajCtrl(const Frame& f, CommandSink& s) {
+    if (!s.trajectory) return false;
+    uint8_t op = f.payload[1];
+    if (op == CommProtocol::TRAJ_OP_STOP) {
+        s.trajectory->stop();
+        if (s.verbose) Serial.printf("%s: trajectory stop\n", s.tag);
+    } else if (op == CommProtocol::TRAJ_OP_SET_LEAD && f.len >= 4) {
+        s.trajectory->setLead(rd_u16le(f.payload + 2));
+        if (s.verbose) Serial.printf("%s: trajectory lead=%ums\n", s.tag, s.trajectory->lead());
+    }
+    replyTrajStatus(f, s, CommProtocol::CMD_TRAJ_CTRL);
+    return true;
+}
+
+// REC (op, ...): フライトレコーダーの状態・凍結・再開・読み出し・SD保存
+static bool cmdRec(const Frame& f, CommandSink& s) {
+    if (!s.recorder) return false;
+    FlightRecorder& r = *s.recorder;
+    uint8_t op = f.payload[1];
+    if (op == CommProtocol::REC_OP_READ) {
+        if (f.len < 7) return false;
+        uint32_t index = rd_u32le(f.payload + 2);
+        uint8_t n = f.payload[6];
+        if (n > CommProtocol::REC_READ_MAX) n = CommProtocol::REC_READ_MAX;
+        if (r.state() != FlightRecorder::State::FROZEN) n = 0;
+        uint8_t ack[REC_READ_REPLY_LEN];
+        ack[0] = CommProtocol::CMD_REC;
+        ack[1] = op;
+        wr_u32le(ack + 2, index);
+        uint8_t got = 0;
+        FlightRecorder::Record rec;
+        while (got < n && r.read(index + got, rec)) {
+            memcpy(ack + 7 + got * sizeof(rec), &rec, sizeof(rec));
+            got++;
+        }
+        ack[6] = got;
+        sendReply(s, f.seq, ack, (uint16_t)(7 + got * sizeof(rec)));
+        return true;
+    }
+    if (op == CommProtocol::REC_OP_SAVE) {
+        uint8_t ack[3] = { CommProtocol::CMD_REC, op, 0 };
+        ack[2] = (s.saveRecording && s.saveRecording()) ? 1 : 0;
+        sendReply(s, f.seq, ack, sizeof(ack));
+        return true;
+    }
+    if (op == CommProtocol::REC_OP_TRIGGER) {
+        r.trigger(FlightRecorder::REASON_COMMAND);
+    } else if (op == CommProtocol::REC_OP_REARM) {
+        r.rearm();
+    } else if (op != CommProtocol::REC_OP_STATUS) {
+        return false;
+    }
+    uint8_t ack[20];
+    ack[0] = CommProtocol::CMD_REC;
+    ack[1] = CommProtocol::REC_OP_STATUS;
+    ack[2] = (uint8_t)r.state();
+    ack[3] = r.reason();
+    FlightRecorder::FileHeader h;
+    r.fillHeader(h);
+    wr_u32le(ack + 4, h.count);
+    wr_u32le(ack + 8, h.capacity);
+    wr_u32le(ack + 12, h.triggerIndex);
+    wr_u32le(ack + 16, h.triggerUs);
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose && op != CommProtocol::REC_OP_STATUS) {
+        Serial.printf("%s: rec %s\n", s.tag, op == CommProtocol::REC_OP_TRIGGER ? "trigger" : "rearm");
+    }
+    return true;
+}
+
+// IMU_PROFILE (profile): 適用先に渡し、実際に使われるプロファイルを応答（0xFF は問い合わせ）
+static bool cmdImuProfile(const Frame& f, CommandSink& s) {
+    if (!s.setImuProfile) return false;
+    uint8_t profile = f.payload[1];
+    s.setImuProfile(profile);
+    uint8_t ack[2] = { CommProtocol::CMD_IMU_PROFILE, profile };
+    sendReply(s, f.seq, ack, sizeof(ack));
+    if (s.verbose) Serial.printf("%s: imu profile = %u\n", s.tag, profile);
+    return true;
+}
+
+struct Entry {
+    uint8_t cmd;
+    uint8_t minLen;   // コマンドIDを含むペイロード長の下限
+    bool state;       // サーボ状態を書き換えるか
+    bool (*fn)(const Frame&, CommandSink&);
+};
+
+static const Entry kTable[] = {
+    { CommProtocol::CMD_SET_SERVO,   4,  true,  cmdSetServo },
+    { CommProtocol::CMD_SET_ALL,     17, true,  cmdSetAll },
+    { CommProtocol::CMD_RESET,       1,  true,  cmdReset },
+    { CommProtocol::CMD_PING,        1,  false, cmdPing },
+    { CommProtocol::CMD_SET_FORMAT,  2,  false, cmdSetFormat },
+    { CommProtocol::CMD_SET_OFFSETS, 17, true,  cmdSetOffsets },
+    { CommProtocol::CMD_SET_BATCH,   4,  false, cmdSetBatch },
+    { CommProtocol::CMD_PING_TS,     9,  false, cmdPingTs },
+    { CommProtocol::CMD_LATENCY,     1,  false, cmdLatency },
+    { CommProtocol::CMD_HELLO,       4,  false, cmdHello },
+    { CommProtocol::CMD_BYE,         1,  false, cmdBye },
+    { CommProtocol::CMD_SUBSCRIBE,   1,  false, cmdSubscribe },
+    { CommProtocol::CMD_TRAJ_PUSH,   3,  false, cmdTrajPush },
+    { CommProtocol::CMD_TRAJ_CTRL,   2,  false, cmdTrajCtrl },
+    { CommProtocol::CMD_REC,         2,  false, cmdRec },
+    { CommProtocol::CMD_IMU_PROFILE, 2,  false, cmdImuProfile },
+};
+
+static const Entry* find(uint8_t cmd) {
+    for (const Entry& e : kTable) {
+        if (e.cmd == cmd) return &e;
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+bool dispatch(const CommProtocol::Frame& f, CommandSink& sink) {
+    if (f.type != CommProtocol::TYPE_COMMAND || f.len < 1) return false;
+    const Entry* e = find(f.payload[0]);
+    if (!e || f.len < e->minLen) return false;
+    return e->fn(f, sink);
+}
+
+bool isStateCommand(uint8_t cmd) {
+    const Entry* e = find(cmd);
+    return e && e->state;
+}
+
+}  // namespace CommandDispatcher
@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+#include "CommProtocol.h"
+#include "LatencyHistogram.h"
+#include "TelemetryScheduler.h"
+#include "TrajectoryBuffer.h"
+#include "../FlightRecorder.h"
+
+/**
+ * @brief TYPE_COMMAND フレームの共通ディスパッチ（シリアル/UDP共用）
+ *
+ * コマンドIDごとの処理を1つのテーブルで持ち、トランスポート固有の部分
+ * （応答の送り先、送信形式の切り替え、バッチ設定）は CommandSink で受け取る。
+ * トランスポート側はフレームを取り出したら dispatch() を呼ぶだけでよい。
+ */
+namespace CommandDispatcher {
+
+// コマンドの実行先（トランスポートごとに1つ保持し、適用先ポインタは受信処理のたびに設定）
+struct CommandSink {
+    uint16_t* servoPos8 = nullptr;
+    uint16_t* servoOff8 = nullptr;
+    bool addEtx = true;             // 応答フレームに ETX を付けるか（UART:true / UDP:false）
+    const char* tag = "Cmd";        // ログの接頭辞
+    bool verbose = true;            // コマンドごとにログを出すか
+    uint32_t rxUs = 0;              // 処理中フレームの受信時刻 micros()（トランスポートが設定）
+    LatencyHistogram* latency = nullptr;  // ホストが報告した往復遅延の記録先（未設定なら非対応）
+
+    // 応答フレームの送信
+    std::function<void(const uint8_t* frame, size_t n)> reply;
+    // 送信形式の切り替え。type=0 は問い合わせのみ。戻り値は適用後の形式。未設定なら非対応
+    std::function<uint8_t(uint8_t type)> setFormat;
+    // バッチ設定。値を適用し、実際に適用された値を書き戻す。未設定なら非対応
+    std::function<void(uint8_t& count, uint16_t& maxAgeMs)> setBatch;
+    // テレメトリ購読（HELLO/BYE）。streams=0 は解除。戻り値は登録スロット（満杯なら-1）。未設定なら非対応
+    std::function<int(uint16_t port, uint8_t streams)> subscribe;
+    uint8_t maxPeers = 0;           // HELLO 応答に載せる購読者数の上限
+    uint16_t peerIdleS = 0;         // HELLO 応答に載せる無通信での購読解除時間（秒）
+    // HELLO 応答に載せる購読者ごとの送信数・送信失敗数。slot が無効なら false。未設定なら載せない
+    std::function<bool(uint8_t slot, uint32_t& packets, uint32_t& failures)> peerStats;
+    TelemetryScheduler* scheduler = nullptr;  // SUBSCRIBE の適用先（未設定なら非対応）
+    TrajectoryBuffer* trajectory = nullptr;   // TRAJ_PUSH / TRAJ_CTRL の適用先（未設定なら非対応）
+    FlightRecorder* recorder = nullptr;       // REC の適用先（未設定なら非対応）
+    // REC save: 凍結中の記録をSDへ保存。未設定なら保存不可
+    std::function<bool()> saveRecording;
+    // IMU_PROFILE: プロファイルを設定し（範囲外は問い合わせのみ）、実際に使われる値を書き戻す。未設定なら非対応
+    std::function<void(uint8_t& profile)> setImuProfile;
+};
+
+// フレームを処理する。コマンドとして処理した場合 true
+bool dispatch(const CommProtocol::Frame& f, CommandSink& sink);
+
+// サーボ状態を書き換えるコマンドか（UDPで古いSEQを捨てる対象）
+bool isStateCommand(uint8_t cmd);
+
+}  // namespace CommandDispatcher
@@ -0,0 +1,66 @@
+#pragma once
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief ArduinoJson 用の固定長アリーナアロケータ（ヒープを使わない）
+ *
+ * 静的バッファから前詰めで割り当てるだけの単純な実装。
+ * deallocate は何もしないため、1コマンド処理ごとに
+ *   doc.clear(); arena.reset();
+ * の順で呼んでから deserializeJson() すること（clear 前の reset は不可）。
+ * 容量不足時は nullptr を返し、ArduinoJson 側で NoMemory エラーになる。
+ */
+template <size_t N>
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        size_t need = HDR + align(size);
+        if (used_ + need > N) return nullptr;
+        uint8_t* block = buf_ + used_;
+        memcpy(block, &size, sizeof(size_t));
+        used_ += need;
+        if (used_ > peak_) peak_ = used_;
+        return block + HDR;
+    }
+
+    void deallocate(void*) override {}
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        if (!ptr) return allocate(newSize);
+        uint8_t* block = (uint8_t*)ptr - HDR;
+        size_t oldSize;
+        memcpy(&oldSize, block, sizeof(size_t));
+        // 末尾ブロックならその場で伸縮
+        if (block + HDR + align(oldSize) == buf_ + used_) {
+            size_t end = (size_t)(block - buf_) + HDR + align(newSize);
+            if (end > N) return nullptr;
+            used_ = end;
+            if (used_ > peak_) peak_ = used_;
+            memcpy(block, &newSize, sizeof(size_t));
+            return ptr;
+        }
+        if (newSize <= oldSize) {
+            memcpy(block, &newSize, sizeof(size_t));
+            return ptr;
+        }
+        void* p = allocate(newSize);
+        if (p) memcpy(p, ptr, oldSize);
+        return p;
+    }
+
+    void reset() { used_ = 0; }
+    size_t used() const { return used_; }
+    size_t peak() const { return peak_; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static constexpr size_t ALIGN = 8;
+    static constexpr size_t HDR = ALIGN;  // 先頭にサイズを保持（アラインを崩さないよう8B確保）
+    static constexpr size_t align(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+    alignas(8) uint8_t buf_[N];
+    size_t used_ = 0;
+    size_t peak_ = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief 遅延のヒストグラム（μs、2のべき乗幅のビン）
+ *
+ * ビン0: 128μs 未満、ビンi: [64<<i, 128<<i) μs、最終ビン: それ以上すべて。
+ * 記録は O(1) でヒープを使わない。ループ側からのみ呼ぶこと（排他なし）。
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint8_t BINS = 16;
+
+    void record(uint32_t us) {
+        uint8_t bin = 0;
+        uint32_t v = us >> 7;
+        while (v && bin < BINS - 1) {
+            v >>= 1;
+            bin++;
+        }
+        bins_[bin]++;
+        if (count_ == 0 || us < min_) min_ = us;
+        if (us > max_) max_ = us;
+        sum_ += us;
+        count_++;
+    }
+
+    void clear() {
+        memset(bins_, 0, sizeof(bins_));
+        count_ = 0;
+        min_ = 0;
+        max_ = 0;
+        sum_ = 0;
+    }
+
+    // ビンiの上限（μs、最終ビンは0=上限なし）
+    static uint32_t binUpperUs(uint8_t i) { return i < BINS - 1 ? (128u << i) : 0; }
+
+    uint32_t count() const { return count_; }
+    uint32_t minUs() const { return min_; }
+    uint32_t maxUs() const { return max_; }
+    uint32_t meanUs() const { return count_ ? (uint32_t)(sum_ / count_) : 0; }
+    uint32_t bin(uint8_t i) const { return i < BINS ? bins_[i] : 0; }
+
+private:
+    uint32_t bins_[BINS] = {};
+    uint32_t count_ = 0;
+    uint32_t min_ = 0;
+    uint32_t max_ = 0;
+    uint64_t sum_ = 0;
+};
@@ -1,12 +1,21 @@
 #include "SerialSender.h"
 #include "../Settings.h"
 #include <ArduinoJson.h>
+#include <stdarg.h>
 
 bool SerialSender::begin() {
     // UART2 初期化（TX/RX ピンは config.h の指定、ボーレートは Settings から）
     uint32_t baud = Settings::getInstance().getSerialBaud();
     Serial2.begin(baud, SERIAL_8N1, SERIAL_RX_PIN, SERIAL_TX_PIN);
     delay(50);
+    // 送信ドレインタスク（ループ側はリングに積むだけで UART を待たない）
+    if (!_txTask) {
+        xTaskCreatePinnedToCore(txTaskEntry, "uartTx", 3072, this, TX_TASK_PRIORITY, &_txTask, TX_TASK_CORE);
+    }
+    // チャネル別レートの既定値（姿勢・IMU・サーボは制御周期、統計は購読されるまで停止）
+    _sched.setRate(CommProtocol::SEC_ATTITUDE, CONTROL_RATE_HZ);
+    _sched.setRate(CommProtocol::SEC_IMU, CONTROL_RATE_HZ);
+    _sched.setRate(CommProtocol::SEC_SERVO, CONTROL_RATE_HZ);
     _ready = true;
     Serial.printf("Serial: ready @%lu baud TX=%d RX=%d\n", (unsigned long)baud, SERIAL_TX_PIN, SERIAL_RX_PIN);
     Serial.printf("Serial2 object size: %zu bytes\n", sizeof(Serial2));
@@ -40,10 +49,54 @@ bool SerialSender::sendControl(
         _ax, _ay, _az, _gx, _gy, _gz, _t8,
         servoPos8, servoOff8, seq, true /* add ETX */);
     if (n == 0) return false;
-    Serial2.write(buf, n);
+    return queueTelemetry(buf, n);
+}
+
+bool SerialSender::sendControl(const CommProtocol::ControlSample& sample, uint16_t seq) {
+    if (!_ready) return false;
+    if (_txType == CommProtocol::TYPE_CONTROL) {
+        return sendControl(sample.ax, sample.ay, sample.az, sample.gx, sample.gy, sample.gz,
+            sample.tempByte, sample.servoPos8, sample.servoOff8, seq, true);
+    }
+    uint8_t buf[CommProtocol::TELEMETRY_MAX_LEN];
+    size_t n;
+    if (_txType == CommProtocol::TYPE_TELEMETRY) {
+        // telemetryDue() を通さずに呼ばれた場合は有効な全チャネルを載せる
+        uint8_t mask = _dueMask ? _dueMask : _sched.activeMask();
+        _dueMask = 0;
+        if (mask == 0) return false;
+        CommProtocol::LinkStats link = {};
+        if (mask & CommProtocol::secBit(CommProtocol::SEC_LINK)) link = linkStats();
+        n = CommProtocol::buildTelemetryFrame(buf, sizeof(buf), sample, seq, mask, true, &link);
+    } else {
+        n = _v2Encoder.build(buf, sizeof(buf), sample, seq, true /* add ETX */);
+    }
+    if (n == 0) return false;
+    return queueTelemetry(buf, n);
+}
+
+bool SerialSender::telemetryDue(uint32_t nowUs) {
+    if (!_ready) return false;
+    if (_txType == CommProtocol::TYPE_TELEMETRY) {
+        _dueMask = _sched.poll(nowUs);
+        return _dueMask != 0;
+    }
+    if ((int32_t)(nowUs - _nextBaseUs) < 0) return false;
+    _nextBaseUs += 1000000UL / CONTROL_RATE_HZ;
+    if ((int32_t)(nowUs - _nextBaseUs) >= 0) _nextBaseUs = nowUs + 1000000UL / CONTROL_RATE_HZ;
     return true;
 }
 
+CommProtocol::LinkStats SerialSender::linkStats() {
+    const auto& rx = _binDecoder.stats();
+    CommProtocol::LinkStats link = {};
+    link.txPackets = _txFrames;
+    link.txDropped = _txTelemetry.stats().framesDropped;
+    link.rxGood = rx.good;
+    link.rxBad = rx.crcFail + rx.overflow;
+    return link;
+}
+
 bool SerialSender::sendControlText(
     float ax, float ay, float az,
     float gx, float gy, float gz,
@@ -78,270 +131,282 @@ bool SerialSender::sendControlText(
         soff.add(servoOff8 ? servoOff8[i] : 0);
     }
     
-    serializeJson(doc, Serial2);
-    Serial2.println();  // 改行追加
-    return true;
+    char line[TX_MAX_FRAME];
+    size_t n = serializeJson(doc, line, sizeof(line) - 2);
+    line[n++] = '\r';  // 改行追加
+    line[n++] = '\n';
+    return queueTelemetry((const uint8_t*)line, n);
 }
 
-bool SerialSender::processTextCommand(uint16_t* servoPos8, uint16_t* servoOff8) {
-    if (!_ready) return false;
-    
-    bool commandProcessed = false;                                   
-    //uint16_t val = (_rxBinBuf[10] << 8) | _rxBinBuf[11];
-   /// シリアルから受信
-    while (Serial2.available()) {
-        char c = Serial2.read();
-        Serial.printf("[RX] 0x%02X ('%c')\n", (uint8_t)c, (c >= 32 && c < 127) ? c : '?');
+bool SerialSender::queueTelemetry(const uint8_t* data, size_t n) {
+    // テレメトリは満杯時に古いものから捨てる（常に最新を優先）
+    bool ok = _txTelemetry.push(data, n, true);
+    if (ok) _txFrames++;
+    if (_txTask) xTaskNotifyGive(_txTask);
+    return ok;
+}
 
-        // 改行で1コマンド終了
-        if (c == '\n' || c == '\r') {
-            if (_rxBuffer.length() > 0) {
-                // 受信バッファからスペース・タブを除去
-                String cleanBuffer = "";
-                for (size_t i = 0; i < _rxBuffer.length(); ++i) {
-                    char cc = _rxBuffer[i];
-                    if (cc != ' ' && cc != '\t') cleanBuffer += cc;
-                }
-                // バッファ内容が"p"だけならpong応答
-                if (cleanBuffer == "p") {
-                    Serial2.println("ping ok.");
-                    Serial.println("SerialCmd: single 'p' (with CR/LF) received, pong sent");
-                    commandProcessed = true;
-                    _rxBuffer = "";
-                    continue;
-                }
-                // バッファ内容が"?"だけならコマンド説明を返す
-                if (cleanBuffer == "?") {
-                    Serial2.println("[コマンド一覧]");
-                    Serial2.println("p         : ping応答 (通信確認)\r\n 例: p");
-                    Serial2.println("{\"cmd\":\"ping\"} : ping応答(JSON)\r\n 例: {\\\"cmd\\\":\\\"ping\\\"}");
-                    Serial2.println("{\"cmd\":\"servo\",\"pos\":[90,90,...]} : サーボ一括制御（角度0～180,中立90）\r\n 例: {\\\"cmd\\\":\\\"servo\\\",\\\"pos\\\":[90,90,90,90,90,90,90,90]}");
-                    Serial2.println("{\"cmd\":\"offset\",\"off\":[0,0,...]} : サーボオフセット一括設定\r\n 例: {\\\"cmd\\\":\\\"offset\\\",\\\"off\\\":[0,0,0,0,0,0,0,0]}");
-                    Serial2.println("{\"cmd\":\"set\",\"id\":0,\"val\":90} : 単一サーボ制御（角度0～180,中立90）\r\n 例: {\\\"cmd\\\":\\\"set\\\",\\\"id\\\":0,\\\"val\\\":90}");
-                    Serial2.println("{\"cmd\":\"reset\"} : サーボ全リセット\r\n 例: {\\\"cmd\\\":\\\"reset\\\"}");
-                    Serial2.println("?         : この説明を表示\r\n 例: ?");
-                    Serial.println("SerialCmd: '?' received, help sent");
-                    commandProcessed = true;
-                    _rxBuffer = "";
-                    continue;
-                }
-                Serial.printf("SerialCmd: received buffer: %s\n", cleanBuffer.c_str());
+void SerialSender::queueReply(const uint8_t* data, size_t n) {
+    // 受信側が最悪ケースの空きを確かめてから処理するので、通常は満杯にならない。
+    // 積めなかった応答は UART へ直接書かずに数えて捨てる（制御ループを UART で止めず、順序も崩さない）
+    if (!_txTask || !_txReply.push(data, n, false)) {
+        _replyOverflows++;
+        return;
+    }
+    xTaskNotifyGive(_txTask);
+}
 
-                // JSON解析
-                JsonDocument doc;
-                DeserializationError error = deserializeJson(doc, cleanBuffer);
+void SerialSender::replyLine(const char* text) {
+    char line[TX_MAX_FRAME];
+    size_t n = strlen(text);
+    if (n > sizeof(line) - 2) n = sizeof(line) - 2;
+    memcpy(line, text, n);
+    line[n++] = '\r';
+    line[n++] = '\n';
+    queueReply((const uint8_t*)line, n);
+}
 
-                if (!error) {
-                    Serial.printf("SerialCmd: JSON parsed successfully\n");
-                    String cmd = doc["cmd"].as<String>();
-                    Serial.printf("SerialCmd: cmd = %s\n", cmd.c_str());
-                    // サーボ位置コマンド: {"cmd":"servo","pos":[val0,val1,...]}（角度0～180,中立90）
-                    if (doc["cmd"] == "servo" && doc["pos"].is<JsonArray>()) {
-                        JsonArray posArray = doc["pos"].as<JsonArray>();
-                        int i = 0;
-                        for (JsonVariant v : posArray) {
-                            if (i >= 8) break;
-                            if (servoPos8) servoPos8[i] = v.as<uint16_t>(); // 0～180度で格納
-                            i++;
-                        }
-                        commandProcessed = true;
-                        Serial.printf("SerialCmd: servo pos updated (deg, count=%d)\n", i);
-                    }
-                    // set_allコマンド: {"cmd":"set_all","vals":[val0,val1,...]}（角度0～180,中立90）
-                    else if (doc["cmd"] == "set_all" && doc["vals"].is<JsonArray>()) {
-                        JsonArray valsArray = doc["vals"].as<JsonArray>();
-                        int i = 0;
-                        for (JsonVariant v : valsArray) {
-                            if (i >= 8) break;
-                            if (servoPos8) servoPos8[i] = v.as<uint16_t>(); // 0～180度で格納
-                            i++;
-                        }
-                        commandProcessed = true;
-                        Serial.printf("SerialCmd: set_all pos updated (deg, count=%d)\n", i);
-                    }
-                    // サーボオフセットコマンド: {"cmd":"offset","off":[val0,val1,...]}
-                    else if (doc["cmd"] == "offset" && doc["off"].is<JsonArray>()) {
-                        JsonArray offArray = doc["off"].as<JsonArray>();
-                        int i = 0;
-                        for (JsonVariant v : offArray) {
-                            if (i >= 8) break;
-                            if (servoOff8) servoOff8[i] = v.as<uint16_t>();
-                            i++;
-                        }
-                        commandProcessed = true;
-                        Serial.printf("SerialCmd: servo offset updated (count=%d)\n", i);
-                    }
-                    // 単一サーボ制御: {"cmd":"set","id":0,"val":90}（角度0～180,中立90）
-                    else if (doc["cmd"] == "set" && doc["id"].is<int>() && doc["val"].is<uint16_t>()) {
-                        int id = doc["id"].as<int>();
-                        uint16_t val = doc["val"].as<uint16_t>();
-                        if (id >= 0 && id < 8 && servoPos8) {
-                            servoPos8[id] = val; // 0～180度で格納
-                            commandProcessed = true;
-                            Serial.printf("SerialCmd: servo[%d] = %u deg\n", id, val);
-                        }
-                    }
-                    // 全サーボリセット: {"cmd":"reset"}（角度0～180,中立90）
-                    else if (doc["cmd"] == "reset") {
-                        for (int i = 0; i < 8; i++) {
-                            if (servoPos8) servoPos8[i] = 90; // 中立90度
-                            if (servoOff8) servoOff8[i] = 0;
-                        }
-                        commandProcessed = true;
-                        Serial.println("SerialCmd: all servos reset to 90 deg");
-                    }
-                    // 通信確認: {"cmd":"ping"}
-                    else if (doc["cmd"] == "ping") {
-                        JsonDocument resp;
-                        resp["resp"] = "ping";
-                        resp["millis"] = millis();
-                        serializeJson(resp, Serial2);
-                        Serial2.println();
-                        commandProcessed = true;
-                        Serial.println("SerialCmd: ping received, pong sent");
-                    }
-                } else {
-                    Serial.printf("SerialCmd: JSON parse error: %s\n", error.c_str());
-                }
+void SerialSender::replyf(const char* fmt, ...) {
+    char line[TX_MAX_FRAME];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n <= 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+    queueReply((const uint8_t*)line, (size_t)n);
+}
 
-                _rxBuffer = "";
-            }
-        } else {
-            // バッファに追加（サイズ制限）
-            if (_rxBuffer.length() < MAX_BUFFER_SIZE) {
-                _rxBuffer += c;
-            } else {
-                // バッファオーバーフロー対策（古いデータを破棄）
-                _rxBuffer = "";
-                Serial.println("SerialCmd: buffer overflow, reset");
-            }
+void SerialSender::txTaskEntry(void* arg) {
+    static_cast<SerialSender*>(arg)->txLoop();
+}
+
+void SerialSender::txLoop() {
+    uint8_t frame[TX_MAX_FRAME];
+    for (;;) {
+        // 応答を優先して、リングが空になるまで UART へ書き出す
+        size_t n;
+        while ((n = _txReply.pop(frame, sizeof(frame))) > 0 ||
+               (n = _txTelemetry.pop(frame, sizeof(frame))) > 0) {
+            Serial2.write(frame, n);  // ここでのブロックはこのタスク内のみ
         }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
-    
-    return commandProcessed;
 }
 
-bool SerialSender::processBinaryCommand(uint16_t* servoPos8, uint16_t* servoOff8) {
+SerialSender::TxStats SerialSender::txStats() {
+    auto t = _txTelemetry.stats();
+    auto r = _txReply.stats();
+    TxStats s;
+    s.bytesQueued = t.bytesQueued + r.bytesQueued;
+    s.bytesDropped = t.bytesDropped;
+    s.framesDropped = t.framesDropped;
+    s.peakDepth = t.peakDepth;
+    s.replyPeakDepth = r.peakDepth;
+    s.replyOverflows = _replyOverflows;
+    s.rxDeferred = _rxDeferred;
+    return s;
+}
+
+bool SerialSender::processTextCommand(uint16_t* servoPos8, uint16_t* servoOff8) {
     if (!_ready) return false;
-    
+
     bool commandProcessed = false;
-    
-    // バイナリフレームを受信
-    while (Serial2.available()) {
-        uint8_t c = Serial2.read();
-        
-        // SYNC 待ち
-        if (_rxBinIdx == 0) {
-            if (c == CommProtocol::SYNC0) {
-                _rxBinBuf[_rxBinIdx++] = c;
+    // 受信済みバイトをまとめて読み出し、固定長の行バッファへ蓄積
+    for (;;) {
+        if (_rxChunkPos >= _rxChunkLen) {
+            int avail = Serial2.available();
+            if (avail <= 0) break;
+            _rxChunkLen = Serial2.read(_rxChunk, (size_t)avail < sizeof(_rxChunk) ? (size_t)avail : sizeof(_rxChunk));
+            _rxChunkPos = 0;
+            if (_rxChunkLen == 0) break;
+        }
+        char c = (char)_rxChunk[_rxChunkPos];
+        // 改行で1コマンド終了
+        if (c == '\n' || c == '\r') {
+            if (_rxLineOverflow) {
+                // 長すぎた行の残りはここで捨てる
+                _rxLineOverflow = false;
+                _rxLineLen = 0;
+                _rxChunkPos++;
+                continue;
             }
-        } else if (_rxBinIdx == 1) {
-            if (c == CommProtocol::SYNC1) {
-                _rxBinBuf[_rxBinIdx++] = c;
-            } else {
-                _rxBinIdx = 0;  // SYNC失敗、リセット
+            if (_rxLineLen == 0) {
+                _rxChunkPos++;
+                continue;
             }
+            // 応答が入りきらないときはこの行を残して次の loop() で処理する
+            if (_txReply.space() < TEXT_REPLY_RESERVE) {
+                _rxDeferred++;
+                break;
+            }
+            _rxChunkPos++;
+            uint32_t t0 = micros();
+            _rxLine[_rxLineLen] = '\0';
+            if (handleTextLine(_rxLine, _rxLineLen, servoPos8, servoOff8)) {
+                commandProcessed = true;
+                _textStats.commands++;
+            }
+            _textStats.lines++;
+            uint32_t dt = micros() - t0;
+            if (dt > _textStats.maxLineUs) _textStats.maxLineUs = dt;
+            _rxLineLen = 0;
+            continue;
+        }
+        _rxChunkPos++;
+        if (_rxLineOverflow) {
+            // 改行まで読み捨て
+        } else if (_rxLineLen < MAX_LINE_LEN) {
+            _rxLine[_rxLineLen++] = c;
         } else {
-            // ヘッダ＆ペイロードを受信
-            _rxBinBuf[_rxBinIdx++] = c;
-            
-            // 最小フレーム: SYNC(2) + VER(1) + TYPE(1) + SEQ(2) + LEN(2) + CRC(2) + ETX(1) = 11B
-            // 最大フレーム: SYNC(2) + VER(1) + TYPE(1) + SEQ(2) + LEN(2) + PAYLOAD(57) + CRC(2) + ETX(1) = 68B
-            if (_rxBinIdx >= 11) {
-                uint8_t ver = _rxBinBuf[2];
-                uint8_t type = _rxBinBuf[3];
-                // Little-endianで解釈
-                uint16_t seq = (_rxBinBuf[5] << 8) | _rxBinBuf[4];
-                uint16_t len = (_rxBinBuf[7] << 8) | _rxBinBuf[6];
+            // バッファオーバーフロー対策（この行は改行まで破棄）
+            _rxLineOverflow = true;
+            _textStats.overflows++;
+            Serial.println("SerialCmd: buffer overflow, line discarded");
+        }
+    }
 
-                // フルフレーム受信確認: SYNC(2) + VER(1) + TYPE(1) + SEQ(2) + LEN(2) + PAYLOAD(len) + CRC(2) + ETX(1)
-                size_t expected_size = 2 + 1 + 1 + 2 + 2 + len + 2 + 1;
+    return commandProcessed;
+}
 
-                if (_rxBinIdx >= expected_size) {
-                    // 受信バイナリパケットを16進数で出力（この行を追加）【約182行目】
-                    Serial.print("Recv packet: ");
-                    for (size_t i = 0; i < expected_size; ++i) {
-                        Serial.printf("%02X ", _rxBinBuf[i]);
-                    }
-                    Serial.println();
+// 1行分のコマンドを処理（line は書き換えられる）。ヒープ確保は行わない。
+bool SerialSender::handleTextLine(char* line, size_t len, uint16_t* servoPos8, uint16_t* servoOff8) {
+    // スペース・タブをその場で除去
+    size_t w = 0;
+    for (size_t r = 0; r < len; ++r) {
+        char cc = line[r];
+        if (cc != ' ' && cc != '\t') line[w++] = cc;
+    }
+    line[w] = '\0';
+    if (w == 0) return false;
 
-                    // CRC検証（SYNC前後を除く）
-                    uint16_t calc_crc = CommProtocol::crc16_ccitt(_rxBinBuf + 2, 2 + 2 + 2 + len);
-                    // CRC16はリトルエンディアンで格納されているため、下位バイト＋上位バイトで取得
-                    uint16_t frame_crc = _rxBinBuf[8 + len] | (_rxBinBuf[8 + len + 1] << 8);
-                    //uint16_t frame_crc = _rxBinBuf[2 + 2 + 2 + len] | (_rxBinBuf[2 + 2 + 2 + len + 1] << 8);
-                    uint8_t etx = _rxBinBuf[_rxBinIdx - 1];
+    // "p"だけならpong応答
+    if (w == 1 && line[0] == 'p') {
+        replyLine("ping ok.");
+        Serial.println("SerialCmd: single 'p' (with CR/LF) received, pong sent");
+        return true;
+    }
+    // "?"だけならコマンド説明を返す
+    if (w == 1 && line[0] == '?') {
+        replyLine("[コマンド一覧]");
+        replyLine("p         : ping応答 (通信確認)\r\n 例: p");
+        replyLine("{\"cmd\":\"ping\"} : ping応答(JSON)\r\n 例: {\\\"cmd\\\":\\\"ping\\\"}");
+        replyLine("{\"cmd\":\"servo\",\"pos\":[90,90,...]} : サーボ一括制御（角度0～180,中立90）\r\n 例: {\\\"cmd\\\":\\\"servo\\\",\\\"pos\\\":[90,90,90,90,90,90,90,90]}");
+        replyLine("{\"cmd\":\"offset\",\"off\":[0,0,...]} : サーボオフセット一括設定\r\n 例: {\\\"cmd\\\":\\\"offset\\\",\\\"off\\\":[0,0,0,0,0,0,0,0]}");
+        replyLine("{\"cmd\":\"set\",\"id\":0,\"val\":90} : 単一サーボ制御（角度0～180,中立90）\r\n 例: {\\\"cmd\\\":\\\"set\\\",\\\"id\\\":0,\\\"val\\\":90}");
+        replyLine("{\"cmd\":\"reset\"} : サーボ全リセット\r\n 例: {\\\"cmd\\\":\\\"reset\\\"}");
+        replyLine("{\"cmd\":\"stats\"} : 受信統計（行数・コマンド数・エラー・最大処理時間）\r\n 例: {\\\"cmd\\\":\\\"stats\\\"}");
+        replyLine("?         : この説明を表示\r\n 例: ?");
+        Serial.println("SerialCmd: '?' received, help sent");
+        return true;
+    }
 
-                    if (calc_crc == frame_crc && etx == 0x7E) {
-                        // フレーム有効
-                        if (type == 0x02) {  // TYPE_COMMAND
-                            uint8_t cmd = _rxBinBuf[8];
-                            if (cmd == 0x01) {  // SET_SERVO (id, val)
-                                if (len >= 4) {
-                                    uint8_t id = _rxBinBuf[9];
-                                    uint16_t val = _rxBinBuf[10] | (_rxBinBuf[11] << 8); // リトルエンディアンで取得
-                                    //uint16_t val = (_rxBinBuf[10] << 8) | _rxBinBuf[11];
-                                    if (id < 8 && servoPos8) {
-                                        servoPos8[id] = val;
-                                        commandProcessed = true;
-                                        Serial.printf("BinCmd: servo[%d] = %u\n", id, val);
-                                    }
-                                }
-                            } else if (cmd == 0x02) {  // SET_ALL_SERVOS (8*2)
-                                if (len >= 17 && servoPos8) {
-                                    for (int i = 0; i < 8; i++) {
-                                        servoPos8[i] = _rxBinBuf[9 + i*2] | (_rxBinBuf[10 + i*2] << 8);
-                                        //servoPos8[i] = (_rxBinBuf[9 + i*2] << 8) | _rxBinBuf[10 + i*2];
-                                    }
-                                    commandProcessed = true;
-                                    Serial.println("BinCmd: all servos updated");
-                                }
-                            } else if (cmd == 0x03) {  // RESET
-                                if (servoPos8) {
-                                    for (int i = 0; i < 8; i++) {
-                                        servoPos8[i] = 90; // 中立角度（0～180度）
-                                        if (servoOff8) servoOff8[i] = 0;
-                                    }
-                                    commandProcessed = true;
-                                    Serial.println("BinCmd: reset");
-                                }
-                            } else if (cmd == 0x04) {  // PING
-                                // バイナリPONG応答: SYNC, VER, TYPE=0x02, SEQ, LEN=1, CMD=0x04, CRC, ETX
-                                uint8_t pong_frame[16];
-                                uint16_t pong_seq = seq; // 受信SEQをそのまま返す
-                                uint8_t pong_cmd = 0x04;
-                                // ヘッダ: SYNC(2), VER(1), TYPE(1), SEQ(2), LEN(2)
-                                pong_frame[0] = CommProtocol::SYNC0;
-                                pong_frame[1] = CommProtocol::SYNC1;
-                                pong_frame[2] = CommProtocol::VERSION;
-                                pong_frame[3] = 0x02; // TYPE_COMMAND
-                                pong_frame[4] = (uint8_t)(pong_seq & 0xFF);
-                                pong_frame[5] = (uint8_t)((pong_seq >> 8) & 0xFF);
-                                pong_frame[6] = 1; // LEN=1 (CMDのみ)
-                                pong_frame[7] = 0;
-                                pong_frame[8] = pong_cmd;
-                                // CRC計算（VER～CMDまで）
-                                uint16_t pong_crc = CommProtocol::crc16_ccitt(&pong_frame[2], 7);
-                                pong_frame[9] = (uint8_t)(pong_crc & 0xFF);
-                                pong_frame[10] = (uint8_t)((pong_crc >> 8) & 0xFF);
-                                pong_frame[11] = 0x7E; // ETX
-                                Serial2.write(pong_frame, 12);
-                                commandProcessed = true;
-                                Serial.println("BinCmd: ping (binary pong sent)");
+    // JSON解析（ドキュメントとアリーナを再利用）
+    _cmdDoc.clear();
+    _jsonArena.reset();
+    DeserializationError error = deserializeJson(_cmdDoc, (const char*)line, w);
+    if (error) {
+        _textStats.parseErrors++;
+        Serial.printf("SerialCmd: JSON parse error: %s\n", error.c_str());
+        return false;
+    }
 
-                                //pong_frame[0] = CommProtocol::SYNC0;
-                                // LcdManager::getInstance().drawText(0, 200, "pong_frame SYNC0 set"); // LCDに表示                         
-                            }
-                        }
-                    } else {
-                        Serial.printf("BinCmd: CRC/ETX fail (crc=%04X vs %04X, etx=%02X)\n", calc_crc, frame_crc, etx);
-                    }
+    const char* cmd = _cmdDoc["cmd"] | "";
+    // サーボ位置コマンド: {"cmd":"servo","pos":[val0,val1,...]}（角度0～180,中立90）
+    // set_allコマンド: {"cmd":"set_all","vals":[val0,val1,...]}（角度0～180,中立90）
+    bool isServo = strcmp(cmd, "servo") == 0 && _cmdDoc["pos"].is<JsonArray>();
+    bool isSetAll = strcmp(cmd, "set_all") == 0 && _cmdDoc["vals"].is<JsonArray>();
+    if (isServo || isSetAll) {
+        JsonArray posArray = _cmdDoc[isServo ? "pos" : "vals"].as<JsonArray>();
+        int i = 0;
+        for (JsonVariant v : posArray) {
+            if (i >= 8) break;
+            if (servoPos8) servoPos8[i] = v.as<uint16_t>(); // 0～180度で格納
+            i++;
+        }
+        Serial.printf("SerialCmd: %s pos updated (deg, count=%d)\n", cmd, i);
+        return true;
+    }
+    // サーボオフセットコマンド: {"cmd":"offset","off":[val0,val1,...]}
+    if (strcmp(cmd, "offset") == 0 && _cmdDoc["off"].is<JsonArray>()) {
+        JsonArray offArray = _cmdDoc["off"].as<JsonArray>();
+        int i = 0;
+        for (JsonVariant v : offArray) {
+            if (i >= 8) break;
+            if (servoOff8) servoOff8[i] = v.as<uint16_t>();
+            i++;
+        }
+        Serial.printf("SerialCmd: servo offset updated (count=%d)\n", i);
+        return true;
+    }
+    // 単一サーボ制御: {"cmd":"set","id":0,"val":90}（角度0～180,中立90）
+    if (strcmp(cmd, "set") == 0 && _cmdDoc["id"].is<int>() && _cmdDoc["val"].is<uint16_t>()) {
+        int id = _cmdDoc["id"].as<int>();
+        uint16_t val = _cmdDoc["val"].as<uint16_t>();
+        if (id >= 0 && id < 8 && servoPos8) {
+            servoPos8[id] = val; // 0～180度で格納
+            Serial.printf("SerialCmd: servo[%d] = %u deg\n", id, val);
+            return true;
+        }
+        return false;
+    }
+    // 全サーボリセット: {"cmd":"reset"}（角度0～180,中立90）
+    if (strcmp(cmd, "reset") == 0) {
+        for (int i = 0; i < 8; i++) {
+            if (servoPos8) servoPos8[i] = 90; // 中立90度
+            if (servoOff8) servoOff8[i] = 0;
+        }
+        Serial.println("SerialCmd: all servos reset to 90 deg");
+        return true;
+    }
+    // 通信確認: {"cmd":"ping"}
+    if (strcmp(cmd, "ping") == 0) {
+        replyf("{\"resp\":\"ping\",\"millis\":%lu}\r\n", (unsigned long)millis());
+        Serial.println("SerialCmd: ping received, pong sent");
+        return true;
+    }
+    // 受信統計: {"cmd":"stats"}（この行自身は lines / commands に含まれない）
+    if (strcmp(cmd, "stats") == 0) {
+        replyf("{\"resp\":\"stats\",\"lines\":%lu,\"commands\":%lu,\"parseErrors\":%lu,"
+               "\"overflows\":%lu,\"maxLineUs\":%lu,\"jsonPeak\":%u}\r\n",
+               (unsigned long)_textStats.lines, (unsigned long)_textStats.commands,
+               (unsigned long)_textStats.parseErrors, (unsigned long)_textStats.overflows,
+               (unsigned long)_textStats.maxLineUs, (unsigned)_jsonArena.peak());
+        // 送信リングの統計は別の行で返す（TX_MAX_FRAME に収めるため）
+        TxStats tx = txStats();
+        replyf("{\"resp\":\"txstats\",\"queued\":%lu,\"dropped\":%lu,\"framesDropped\":%lu,\"peak\":%lu,"
+               "\"replyPeak\":%lu,\"replyOverflows\":%lu,\"rxDeferred\":%lu}\r\n",
+               (unsigned long)tx.bytesQueued, (unsigned long)tx.bytesDropped, (unsigned long)tx.framesDropped,
+               (unsigned long)tx.peakDepth, (unsigned long)tx.replyPeakDepth, (unsigned long)tx.replyOverflows,
+               (unsigned long)tx.rxDeferred);
+        return true;
+    }
+    return false;
+}
 
-                    _rxBinIdx = 0;  // 次のフレーム待ち
-                }
-            }
+bool SerialSender::processBinaryCommand(uint16_t* servoPos8, uint16_t* servoOff8) {
+    if (!_ready) return false;
+
+    _cmdSink.servoPos8 = servoPos8;
+    _cmdSink.servoOff8 = servoOff8;
+    _cmdProcessed = false;
+
+    // 受信済みバイトをまとめて読み出してデコーダへ投入
+    // 1回分の応答がすべて入る空きがなければ、残りは UART の受信バッファに置いて次の loop() で読む
+    uint8_t chunk[RX_CHUNK];
+    int avail;
+    while ((avail = Serial2.available()) > 0) {
+        if (_txReply.space() < BIN_REPLY_RESERVE) {
+            _rxDeferred++;
+            break;
         }
+        size_t n = Serial2.read(chunk, (size_t)avail < sizeof(chunk) ? (size_t)avail : sizeof(chunk));
+        if (n == 0) break;
+        _cmdSink.rxUs = micros();
+        _binDecoder.feed(chunk, n);
     }
-    
-    return commandProcessed;
+
+    _cmdSink.servoPos8 = nullptr;
+    _cmdSink.servoOff8 = nullptr;
+    return _cmdProcessed;
 }
@@ -1,11 +1,42 @@
 #pragma once
 #include <Arduino.h>
 #include "CommProtocol.h"
+#include "CommandDispatcher.h"
+#include "JsonArena.h"
+#include "TelemetryScheduler.h"
+#include "TxRing.h"
 #include "config.h"
 
+// テレメトリ送信リングのサイズ（バイト、-DSERIAL_TX_RING_SIZE=n で変更可）
+#ifndef SERIAL_TX_RING_SIZE
+#define SERIAL_TX_RING_SIZE 4096
+#endif
+
 class SerialSender {
 public:
-    SerialSender() : _ready(false) {}
+    // テキスト受信の統計
+    struct TextStats {
+        uint32_t lines;        // 受信行数
+        uint32_t commands;     // 処理したコマンド数
+        uint32_t parseErrors;  // JSONパースエラー
+        uint32_t overflows;    // 行長超過で破棄した行
+        uint32_t maxLineUs;    // 1行の処理時間の最大値（μs）
+    };
+
+    SerialSender() : _ready(false), _cmdDoc(&_jsonArena), _binDecoder(true) {
+        _binDecoder.setHandler([this](const CommProtocol::Frame& f) {
+            if (CommandDispatcher::dispatch(f, _cmdSink)) _cmdProcessed = true;
+        });
+        _cmdSink.tag = "BinCmd";
+        _cmdSink.addEtx = true;
+        _cmdSink.reply = [this](const uint8_t* frame, size_t n) { queueReply(frame, n); };
+        _cmdSink.latency = &_latency;
+        _cmdSink.scheduler = &_sched;
+        _cmdSink.setFormat = [this](uint8_t type) {
+            if (type) setTelemetryType(type);
+            return _txType;
+        };
+    }
     bool begin();
     bool isReady() const { return _ready; }
 
@@ -19,6 +50,27 @@ public:
         uint16_t seq,
         bool includeImu = true);  // IMUデータを含むか
 
+    // ネゴシエーション済みの形式（TYPE_CONTROL / V2 / TELEMETRY）で送信
+    bool sendControl(const CommProtocol::ControlSample& sample, uint16_t seq);
+
+    // 送信形式の切り替え（既定は旧クライアント互換の TYPE_CONTROL）
+    void setTelemetryType(uint8_t type) { _txType = type; _v2Encoder.forceFull(); }
+    uint8_t telemetryType() const { return _txType; }
+
+    // 送信タイミングの判定。TYPE_TELEMETRY はチャネル別レート（SUBSCRIBE）、それ以外は CONTROL_RATE_HZ
+    // true を返した直後の sendControl() は期限の来たセクションだけを載せる
+    bool telemetryDue(uint32_t nowUs);
+    TelemetryScheduler& scheduler() { return _sched; }
+    CommProtocol::LinkStats linkStats();
+
+    // TRAJ_PUSH / TRAJ_CTRL の適用先（未設定なら非対応）
+    void setTrajectory(TrajectoryBuffer* traj) { _cmdSink.trajectory = traj; }
+    // REC の適用先（SD保存は setRecordingSaver で指定）
+    void setRecorder(FlightRecorder* rec) { _cmdSink.recorder = rec; }
+    void setRecordingSaver(std::function<bool()> fn) { _cmdSink.saveRecording = fn; }
+    // IMU_PROFILE の適用先（Settings への保存とセンサーへの反映は main 側）
+    void setImuProfileHandler(std::function<void(uint8_t&)> fn) { _cmdSink.setImuProfile = fn; }
+
     // テキスト（JSON）送信
     bool sendControlText(
         float ax, float ay, float az,
@@ -37,10 +89,78 @@ public:
     // 戻り値: コマンドを受信して処理した場合true
     bool processBinaryCommand(uint16_t* servoPos8, uint16_t* servoOff8);
 
+    // バイナリ受信の統計（正常/CRC不一致/再同期/LEN超過）
+    const CommProtocol::FrameDecoder::Stats& binaryStats() const { return _binDecoder.stats(); }
+    const TextStats& textStats() const { return _textStats; }
+
+    // 送信リングの統計
+    struct TxStats {
+        uint32_t bytesQueued;        // 投入バイト数（テレメトリ+応答）
+        uint32_t bytesDropped;       // 破棄したテレメトリのバイト数
+        uint32_t framesDropped;      // 破棄したテレメトリのフレーム数
+        uint32_t peakDepth;          // テレメトリリングの最大滞留バイト数
+        uint32_t replyPeakDepth;     // 応答リングの最大滞留バイト数
+        uint32_t replyOverflows;     // 応答リングに積めず捨てた応答数（通常は0）
+        uint32_t rxDeferred;         // 応答リングの空き待ちで受信処理を次の loop() へ回した回数
+    };
+    TxStats txStats();
+    size_t jsonArenaPeak() const { return _jsonArena.peak(); }
+    // ホストが PING_TS で報告した往復遅延
+    const LatencyHistogram& latency() const { return _latency; }
+
 private:
     bool _ready;
-    String _rxBuffer;  // テキスト受信バッファ
-    uint8_t _rxBinBuf[80];  // バイナリ受信バッファ
-    size_t _rxBinIdx = 0;
-    static constexpr size_t MAX_BUFFER_SIZE = 1024;
+    uint8_t _txType = CommProtocol::TYPE_CONTROL;
+    CommProtocol::ControlV2Encoder _v2Encoder;
+    TelemetryScheduler _sched;
+    uint8_t _dueMask = 0;
+    uint32_t _nextBaseUs = 0;
+    uint32_t _txFrames = 0;  // リングに積めたテレメトリのフレーム数
+    // テキスト受信（固定長の行バッファ + 再利用するJSONドキュメント）
+    static constexpr size_t MAX_LINE_LEN = 256;
+    static constexpr size_t JSON_ARENA_SIZE = 4096;
+    char _rxLine[MAX_LINE_LEN + 1];
+    size_t _rxLineLen = 0;
+    bool _rxLineOverflow = false;  // 超過行は改行まで読み捨て
+    JsonArena<JSON_ARENA_SIZE> _jsonArena;
+    JsonDocument _cmdDoc;
+    TextStats _textStats = TextStats();
+    CommProtocol::FrameDecoder _binDecoder;  // バイナリ受信デコーダ
+    // コマンドの実行先（適用先ポインタは processBinaryCommand() 実行中のみ有効）
+    CommandDispatcher::CommandSink _cmdSink;
+    bool _cmdProcessed = false;
+    LatencyHistogram _latency;
+    static constexpr size_t RX_CHUNK = 64;  // Serial2 から一括で読み出す量
+    // テキスト受信で読み出したが未処理のバイト（応答リングの空き待ちで次の loop() へ持ち越す）
+    uint8_t _rxChunk[RX_CHUNK];
+    size_t _rxChunkPos = 0;
+    size_t _rxChunkLen = 0;
+
+    // 送信リング（ループ側は積むだけ、uartTx タスクが UART へ書き出す）
+    static constexpr size_t TX_MAX_FRAME = 256;
+    // 受信を1回処理する前に応答リングに残しておく空き（最悪ケースの応答がすべて入る量）
+    // テキスト: 1行で最大10行の応答（'?' のヘルプ）
+    static constexpr size_t TEXT_REPLY_RESERVE = 10 * (TX_MAX_FRAME + 2);
+    // バイナリ: RX_CHUNK で完成する最小フレーム（ヘッダ+CMD+CRC+ETX）の数 + 前回の途中フレーム1つ
+    static constexpr size_t MIN_CMD_FRAME_LEN = CommProtocol::HEADER_LEN + 1 + 2 + 1;
+    static constexpr size_t BIN_REPLY_RESERVE = (RX_CHUNK / MIN_CMD_FRAME_LEN + 2) * (TX_MAX_FRAME + 2);
+    static constexpr size_t TX_REPLY_RING_SIZE = 4096;
+    static_assert(TX_REPLY_RING_SIZE >= TEXT_REPLY_RESERVE && TX_REPLY_RING_SIZE >= BIN_REPLY_RESERVE,
+                  "reply ring must hold the worst-case replies");
+    static constexpr UBaseType_t TX_TASK_PRIORITY = 2;
+    static constexpr BaseType_t TX_TASK_CORE = 0;
+    TxRing<SERIAL_TX_RING_SIZE> _txTelemetry;
+    TxRing<TX_REPLY_RING_SIZE> _txReply;
+    TaskHandle_t _txTask = nullptr;
+    volatile uint32_t _replyOverflows = 0;
+    uint32_t _rxDeferred = 0;
+
+    bool queueTelemetry(const uint8_t* data, size_t n);
+    void queueReply(const uint8_t* data, size_t n);
+    void replyLine(const char* text);
+    void replyf(const char* fmt, ...);
+    static void txTaskEntry(void* arg);
+    void txLoop();
+
+    bool handleTextLine(char* line, size_t len, uint16_t* servoPos8, uint16_t* servoOff8);
 };
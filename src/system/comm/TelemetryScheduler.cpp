@@ -0,0 +1,36 @@
+#include "TelemetryScheduler.h"
+
+void TelemetryScheduler::setRate(uint8_t sec, uint16_t hz) {
+    if (sec < 1 || sec > CommProtocol::SEC_COUNT) return;
+    if (hz > MAX_RATE_HZ) hz = MAX_RATE_HZ;
+    uint8_t i = sec - 1;
+    rateHz_[i] = hz;
+    periodUs_[i] = hz ? 1000000UL / hz : 0;
+    nextUs_[i] = micros();
+}
+
+uint16_t TelemetryScheduler::rate(uint8_t sec) const {
+    if (sec < 1 || sec > CommProtocol::SEC_COUNT) return 0;
+    return rateHz_[sec - 1];
+}
+
+uint8_t TelemetryScheduler::poll(uint32_t nowUs) {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < CommProtocol::SEC_COUNT; ++i) {
+        if (periodUs_[i] == 0) continue;
+        if ((int32_t)(nowUs - nextUs_[i]) < 0) continue;
+        mask |= (uint8_t)(1u << i);
+        nextUs_[i] += periodUs_[i];
+        // 1周期以上遅れていたら追いつかずに仕切り直す
+        if ((int32_t)(nowUs - nextUs_[i]) >= 0) nextUs_[i] = nowUs + periodUs_[i];
+    }
+    return mask;
+}
+
+uint8_t TelemetryScheduler::activeMask() const {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < CommProtocol::SEC_COUNT; ++i) {
+        if (periodUs_[i]) mask |= (uint8_t)(1u << i);
+    }
+    return mask;
+}
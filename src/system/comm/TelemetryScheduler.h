@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+#include "CommProtocol.h"
+
+/**
+ * @brief テレメトリのチャネル別レート管理（TYPE_TELEMETRY のセクション単位）
+ *
+ * チャネル = セクションID（ATTITUDE / IMU / SERVO / LOOP / LINK）。
+ * それぞれ独立したレート（Hz、0で停止）を持ち、poll() は期限の来たチャネルのマスクを返す。
+ * 送信側は1フレームに期限の来たセクションだけを詰めて送る。
+ * 遅れた場合に追いつこうとしてまとめて送ることはしない（次の期限は now + 周期）。
+ */
+class TelemetryScheduler {
+public:
+    static constexpr uint16_t MAX_RATE_HZ = 500;
+
+    TelemetryScheduler() {
+        for (uint8_t i = 0; i < CommProtocol::SEC_COUNT; ++i) {
+            rateHz_[i] = 0;
+            periodUs_[i] = 0;
+            nextUs_[i] = 0;
+        }
+    }
+
+    // sec: CommProtocol::SEC_*、hz=0 で停止（MAX_RATE_HZ で制限）
+    void setRate(uint8_t sec, uint16_t hz);
+    uint16_t rate(uint8_t sec) const;
+
+    // nowUs 時点で期限の来たチャネルのマスク（CommProtocol::secBit）。期限を進める
+    uint8_t poll(uint32_t nowUs);
+
+    // 有効なチャネルのマスク
+    uint8_t activeMask() const;
+
+private:
+    uint16_t rateHz_[CommProtocol::SEC_COUNT];
+    uint32_t periodUs_[CommProtocol::SEC_COUNT];
+    uint32_t nextUs_[CommProtocol::SEC_COUNT];
+};
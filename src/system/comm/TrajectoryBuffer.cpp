@@ -0,0 +1,103 @@
+#include "TrajectoryBuffer.h"
+
+void TrajectoryBuffer::start() {
+    head_ = 0;
+    count_ = 0;
+    ended_ = false;
+    hasLast_ = false;
+    playUs_ = 0;
+    state_ = State::FILLING;
+}
+
+bool TrajectoryBuffer::push(const Keyframe& k) {
+    if (state_ == State::IDLE) start();
+    if (hasLast_ && k.tMs <= lastT_) {
+        stats_.rejected++;
+        return false;
+    }
+    if (count_ >= CAPACITY) {
+        stats_.overflows++;
+        return false;
+    }
+    ring_[(head_ + count_) % CAPACITY] = k;
+    count_++;
+    lastT_ = k.tMs;
+    hasLast_ = true;
+    stats_.pushed++;
+    return true;
+}
+
+void TrajectoryBuffer::stop() {
+    count_ = 0;
+    ended_ = false;
+    hasLast_ = false;
+    state_ = State::IDLE;
+}
+
+uint32_t TrajectoryBuffer::aheadMs() const {
+    if (count_ == 0) return 0;
+    uint32_t last = at(count_ - 1).tMs;
+    uint32_t play = playMs();
+    if (state_ == State::FILLING) play = at(0).tMs;  // 再生開始前は先頭から数える
+    return last > play ? last - play : 0;
+}
+
+// 再生を(再)開できるか: 終端まで届いている、または lead 分先までたまっている
+bool TrajectoryBuffer::ready() const {
+    if (count_ == 0) return false;
+    if (ended_) return true;
+    // アンダーラン中は保持しているキーフレームより先が来ていること
+    if (state_ == State::UNDERRUN && count_ < 2) return false;
+    return aheadMs() >= lead_;
+}
+
+bool TrajectoryBuffer::update(uint32_t nowUs, uint16_t* servoPos8) {
+    if (state_ == State::IDLE) return false;
+
+    uint32_t dt = nowUs - lastUpdateUs_;
+    lastUpdateUs_ = nowUs;
+    if (state_ == State::FILLING || state_ == State::UNDERRUN) {
+        if (!ready()) return false;
+        if (state_ == State::FILLING) playUs_ = (uint64_t)at(0).tMs * 1000;
+        state_ = State::PLAYING;
+        dt = 0;  // 止まっていた間は時計を進めない
+    }
+    playUs_ += dt;
+
+    // 再生位置を過ぎたキーフレームを捨てる（補間用に直前の1つは残す）
+    while (count_ >= 2 && (uint64_t)at(1).tMs * 1000 <= playUs_) {
+        head_ = (head_ + 1) % CAPACITY;
+        count_--;
+    }
+
+    const Keyframe& a = at(0);
+    uint16_t pos[SERVO_COUNT];
+    if (count_ == 1) {
+        // 末尾に到達: 最後の姿勢を保持
+        memcpy(pos, a.pos, sizeof(pos));
+        playUs_ = (uint64_t)a.tMs * 1000;
+        if (ended_) {
+            stop();
+        } else {
+            state_ = State::UNDERRUN;
+            stats_.underruns++;
+        }
+    } else {
+        const Keyframe& b = at(1);
+        uint32_t span = (b.tMs - a.tMs) * 1000;
+        uint32_t into = (uint32_t)(playUs_ - (uint64_t)a.tMs * 1000);
+        for (uint8_t i = 0; i < SERVO_COUNT; ++i) {
+            int32_t d = (int32_t)b.pos[i] - (int32_t)a.pos[i];
+            pos[i] = (uint16_t)(a.pos[i] + (int32_t)(((int64_t)d * into + span / 2) / span));
+        }
+    }
+
+    bool changed = false;
+    for (uint8_t i = 0; i < SERVO_COUNT; ++i) {
+        if (servoPos8[i] != pos[i]) {
+            servoPos8[i] = pos[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
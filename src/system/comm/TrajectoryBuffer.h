@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * @brief サーボ軌道のジッタバッファ（ホストが先行送信したキーフレームをデバイスの時計で再生）
+ *
+ * ホストはストリーム先頭からの時刻 tMs 付きのキーフレームを先行して送り、
+ * デバイスは lead（ms）分たまってから自分の時計で再生を始める（キーフレーム間は線形補間）。
+ * 通信の揺らぎは lead で吸収し、バッファが尽きたら最後の姿勢で停止して
+ * 再び lead 分たまるまで時計を止める（アンダーラン、回数を記録）。
+ * loop() からのみ呼ぶこと（排他なし）。
+ */
+class TrajectoryBuffer {
+public:
+    static constexpr uint8_t CAPACITY = 64;   // キーフレーム数（20B×64）
+    static constexpr uint8_t SERVO_COUNT = 8;
+
+    struct Keyframe {
+        uint32_t tMs;                   // ストリーム先頭からの時刻（単調増加）
+        uint16_t pos[SERVO_COUNT];      // 角度（0～180）
+    };
+
+    enum class State : uint8_t {
+        IDLE = 0,      // 停止中（サーボは他のコマンドで制御）
+        FILLING = 1,   // 開始直後、lead 分たまるのを待っている
+        PLAYING = 2,   // 再生中
+        UNDERRUN = 3,  // バッファ切れ。最後の姿勢を保持して再充填待ち
+    };
+
+    struct Stats {
+        uint32_t pushed;     // 受け付けたキーフレーム数
+        uint32_t rejected;   // 時刻が戻っていて捨てた数（重複・順序逆転）
+        uint32_t overflows;  // バッファ満杯で捨てた数
+        uint32_t underruns;  // アンダーラン回数
+    };
+
+    void setLead(uint16_t ms) { lead_ = ms; }
+    uint16_t lead() const { return lead_; }
+
+    // 新しいストリームを開始（残っているキーフレームは破棄）
+    void start();
+    // キーフレームを追加。受け付けたら true（IDLE 中なら新しいストリームとして開始）
+    bool push(const Keyframe& k);
+    // ストリーム終端を通知（最後のキーフレームまで再生したら IDLE へ）
+    void end() { ended_ = true; }
+    // 再生を止めて破棄（現在の姿勢のまま）
+    void stop();
+
+    // 再生を進め、再生中なら補間した姿勢を servoPos8 に書き込む。値が変わったら true
+    bool update(uint32_t nowUs, uint16_t* servoPos8);
+
+    State state() const { return state_; }
+    uint8_t depth() const { return count_; }
+    uint8_t freeSlots() const { return CAPACITY - count_; }
+    uint32_t playMs() const { return (uint32_t)(playUs_ / 1000); }
+    // 再生位置から最後のキーフレームまでの時間（ホストの送信ペース調整用）
+    uint32_t aheadMs() const;
+    const Stats& stats() const { return stats_; }
+
+private:
+    const Keyframe& at(uint8_t i) const { return ring_[(head_ + i) % CAPACITY]; }
+    bool ready() const;
+
+    Keyframe ring_[CAPACITY];
+    uint8_t head_ = 0;
+    uint8_t count_ = 0;
+    bool ended_ = false;
+    State state_ = State::IDLE;
+    uint16_t lead_ = 100;
+    bool hasLast_ = false;
+    uint32_t lastT_ = 0;         // 最後に受け付けたキーフレームの時刻
+    uint64_t playUs_ = 0;        // 再生位置（ストリーム時刻、μs）
+    uint32_t lastUpdateUs_ = 0;
+    Stats stats_ = Stats();
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+
+/**
+ * @brief 送信用フレームリングバッファ（固定長、フレーム単位で出し入れ）
+ *
+ * [LEN(2)][DATA(LEN)] をバイトリングに詰めて保持する。
+ * 取り出しはフレーム単位のため、古いフレームを捨てても途中で途切れたフレームは送出されない。
+ * push/pop は別タスクから呼んでよい（内部でクリティカルセクションを取る）。
+ */
+template <size_t N>
+class TxRing {
+public:
+    struct Stats {
+        uint32_t bytesQueued;    // 投入されたバイト数
+        uint32_t bytesDropped;   // 破棄されたバイト数（古いフレーム or 投入拒否）
+        uint32_t framesDropped;  // 破棄されたフレーム数
+        uint32_t peakDepth;      // 最大滞留バイト数（LENヘッダ含む）
+    };
+
+    // dropOldest=true なら空きができるまで古いフレームを捨てる。false なら満杯時に投入を拒否。
+    bool push(const uint8_t* data, size_t n, bool dropOldest) {
+        const size_t need = n + 2;
+        if (n == 0 || need > N) {
+            portENTER_CRITICAL(&mux_);
+            stats_.bytesDropped += n;
+            stats_.framesDropped++;
+            portEXIT_CRITICAL(&mux_);
+            return false;
+        }
+        portENTER_CRITICAL(&mux_);
+        while (N - used_ < need) {
+            if (!dropOldest) {
+                portEXIT_CRITICAL(&mux_);
+                return false;
+            }
+            uint16_t len = peekLen();
+            skip(len + 2);
+            stats_.bytesDropped += len;
+            stats_.framesDropped++;
+        }
+        uint8_t hdr[2] = { (uint8_t)(n & 0xFF), (uint8_t)(n >> 8) };
+        put(hdr, 2);
+        put(data, n);
+        stats_.bytesQueued += n;
+        if (used_ > stats_.peakDepth) stats_.peakDepth = used_;
+        portEXIT_CRITICAL(&mux_);
+        return true;
+    }
+
+    // 先頭フレームを out へ取り出す。空なら0。outMax より大きいフレームは捨てて0を返す。
+    size_t pop(uint8_t* out, size_t outMax) {
+        portENTER_CRITICAL(&mux_);
+        if (used_ == 0) {
+            portEXIT_CRITICAL(&mux_);
+            return 0;
+        }
+        uint16_t len = peekLen();
+        skip(2);
+        if (len > outMax) {
+            skip(len);
+            stats_.bytesDropped += len;
+            stats_.framesDropped++;
+            portEXIT_CRITICAL(&mux_);
+            return 0;
+        }
+        get(out, len);
+        portEXIT_CRITICAL(&mux_);
+        return len;
+    }
+
+    size_t depth() const { return used_; }
+    // 空き容量（LENヘッダ込み。n バイトのフレームは n+2 必要）
+    size_t space() const { return N - used_; }
+    bool empty() const { return used_ == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    Stats stats() {
+        portENTER_CRITICAL(&mux_);
+        Stats s = stats_;
+        portEXIT_CRITICAL(&mux_);
+        return s;
+    }
+
+private:
+    uint16_t peekLen() const {
+        return (uint16_t)(buf_[head_] | (buf_[(head_ + 1) % N] << 8));
+    }
+    void skip(size_t n) {
+        head_ = (head_ + n) % N;
+        used_ -= n;
+    }
+    void put(const uint8_t* src, size_t n) {
+        size_t tail = (head_ + used_) % N;
+        size_t first = (n < N - tail) ? n : N - tail;
+        memcpy(buf_ + tail, src, first);
+        memcpy(buf_, src + first, n - first);
+        used_ += n;
+    }
+    void get(uint8_t* dst, size_t n) {
+        size_t first = (n < N - head_) ? n : N - head_;
+        memcpy(dst, buf_ + head_, first);
+        memcpy(dst + first, buf_, n - first);
+        skip(n);
+    }
+
+    uint8_t buf_[N];
+    size_t head_ = 0;
+    volatile size_t used_ = 0;
+    Stats stats_ = Stats();
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
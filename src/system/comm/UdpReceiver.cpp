@@ -0,0 +1,148 @@
+#include "UdpReceiver.h"
+
+bool UdpReceiver::begin(uint16_t port) {
+    _ready = _udp.begin(port);
+    _lastPollUs = micros();
+    if (_ready) {
+        Serial.printf("UDP: listening on port %u\n", port);
+    } else {
+        Serial.println("UDP: listen failed");
+    }
+    return _ready;
+}
+
+bool UdpReceiver::poll(uint16_t* servoPos8, uint16_t* servoOff8) {
+    if (!_ready) return false;
+
+    uint32_t prevPollUs = _lastPollUs;
+    _sink.servoPos8 = servoPos8;
+    _sink.servoOff8 = servoOff8;
+    _stateChanged = false;
+
+    // 溜まっているデータグラムを全て読み出す
+    int packetSize;
+    while ((packetSize = _udp.parsePacket()) > 0) {
+        _stats.datagrams++;
+        uint32_t rxUs = micros();
+        if (packetSize > (int)sizeof(_buf)) {
+            _stats.oversize++;
+        } else {
+            int len = _udp.read(_buf, sizeof(_buf));
+            _remoteIp = _udp.remoteIP();
+            _remotePort = _udp.remotePort();
+            if (len <= 0 || !handleDatagram(_buf, (size_t)len, rxUs)) {
+                _stats.malformed++;
+            }
+        }
+        // 未読分を破棄しないと次の parsePacket() が0を返し続ける
+        _udp.flush();
+    }
+    _lastPollUs = micros();
+    _sink.servoPos8 = nullptr;
+    _sink.servoOff8 = nullptr;
+
+    if (!_stateChanged) return false;
+
+    // 呼び出し側は true を受けてすぐサーボへ反映する
+    uint32_t age = _lastPollUs - prevPollUs;
+    _stats.lastAgeUs = age;
+    if (age > _stats.maxAgeUs) _stats.maxAgeUs = age;
+    return true;
+}
+
+bool UdpReceiver::handleDatagram(const uint8_t* data, size_t len, uint32_t rxUs) {
+    CommProtocol::Frame f;
+    uint8_t legacy[1 + 16];
+    bool hasSeq = true;
+
+    if (!CommProtocol::parseFrame(data, len, f)) {
+        // 旧形式: 先頭2バイト=SYNC(0xAA55), その後8ch分のu16(16バイト) → SET_ALL として扱う
+        if (len != 2 + 16 || data[0] != CommProtocol::SYNC0 || data[1] != CommProtocol::SYNC1) {
+            return false;
+        }
+        legacy[0] = CommProtocol::CMD_SET_ALL;
+        memcpy(legacy + 1, data + 2, 16);
+        f.ver = CommProtocol::VERSION;
+        f.type = CommProtocol::TYPE_COMMAND;
+        f.seq = 0;
+        f.payload = legacy;
+        f.len = sizeof(legacy);
+        hasSeq = false;
+    }
+    if (f.ver != CommProtocol::VERSION || f.type != CommProtocol::TYPE_COMMAND || f.len < 1) {
+        return false;
+    }
+
+    _sink.rxUs = rxUs;
+    // 購読し直し・解除した送信元は SEQ を数え直す（ホスト側の再起動で SEQ が戻るため）
+    if (f.payload[0] == CommProtocol::CMD_HELLO || f.payload[0] == CommProtocol::CMD_BYE) {
+        forgetSeqSource();
+    }
+    bool isState = CommandDispatcher::isStateCommand(f.payload[0]);
+    if (isState && hasSeq && !acceptSeq(f.seq)) {
+        return true;  // 古い指令（正常なフレームなので malformed には数えない）
+    }
+    if (!CommandDispatcher::dispatch(f, _sink)) return false;
+
+    if (isState) {
+        // 旧形式は角度を0～180に制限していたので合わせる
+        if (!hasSeq) {
+            for (int i = 0; i < 8; ++i) {
+                if (_sink.servoPos8[i] > 180) _sink.servoPos8[i] = 180;
+            }
+        }
+        if (_stateChanged) _stats.superseded++;
+        _stateChanged = true;
+        _stats.applied++;
+    }
+    return true;
+}
+
+// サーボ状態コマンドの SEQ を送信元ごとに検査（新しければ true）
+bool UdpReceiver::acceptSeq(uint16_t seq) {
+    uint32_t now = millis();
+    SeqSource* src = findSeqSource();
+    if (src->port != 0) {
+        int16_t d = (int16_t)(seq - src->lastSeq);
+        if (now - src->lastMs > SEQ_IDLE_MS || d > SEQ_RESYNC_WINDOW || d < -SEQ_RESYNC_WINDOW) {
+            // 途絶後・大きな飛びは送信側の再起動とみなし、この SEQ から追跡し直す
+            _stats.seqResyncs++;
+        } else if (d <= 0) {
+            _stats.seqReorders++;
+            return false;
+        } else if (d > 1) {
+            _stats.seqGaps += (uint32_t)(d - 1);
+        }
+    }
+    src->ip = _remoteIp;
+    src->port = _remotePort;
+    src->lastSeq = seq;
+    src->lastMs = now;
+    return true;
+}
+
+// 現在の送信元の追跡状態を返す。未登録なら空き（無ければ最も古い）スロットを未使用にして返す
+UdpReceiver::SeqSource* UdpReceiver::findSeqSource() {
+    uint32_t now = millis();
+    SeqSource* victim = &_seqSources[0];
+    for (auto& s : _seqSources) {
+        if (s.port == _remotePort && s.ip == _remoteIp) return &s;
+        if (victim->port == 0) continue;
+        if (s.port == 0 || now - s.lastMs > now - victim->lastMs) victim = &s;
+    }
+    victim->port = 0;
+    return victim;
+}
+
+void UdpReceiver::forgetSeqSource() {
+    for (auto& s : _seqSources) {
+        if (s.port == _remotePort && s.ip == _remoteIp) s.port = 0;
+    }
+}
+
+void UdpReceiver::reply(const uint8_t* frame, size_t n) {
+    if (_remotePort == 0) return;
+    _udp.beginPacket(_remoteIp, _remotePort);
+    _udp.write(frame, n);
+    _udp.endPacket();
+}
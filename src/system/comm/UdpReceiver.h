@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "CommProtocol.h"
+#include "CommandDispatcher.h"
+
+/**
+ * @brief UDPコマンドの受信（キュー全読み出し・最新優先）
+ *
+ * poll() 1回で lwIP に溜まったデータグラムを全て読み出し、到着順に処理する。
+ * サーボへの反映は poll() の後に1回だけ行うため、実際に出力されるのは最新の指令のみとなり、
+ * 制御周期より速く指令が届いても古い指令が溜まって遅延が積み上がることはない。
+ *
+ * 受け付ける形式:
+ *  - TYPE_COMMAND フレーム（シリアルと同じコマンドセット、ETX省略可）。処理は CommandDispatcher と共通
+ *    サーボ状態を書き換えるコマンドは送信元（IP:ポート）ごとに SEQ で新旧を判定し、古い・重複したものは捨てる
+ *    HELLO/BYE・一定時間の途絶・大きな SEQ の飛びでは送信側が再起動したとみなし、追跡をやり直す
+ *  - 旧形式: [AA 55][u16 LE ×8]（18バイト、SET_ALL 相当。SEQ無し → 到着順で最新とみなす）
+ * サイズ超過・形式不正のデータグラムは読み捨てる（キューに残さない）。
+ * 応答（PONG 等）は送信元のアドレス・ポートへ返す。
+ */
+class UdpReceiver {
+public:
+    struct Stats {
+        uint32_t datagrams;       // 受信データグラム数
+        uint32_t applied;         // 処理したサーボ状態コマンド数
+        uint32_t superseded;      // 同じ poll 内でより新しい指令に上書きされた数
+        uint32_t oversize;        // 受信バッファ超過で読み捨てた数
+        uint32_t malformed;       // 形式不正・CRC不一致・未対応コマンドで捨てた数
+        uint32_t seqGaps;         // 欠番数（SEQ付き指令）
+        uint32_t seqReorders;     // 逆転・重複で捨てた数（SEQ付き指令）
+        uint32_t seqResyncs;      // 途絶・SEQの大きな飛びで追跡をやり直した数
+        // 直近に適用した指令の経過時間の上限（前回 poll の終了→今回 poll の終了）。
+        // 指令は前回 poll で読み切った後に届いているので、届いてからサーボへ反映するまでの時間はこれ以下
+        uint32_t lastAgeUs;
+        uint32_t maxAgeUs;
+    };
+
+    UdpReceiver() : _ready(false) {
+        _sink.tag = "UdpCmd";
+        _sink.addEtx = false;
+        _sink.verbose = false;  // WiFi レートで届くためコマンドごとのログは出さない
+        _sink.reply = [this](const uint8_t* frame, size_t n) { reply(frame, n); };
+        _sink.latency = &_latency;
+    }
+    bool begin(uint16_t port);
+    bool isReady() const { return _ready; }
+
+    // 送信形式・バッチ設定コマンドの適用先（UdpSender 側の設定を渡す）
+    void setFormatHandler(std::function<uint8_t(uint8_t)> fn) { _sink.setFormat = fn; }
+    void setBatchHandler(std::function<void(uint8_t&, uint16_t&)> fn) { _sink.setBatch = fn; }
+    // SUBSCRIBE の適用先（UdpSender のチャネル別レート）
+    void setScheduler(TelemetryScheduler* sched) { _sink.scheduler = sched; }
+    // TRAJ_PUSH / TRAJ_CTRL の適用先（未設定なら非対応）
+    void setTrajectory(TrajectoryBuffer* traj) { _sink.trajectory = traj; }
+    // REC の適用先（SD保存は setRecordingSaver で指定）
+    void setRecorder(FlightRecorder* rec) { _sink.recorder = rec; }
+    void setRecordingSaver(std::function<bool()> fn) { _sink.saveRecording = fn; }
+    // IMU_PROFILE の適用先（Settings への保存とセンサーへの反映は main 側）
+    void setImuProfileHandler(std::function<void(uint8_t&)> fn) { _sink.setImuProfile = fn; }
+    // HELLO/BYE の適用先。送信元IPと要求ポート（0=送信元ポート）・streams を渡す。戻り値はスロット（-1=満杯）
+    using PeerHandler = std::function<int(IPAddress ip, uint16_t port, uint8_t streams)>;
+    void setPeerHandler(PeerHandler fn, uint8_t maxPeers, uint16_t idleS) {
+        _peerHandler = fn;
+        _sink.maxPeers = maxPeers;
+        _sink.peerIdleS = idleS;
+        _sink.subscribe = [this](uint16_t port, uint8_t streams) {
+            return _peerHandler(_remoteIp, port ? port : _remotePort, streams);
+        };
+    }
+
+    // HELLO 応答に載せる購読者ごとの送信統計（UdpSender::peer() を main から渡す）
+    void setPeerStatsSource(std::function<bool(uint8_t slot, uint32_t& packets, uint32_t& failures)> fn) {
+        _sink.peerStats = fn;
+    }
+
+    // loop() から毎回呼ぶ。サーボ位置・オフセットを変更したら true
+    bool poll(uint16_t* servoPos8, uint16_t* servoOff8);
+
+    const Stats& stats() const { return _stats; }
+    void clearStats() { _stats = Stats(); }
+    // ホストが PING_TS で報告した往復遅延
+    const LatencyHistogram& latency() const { return _latency; }
+
+    static constexpr size_t RX_BUF_SIZE = 128;
+    // SEQ を追跡する送信元の数（超えたら最も古い送信元を置き換える）
+    static constexpr size_t SEQ_SOURCES = 4;
+    // この時間指令が途絶えた送信元は、次の SEQ から追跡し直す
+    static constexpr uint32_t SEQ_IDLE_MS = 1000;
+    // 前回からの SEQ の差がこれを超えたら（前後とも）送信側のリセットとみなす
+    static constexpr int16_t SEQ_RESYNC_WINDOW = 256;
+
+private:
+    bool handleDatagram(const uint8_t* data, size_t len, uint32_t rxUs);
+    // 送信元ごとの SEQ 追跡状態
+    struct SeqSource {
+        IPAddress ip;
+        uint16_t port = 0;      // 0 = 未使用
+        uint16_t lastSeq = 0;
+        uint32_t lastMs = 0;    // 最後に受け入れた時刻
+    };
+    bool acceptSeq(uint16_t seq);
+    SeqSource* findSeqSource();
+    void forgetSeqSource();
+    void reply(const uint8_t* frame, size_t n);
+
+    WiFiUDP _udp;
+    bool _ready;
+    uint8_t _buf[RX_BUF_SIZE];
+    CommandDispatcher::CommandSink _sink;
+    PeerHandler _peerHandler;
+    IPAddress _remoteIp;
+    uint16_t _remotePort = 0;
+
+    // 今回の poll でサーボ状態を変更したか
+    bool _stateChanged = false;
+
+    SeqSource _seqSources[SEQ_SOURCES];
+    uint32_t _lastPollUs = 0;
+
+    Stats _stats = Stats();
+    LatencyHistogram _latency;
+};
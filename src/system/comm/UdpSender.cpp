@@ -2,28 +2,150 @@
 
 bool UdpSender::begin() {
     WiFi.mode(WIFI_STA);
+    // チャネル別レートの既定値（姿勢・IMU・サーボは制御周期、統計は購読されるまで停止）
+    _sched.setRate(CommProtocol::SEC_ATTITUDE, CONTROL_RATE_HZ);
+    _sched.setRate(CommProtocol::SEC_IMU, CONTROL_RATE_HZ);
+    _sched.setRate(CommProtocol::SEC_SERVO, CONTROL_RATE_HZ);
+    _backoffMs = BACKOFF_MIN_MS;
+    startConnect(millis());
+    return true;
+}
+
+void UdpSender::startConnect(uint32_t now) {
+    _ready = false;
+    WiFi.disconnect();
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    uint32_t start = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - start) < 15000) {
-        delay(100);
-    }
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("UDP: WiFi connect failed");
-        _ready = false;
-        return false;
+    _linkState = LinkState::CONNECTING;
+    _stateSinceMs = now;
+    Serial.printf("UDP: WiFi connecting to %s\n", WIFI_SSID);
+}
+
+// WiFi接続の状態遷移（ブロックしない）
+void UdpSender::pollLink(uint32_t now) {
+    bool up = WiFi.status() == WL_CONNECTED;
+    switch (_linkState) {
+    case LinkState::IDLE:
+        break;
+    case LinkState::CONNECTING:
+        if (up) {
+            if (!_udpStarted) {
+                _udp.begin(0); // ephemeral local port
+                _udpStarted = true;
+            }
+            _ready = true;
+            _linkState = LinkState::CONNECTED;
+            _backoffMs = BACKOFF_MIN_MS;
+            _connectCount++;
+            Serial.printf("UDP: ready after %lu ms (boot+%lu ms), ip=%s\n",
+                (unsigned long)(now - _stateSinceMs), (unsigned long)now,
+                WiFi.localIP().toString().c_str());
+        } else if (now - _stateSinceMs >= CONNECT_TIMEOUT_MS) {
+            Serial.printf("UDP: WiFi connect failed, retry in %lu ms\n", (unsigned long)_backoffMs);
+            WiFi.disconnect();
+            _linkState = LinkState::BACKOFF;
+            _stateSinceMs = now;
+        }
+        break;
+    case LinkState::CONNECTED:
+        if (!up) {
+            Serial.println("UDP: WiFi link lost, reconnecting");
+            _batchCount = 0;
+            _batchLen = 0;
+            startConnect(now);
+        }
+        break;
+    case LinkState::BACKOFF:
+        if (now - _stateSinceMs >= _backoffMs) {
+            _backoffMs = _backoffMs * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : _backoffMs * 2;
+            startConnect(now);
+        }
+        break;
     }
-    _target = IPAddress(UDP_TARGET_IP0, UDP_TARGET_IP1, UDP_TARGET_IP2, UDP_TARGET_IP3);
-    _udp.begin(0); // ephemeral local port
-    _ready = true;
-    Serial.printf("UDP: ready, target=%s:%u\n", _target.toString().c_str(), _port);
-    return true;
 }
 
-bool UdpSender::sendImuPacket(const uint8_t* buf, size_t n, IPAddress target, uint16_t port) {
+bool UdpSender::sendImuPacket(const uint8_t* buf, size_t n) {
     if (!_ready) return false;
+    return sendStream(CommProtocol::STREAM_IMU, buf, n);
+}
+
+int UdpSender::subscribe(IPAddress ip, uint16_t port, uint8_t streams) {
+    int freeSlot = -1;
+    for (int i = 0; i < MAX_PEERS; ++i) {
+        Peer& p = _peers[i];
+        if (p.active && p.ip == ip && p.port == port) {
+            if (streams == 0) {
+                p.active = false;
+                Serial.printf("UDP: peer %d unsubscribed (%s:%u)\n", i, ip.toString().c_str(), port);
+                return i;
+            }
+            p.streams = streams;
+            p.lastSeenMs = millis();
+            return i;
+        }
+        if (!p.active && freeSlot < 0) freeSlot = i;
+    }
+    if (streams == 0 || freeSlot < 0) return -1;
+
+    Peer& p = _peers[freeSlot];
+    p = Peer();
+    p.ip = ip;
+    p.port = port;
+    p.streams = streams;
+    p.active = true;
+    p.lastSeenMs = millis();
+    _v2Encoder.forceFull();  // 新しい購読者にも全サーボが届くように
+    Serial.printf("UDP: peer %d subscribed (%s:%u streams=0x%02X)\n", freeSlot, ip.toString().c_str(), port, streams);
+    return freeSlot;
+}
+
+uint8_t UdpSender::peerCount() const {
+    uint8_t n = 0;
+    for (const Peer& p : _peers) {
+        if (p.active) n++;
+    }
+    return n;
+}
+
+void UdpSender::expirePeers(uint32_t now) {
+    for (int i = 0; i < MAX_PEERS; ++i) {
+        Peer& p = _peers[i];
+        if (p.active && now - p.lastSeenMs >= PEER_IDLE_MS) {
+            p.active = false;
+            Serial.printf("UDP: peer %d expired (%s:%u)\n", i, p.ip.toString().c_str(), p.port);
+        }
+    }
+}
+
+// 購読者へユニキャスト。購読者がいなければ（有効時のみ）ブロードキャスト
+bool UdpSender::sendStream(uint8_t stream, const uint8_t* buf, size_t n) {
+    bool sent = false;
+    bool ok = true;
+    for (Peer& p : _peers) {
+        if (!p.active || !(p.streams & stream)) continue;
+        if (sendDatagram(p.ip, p.port, buf, n)) {
+            p.packets++;
+        } else {
+            p.failures++;
+            ok = false;
+        }
+        sent = true;
+    }
+    if (!sent && _broadcastFallback) {
+        uint16_t port = stream == CommProtocol::STREAM_IMU ? IMU_BROADCAST_PORT : UDP_TARGET_PORT;
+        return sendDatagram(WiFi.broadcastIP(), port, buf, n);
+    }
+    return sent && ok;
+}
+
+bool UdpSender::sendDatagram(IPAddress target, uint16_t port, const uint8_t* buf, size_t n) {
     _udp.beginPacket(target, port);
     _udp.write(buf, n);
-    _udp.endPacket();
+    if (!_udp.endPacket()) {
+        _stats.failures++;
+        return false;
+    }
+    _stats.packets++;
+    _stats.bytes += n;
     return true;
 }
 
@@ -51,8 +173,162 @@ bool UdpSender::sendControl(
         _ax, _ay, _az, _gx, _gy, _gz, _t8,
         servoPos8, servoOff8, seq, false);
     if (n == 0) return false;
-    _udp.beginPacket(_target, _port);
-    _udp.write(buf, n);
-    _udp.endPacket();
+    sendStream(CommProtocol::STREAM_CONTROL, buf, n);
+    _stats.samples++;
     return true;
 }
+
+bool UdpSender::sendControl(const CommProtocol::ControlSample& sample, uint16_t seq) {
+    if (!_ready) return false;
+
+    // 旧クライアント（STREAM_IMU 購読者）にはIMUパケットを複製して送る
+    bool legacySent = false;
+    if (wantsStream(CommProtocol::STREAM_IMU)) {
+        uint8_t legacy[CommProtocol::LEGACY_IMU_LEN];
+        size_t n = CommProtocol::buildLegacyImuPacket(legacy, sizeof(legacy), sample);
+        legacySent = n > 0 && sendStream(CommProtocol::STREAM_IMU, legacy, n);
+    }
+    if (!wantsStream(CommProtocol::STREAM_CONTROL)) return legacySent;
+
+    // バッチ送信中は pushSample() が IMU の全サンプルを積む
+    if (_batchMax > 1) return legacySent;
+
+    uint8_t buf[CommProtocol::TELEMETRY_MAX_LEN];
+    size_t n = 0;
+    if (_txType == CommProtocol::TYPE_TELEMETRY) {
+        // 期限の来たチャネルだけを1データグラムに統合（telemetryDue() を通さない場合は有効な全チャネル）
+        uint8_t mask = _dueMask ? _dueMask : _sched.activeMask();
+        _dueMask = 0;
+        if (mask == 0) return legacySent;
+        CommProtocol::LinkStats link = {};
+        if (mask & CommProtocol::secBit(CommProtocol::SEC_LINK)) link = linkStats();
+        n = CommProtocol::buildTelemetryFrame(buf, sizeof(buf), sample, seq, mask, false, &link);
+    } else if (_txType == CommProtocol::TYPE_CONTROL_V2) {
+        n = _v2Encoder.build(buf, sizeof(buf), sample, seq, false);
+    } else {
+        n = CommProtocol::buildControlPacket(buf, sizeof(buf),
+            sample.ax, sample.ay, sample.az, sample.gx, sample.gy, sample.gz,
+            sample.tempByte, sample.servoPos8, sample.servoOff8, seq, false);
+    }
+    if (n == 0) return legacySent;
+    sendStream(CommProtocol::STREAM_CONTROL, buf, n);
+    _stats.samples++;
+    return true;
+}
+
+bool UdpSender::pushSample(const CommProtocol::ControlSample& sample, uint16_t seq) {
+    if (!_ready || _batchMax <= 1) return false;
+    if (!wantsStream(CommProtocol::STREAM_CONTROL)) return false;
+
+    // V2レコードとして溜め、個数か経過時間で送信
+    if (_batchCount == 0) {
+        _batchLen = CommProtocol::HEADER_LEN + 1;  // ヘッダ + count
+        _batchSeq = seq;
+        _batchStartMs = millis();
+        // データグラム単体で復元できるよう先頭レコードは全サーボを載せる
+        _v2Encoder.forceFull();
+    }
+    size_t n = _v2Encoder.writeRecord(_batchBuf + _batchLen, sizeof(_batchBuf) - 2 - _batchLen, sample);
+    if (n == 0) return false;
+    _batchLen += n;
+    _batchCount++;
+    _stats.samples++;
+    if (_batchCount >= _batchMax) flushBatch();
+    return true;
+}
+
+bool UdpSender::telemetryDue(uint32_t nowUs) {
+    if (!_ready) return false;
+    if (_txType == CommProtocol::TYPE_TELEMETRY) {
+        _dueMask = _sched.poll(nowUs);
+        return _dueMask != 0;
+    }
+    if ((int32_t)(nowUs - _nextBaseUs) < 0) return false;
+    _nextBaseUs += 1000000UL / CONTROL_RATE_HZ;
+    if ((int32_t)(nowUs - _nextBaseUs) >= 0) _nextBaseUs = nowUs + 1000000UL / CONTROL_RATE_HZ;
+    return true;
+}
+
+CommProtocol::LinkStats UdpSender::linkStats() const {
+    CommProtocol::LinkStats link = {};
+    link.txPackets = _stats.packets;
+    link.txDropped = _stats.failures;
+    if (_rxStatsSource) _rxStatsSource(link);
+    link.rssi = (int8_t)WiFi.RSSI();
+    link.txPacketsPerSec = (uint16_t)(_stats.packetsPerSec > 65535.0f ? 65535 : lroundf(_stats.packetsPerSec));
+    link.txBytesPerSec = (uint32_t)lroundf(_stats.bytesPerSec);
+    return link;
+}
+
+bool UdpSender::wantsStream(uint8_t stream) const {
+    if (_broadcastFallback) return true;
+    for (const Peer& p : _peers) {
+        if (p.active && (p.streams & stream)) return true;
+    }
+    return false;
+}
+
+void UdpSender::setTelemetryType(uint8_t type) {
+    _txType = type;
+    _v2Encoder.forceFull();
+    if (type == CommProtocol::TYPE_TELEMETRY && _batchMax > 1) {
+        setBatching(1, _batchMaxAgeMs);
+    }
+}
+
+void UdpSender::setBatching(uint8_t maxSamples, uint16_t maxAgeMs) {
+    if (_batchCount > 0) flushBatch();
+    if (maxSamples > MAX_BATCH) maxSamples = MAX_BATCH;
+    // バッチは制御周期で溜めるので、SUBSCRIBE のチャネル別レートとは両立しない
+    if (_txType == CommProtocol::TYPE_TELEMETRY && maxSamples > 1) maxSamples = 1;
+    _batchMax = maxSamples;
+    _batchMaxAgeMs = maxAgeMs;
+    _v2Encoder.forceFull();
+    Serial.printf("UDP: batching %s (n=%u, age=%ums)\n",
+        _batchMax > 1 ? "ON" : "OFF", _batchMax, _batchMaxAgeMs);
+}
+
+bool UdpSender::flushBatch() {
+    if (_batchCount == 0) return false;
+
+    // ヘッダを埋めて CRC を付加（CRC範囲は TYPE_CONTROL と同じ SYNC～PAYLOAD）
+    uint16_t payloadLen = (uint16_t)(_batchLen - CommProtocol::HEADER_LEN);
+    uint8_t* p = _batchBuf;
+    p[0] = CommProtocol::SYNC0;
+    p[1] = CommProtocol::SYNC1;
+    p[2] = CommProtocol::VERSION;
+    p[3] = CommProtocol::TYPE_CONTROL_BATCH;
+    p[4] = (uint8_t)(_batchSeq & 0xFF);
+    p[5] = (uint8_t)(_batchSeq >> 8);
+    p[6] = (uint8_t)(payloadLen & 0xFF);
+    p[7] = (uint8_t)(payloadLen >> 8);
+    p[8] = _batchCount;
+    uint16_t crc = CommProtocol::crc16_ccitt(_batchBuf, _batchLen);
+    _batchBuf[_batchLen] = (uint8_t)(crc & 0xFF);
+    _batchBuf[_batchLen + 1] = (uint8_t)(crc >> 8);
+
+    bool ok = sendStream(CommProtocol::STREAM_CONTROL, _batchBuf, _batchLen + 2);
+    _batchCount = 0;
+    _batchLen = 0;
+    return ok;
+}
+
+void UdpSender::poll() {
+    uint32_t now = millis();
+    pollLink(now);
+    expirePeers(now);
+
+    if (_batchCount > 0 && (uint32_t)(now - _batchStartMs) >= _batchMaxAgeMs) {
+        flushBatch();
+    }
+
+    // 1秒ごとに送信レートを更新
+    uint32_t dt = now - _rateLastMs;
+    if (dt >= 1000) {
+        _stats.packetsPerSec = (_stats.packets - _rateLastPackets) * 1000.0f / dt;
+        _stats.bytesPerSec = (_stats.bytes - _rateLastBytes) * 1000.0f / dt;
+        _rateLastPackets = _stats.packets;
+        _rateLastBytes = _stats.bytes;
+        _rateLastMs = now;
+    }
+}
@@ -2,14 +2,28 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WiFiUdp.h>
+#include <functional>
 #include "CommProtocol.h"
+#include "TelemetryScheduler.h"
 #include "config.h"
 
 class UdpSender {
 public:
-    UdpSender() : _ready(false), _port(UDP_TARGET_PORT) {}
+    // WiFi リンクの状態（poll() で遷移する）
+    enum class LinkState : uint8_t {
+        IDLE,        // begin() 前
+        CONNECTING,  // WiFi.begin() 済み、接続待ち
+        CONNECTED,   // 接続済み（isReady()==true）
+        BACKOFF,     // 接続失敗・切断後の再試行待ち
+    };
+
+    UdpSender() : _ready(false) {}
+    // 接続を開始してすぐ戻る（待たない）。接続完了は poll() が検出して isReady() が true になる。
+    // 接続中・接続済みに再度呼ぶと接続をやり直す。
     bool begin();
     bool isReady() const { return _ready; }
+    LinkState linkState() const { return _linkState; }
+    uint32_t connectCount() const { return _connectCount; }  // 接続成功回数（再接続含む）
 
     bool sendControl(
         float ax, float ay, float az,
@@ -20,12 +34,121 @@ public:
         uint16_t seq,
         bool includeImu = true);  // IMUデータを含むか
 
-    // IMUデータ専用UDP送信
-    bool sendImuPacket(const uint8_t* buf, size_t n, IPAddress target, uint16_t port);
+    // ネゴシエーション済みの形式（TYPE_CONTROL / V2 / TELEMETRY）で STREAM_CONTROL 購読者へ送信し、
+    // STREAM_IMU 購読者（旧クライアント）には旧IMUパケットを複製して送る。
+    // バッチ送信中の STREAM_CONTROL は pushSample() で積むので、ここでは旧IMUパケットだけを送る
+    bool sendControl(const CommProtocol::ControlSample& sample, uint16_t seq);
+
+    // バッチ送信中に1サンプルをバッチへ積む（IMU の全サンプルを loop() から渡す）。
+    // seq はサンプルごとの連番。バッチ無効・購読者なしなら何もせず false
+    bool pushSample(const CommProtocol::ControlSample& sample, uint16_t seq);
+
+    // 送信形式の切り替え（既定は旧クライアント互換の TYPE_CONTROL）
+    // TYPE_TELEMETRY はチャネル別レートで送るため、バッチ送信は無効にする
+    void setTelemetryType(uint8_t type);
+    uint8_t telemetryType() const { return _txType; }
+
+    // 送信タイミングの判定。TYPE_TELEMETRY はチャネル別レート（SUBSCRIBE、全購読者で共通）、
+    // それ以外は CONTROL_RATE_HZ（バッチ送信中は旧IMUパケットだけの周期）。true を返した直後の sendControl() は期限の来たセクションだけを載せる
+    bool telemetryDue(uint32_t nowUs);
+    TelemetryScheduler& scheduler() { return _sched; }
+    // SEC_LINK の受信側の項目（rx*。UdpReceiver の統計を main から書き込む）
+    void setRxStatsSource(std::function<void(CommProtocol::LinkStats& link)> fn) { _rxStatsSource = fn; }
+    CommProtocol::LinkStats linkStats() const;
+
+    // 旧IMUパケットの送信（STREAM_IMU の購読者へ）
+    bool sendImuPacket(const uint8_t* buf, size_t n);
+
+    // テレメトリの購読者（PC から HELLO で登録、PEER_IDLE_MS 無通信で解除）
+    struct Peer {
+        IPAddress ip;
+        uint16_t port;
+        uint8_t streams;        // CommProtocol::STREAM_*
+        bool active;
+        uint32_t lastSeenMs;
+        uint32_t packets;       // このピアへの送信データグラム数
+        uint32_t failures;      // このピアへの送信失敗数
+    };
+    static constexpr uint8_t MAX_PEERS = 4;
+    static constexpr uint32_t PEER_IDLE_MS = 10000;
+
+    // 購読の登録・更新（streams=0 で解除）。戻り値はスロット番号、満杯なら-1
+    int subscribe(IPAddress ip, uint16_t port, uint8_t streams);
+    uint8_t peerCount() const;
+    const Peer& peer(uint8_t slot) const { return _peers[slot]; }
+
+    // 購読者がいないストリームをサブネットブロードキャストで送る（既定OFF）
+    void setBroadcastFallback(bool enabled) { _broadcastFallback = enabled; }
+    bool broadcastFallback() const { return _broadcastFallback; }
+
+    // バッチ送信: pushSample() で積んだ maxSamples 個のサンプルを1データグラム（TYPE_CONTROL_BATCH）にまとめる。
+    // IMU の全サンプル（500Hz）を積むので、5～10 で 50～100 データグラム/秒になる。
+    // maxSamples<=1 で無効（1サンプル1データグラム）。maxAgeMs 経過でも送信する。
+    // TYPE_TELEMETRY 送信中は有効にできない（maxSamples は1に制限され、batchSize() で確認できる）
+    void setBatching(uint8_t maxSamples, uint16_t maxAgeMs);
+    uint8_t batchSize() const { return _batchMax; }
+    uint16_t batchMaxAgeMs() const { return _batchMaxAgeMs; }
+
+    // loop() から毎回呼ぶ（WiFi接続の状態遷移、バッチの期限送信と送信レート集計）
+    void poll();
+
+    // 送信統計
+    struct TxStats {
+        uint32_t packets;       // 送信データグラム数
+        uint32_t bytes;         // 送信バイト数（UDPペイロード）
+        uint32_t failures;      // endPacket 失敗数
+        uint32_t samples;       // 送信したサンプル数
+        float packetsPerSec;    // 直近1秒の送信レート
+        float bytesPerSec;
+    };
+    const TxStats& txStats() const { return _stats; }
+
+    static constexpr uint8_t MAX_BATCH = 24;  // 1データグラムが MTU(1472B) に収まる上限
 
 private:
+    static constexpr size_t BATCH_BUF_SIZE = CommProtocol::HEADER_LEN + 1
+        + MAX_BATCH * CommProtocol::ControlV2Encoder::MAX_PAYLOAD_LEN + 2;
+
+    static constexpr uint32_t CONNECT_TIMEOUT_MS = 15000;
+    static constexpr uint32_t BACKOFF_MIN_MS = 1000;
+    static constexpr uint32_t BACKOFF_MAX_MS = 30000;
+
+    void pollLink(uint32_t now);
+    void startConnect(uint32_t now);
+    static constexpr uint16_t IMU_BROADCAST_PORT = 12346;  // 旧IMUパケットのブロードキャスト先
+
+    bool wantsStream(uint8_t stream) const;
+    bool sendStream(uint8_t stream, const uint8_t* buf, size_t n);
+    void expirePeers(uint32_t now);
+    bool sendDatagram(IPAddress target, uint16_t port, const uint8_t* buf, size_t n);
+    bool flushBatch();
+
     WiFiUDP _udp;
-    IPAddress _target;
-    uint16_t _port;
     bool _ready;
+    Peer _peers[MAX_PEERS] = {};
+    bool _broadcastFallback = false;
+    LinkState _linkState = LinkState::IDLE;
+    uint32_t _stateSinceMs = 0;
+    uint32_t _backoffMs = BACKOFF_MIN_MS;
+    uint32_t _connectCount = 0;
+    bool _udpStarted = false;
+    uint8_t _txType = CommProtocol::TYPE_CONTROL;
+    CommProtocol::ControlV2Encoder _v2Encoder;
+    TelemetryScheduler _sched;
+    uint8_t _dueMask = 0;
+    uint32_t _nextBaseUs = 0;
+    std::function<void(CommProtocol::LinkStats&)> _rxStatsSource;
+
+    uint8_t _batchMax = 1;
+    uint16_t _batchMaxAgeMs = 20;
+    uint8_t _batchBuf[BATCH_BUF_SIZE];
+    size_t _batchLen = 0;
+    uint8_t _batchCount = 0;
+    uint16_t _batchSeq = 0;
+    uint32_t _batchStartMs = 0;
+
+    TxStats _stats = TxStats();
+    uint32_t _rateLastMs = 0;
+    uint32_t _rateLastPackets = 0;
+    uint32_t _rateLastBytes = 0;
 };
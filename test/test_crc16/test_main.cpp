@@ -0,0 +1,107 @@
+/**
+ * CRC16-CCITT の実装（COMM_CRC16_IMPL 0/1/2）がビット単位の参照実装と一致することの確認と、
+ * 処理速度（ns/B）の計測。実装ごとに env を分けて同じテストを回す（native / native_crc0 / native_crc2）
+ * 速度は pio test -e native -e native_crc0 -e native_crc2 -v の出力で比べる（ホストCPUでの相対値）
+ */
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "system/comm/CommProtocol.h"
+
+using namespace CommProtocol;
+
+// 再現性のある簡易乱数
+static uint32_t rng = 1;
+static uint32_t nextRand() {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// CRC-16/CCITT-FALSE の検査値
+static void test_check_value() {
+    const uint8_t msg[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_ccitt(msg, sizeof(msg)));
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_ccitt_bitwise(CRC16_INIT, msg, sizeof(msg)));
+}
+
+static void test_empty_is_init() {
+    TEST_ASSERT_EQUAL_HEX16(CRC16_INIT, crc16_ccitt(nullptr, 0));
+}
+
+// ランダムな長さ・開始位置（アラインメント）で参照実装と比較
+static void test_matches_bitwise_random() {
+    static uint8_t buf[600];
+    rng = 1;
+    for (int iter = 0; iter < 2000; iter++) {
+        for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)nextRand();
+        size_t offset = nextRand() % 8;
+        size_t len = nextRand() % (sizeof(buf) - 8);
+        uint16_t ref = crc16_ccitt_bitwise(CRC16_INIT, buf + offset, len);
+        TEST_ASSERT_EQUAL_HEX16(ref, crc16_ccitt(buf + offset, len));
+    }
+}
+
+// 分割して計算しても一括計算と一致する
+static void test_update_split() {
+    static uint8_t buf[257];
+    rng = 7;
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)nextRand();
+    uint16_t whole = crc16_ccitt(buf, sizeof(buf));
+    for (size_t cut = 0; cut <= sizeof(buf); cut++) {
+        uint16_t crc = crc16_ccitt_update(CRC16_INIT, buf, cut);
+        crc = crc16_ccitt_update(crc, buf + cut, sizeof(buf) - cut);
+        TEST_ASSERT_EQUAL_HEX16(whole, crc);
+    }
+}
+
+// buf を len 分だけ繰り返し計算し、1バイトあたりの時間（ns）を返す
+static volatile uint16_t benchSink;  // 最適化で計算が消えないように結果を書き出す先
+
+template <typename F>
+static double measureNsPerByte(F crc, const uint8_t* buf, size_t len) {
+    using Clock = std::chrono::steady_clock;
+    const double minSec = 0.2;
+    size_t total = 0;
+    uint16_t acc = 0;
+    auto t0 = Clock::now();
+    double sec = 0;
+    do {
+        for (int i = 0; i < 16; i++) {
+            acc ^= crc(buf, len);
+            total += len;
+        }
+        sec = std::chrono::duration<double>(Clock::now() - t0).count();
+    } while (sec < minSec);
+    benchSink = acc;
+    return sec * 1e9 / (double)total;
+}
+
+// 64KB のランダムデータで選択中の実装と参照実装の ns/B を表示（結果は参照実装と一致すること）
+static void test_throughput() {
+    static uint8_t buf[65536];
+    rng = 3;
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)nextRand();
+    double impl = measureNsPerByte([](const uint8_t* d, size_t n) { return crc16_ccitt(d, n); },
+                                   buf, sizeof(buf));
+    double ref = measureNsPerByte([](const uint8_t* d, size_t n) { return crc16_ccitt_bitwise(CRC16_INIT, d, n); },
+                                  buf, sizeof(buf));
+    char msg[128];
+    snprintf(msg, sizeof(msg), "COMM_CRC16_IMPL=%d: %.3f ns/B (%.1f MB/s), bitwise: %.3f ns/B, x%.1f",
+             COMM_CRC16_IMPL, impl, 1e3 / impl, ref, ref / impl);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_HEX16(crc16_ccitt_bitwise(CRC16_INIT, buf, sizeof(buf)), crc16_ccitt(buf, sizeof(buf)));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_check_value);
+    RUN_TEST(test_empty_is_init);
+    RUN_TEST(test_matches_bitwise_random);
+    RUN_TEST(test_update_split);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
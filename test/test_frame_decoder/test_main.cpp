@@ -0,0 +1,266 @@
+/**
+ * FrameDecoder のストリーム復帰テスト
+ * 不正 LEN・途中で切れたフレーム・破損フレーム・過大ペイロードの後でも
+ * 後続の正しいフレームを取りこぼさないことを確認する
+ * 最後に、乱数（シード固定）で作った数MBのストリームを乱数長に区切って流すファズ・スループット試験を行う
+ */
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "system/comm/CommProtocol.h"
+
+using namespace CommProtocol;
+
+static FrameDecoder* dec = nullptr;
+static std::vector<uint16_t> seqs;      // 受理したフレームの SEQ
+static std::vector<uint16_t> lens;      // 受理したフレームの LEN
+
+static size_t makeFrame(uint8_t* out, uint16_t seq, uint16_t len, bool etx = true) {
+    uint8_t payload[MAX_RX_PAYLOAD];
+    for (uint16_t i = 0; i < len; i++) payload[i] = (uint8_t)(seq + i);
+    return buildCommandFrame(out, HEADER_LEN + MAX_RX_PAYLOAD + 3, 0x01, seq, payload, len, etx);
+}
+
+static void feedAll(const std::vector<uint8_t>& v) { dec->feed(v.data(), v.size()); }
+
+static void append(std::vector<uint8_t>& v, const uint8_t* p, size_t n) { v.insert(v.end(), p, p + n); }
+
+void setUp() {
+    seqs.clear();
+    lens.clear();
+    dec = new FrameDecoder(true);
+    dec->setHandler([](const Frame& f) {
+        seqs.push_back(f.seq);
+        lens.push_back(f.len);
+    });
+}
+
+void tearDown() {
+    delete dec;
+    dec = nullptr;
+}
+
+static void test_single_frame_bytewise() {
+    uint8_t buf[300];
+    size_t n = makeFrame(buf, 10, 5);
+    for (size_t i = 0; i < n; i++) dec->feed(buf + i, 1);
+    TEST_ASSERT_EQUAL(1, (int)seqs.size());
+    TEST_ASSERT_EQUAL(10, seqs[0]);
+    TEST_ASSERT_EQUAL(5, lens[0]);
+    TEST_ASSERT_EQUAL(1, (int)dec->stats().good);
+}
+
+// LEN がでたらめなヘッダの直後に正しいフレーム
+static void test_resync_after_bad_len() {
+    std::vector<uint8_t> v;
+    const uint8_t bad[] = { SYNC0, SYNC1, VERSION, 0x01, 0x00, 0x00, 0xFF, 0xFF };
+    append(v, bad, sizeof(bad));
+    uint8_t buf[300];
+    append(v, buf, makeFrame(buf, 2, 3));
+    feedAll(v);
+    TEST_ASSERT_EQUAL(1, (int)seqs.size());
+    TEST_ASSERT_EQUAL(2, seqs[0]);
+    TEST_ASSERT_EQUAL(1, (int)dec->stats().overflow);
+}
+
+// 途中で切れたフレームの後に完全なフレームが続く
+static void test_truncated_frame() {
+    uint8_t buf[300];
+    std::vector<uint8_t> v;
+    for (size_t cut = 1; cut < 20; cut++) {
+        v.clear();
+        size_t n = makeFrame(buf, 100, 12);
+        TEST_ASSERT_TRUE(cut < n);
+        append(v, buf, cut);
+        append(v, buf, makeFrame(buf, (uint16_t)(200 + cut), 4));
+        feedAll(v);
+    }
+    TEST_ASSERT_EQUAL(19, (int)seqs.size());
+    for (size_t i = 0; i < seqs.size(); i++) TEST_ASSERT_EQUAL(201 + i, seqs[i]);
+}
+
+// 1バイト化けたフレームは捨て、後続は受理する
+// LEN が化けて実際より長くなった場合は、その長さ分のバイトが届いた時点で再走査して復帰する
+static void test_corrupted_frame() {
+    uint8_t a[300], b[300], c[300], d[300];
+    size_t na = makeFrame(a, 1, 16);
+    size_t nb = makeFrame(b, 2, 16);
+    size_t nc = makeFrame(c, 3, 16);
+    size_t nd = makeFrame(d, 4, 16);
+    for (size_t pos = 2; pos < na; pos++) {
+        seqs.clear();
+        dec->reset();
+        std::vector<uint8_t> v;
+        append(v, a, na);
+        v[pos] ^= 0x5A;
+        append(v, b, nb);
+        append(v, c, nc);
+        append(v, d, nd);
+        feedAll(v);
+        TEST_ASSERT_EQUAL_MESSAGE(3, (int)seqs.size(), "corrupted frame must be dropped");
+        TEST_ASSERT_EQUAL(2, seqs[0]);
+        TEST_ASSERT_EQUAL(3, seqs[1]);
+        TEST_ASSERT_EQUAL(4, seqs[2]);
+    }
+}
+
+// 受信上限を超える LEN はバッファを溢れさせずに破棄
+static void test_oversize_payload() {
+    std::vector<uint8_t> v;
+    uint8_t hdr[HEADER_LEN] = { SYNC0, SYNC1, VERSION, 0x01, 0x05, 0x00,
+        (uint8_t)((MAX_RX_PAYLOAD + 1) & 0xFF), (uint8_t)((MAX_RX_PAYLOAD + 1) >> 8) };
+    append(v, hdr, sizeof(hdr));
+    for (int i = 0; i < MAX_RX_PAYLOAD + 3; i++) v.push_back((uint8_t)i);
+    uint8_t buf[300];
+    append(v, buf, makeFrame(buf, 9, MAX_RX_PAYLOAD));
+    feedAll(v);
+    TEST_ASSERT_EQUAL(1, (int)dec->stats().overflow);
+    TEST_ASSERT_EQUAL(1, (int)seqs.size());
+    TEST_ASSERT_EQUAL(9, seqs[0]);
+    TEST_ASSERT_EQUAL(MAX_RX_PAYLOAD, lens[0]);
+}
+
+// ETX 必須のデコーダに ETX 無しフレームを渡すと CRC 失敗として扱う
+static void test_missing_etx() {
+    uint8_t a[300], b[300];
+    std::vector<uint8_t> v;
+    append(v, a, makeFrame(a, 1, 8, false));
+    append(v, b, makeFrame(b, 2, 8, true));
+    feedAll(v);
+    TEST_ASSERT_EQUAL(1, (int)seqs.size());
+    TEST_ASSERT_EQUAL(2, seqs[0]);
+    TEST_ASSERT_TRUE(dec->stats().crcFail >= 1);
+}
+
+// ---------------------------------------------------------------------------
+// ファズ: 正しいフレームとノイズを交互に並べた数MBのストリーム
+// ---------------------------------------------------------------------------
+
+static uint32_t rng = 1;
+static uint32_t nextRand() {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+// ペイロード先頭4Bにフレーム番号を入れ、残りは番号から決まる値（受信側で中身も照合する）
+static uint8_t fuzzByte(uint32_t index, uint16_t i) { return (uint8_t)(index * 31u + i * 7u); }
+
+static size_t makeFuzzFrame(uint8_t* out, uint32_t index, uint16_t len) {
+    uint8_t payload[MAX_RX_PAYLOAD];
+    for (uint16_t i = 0; i < len; i++) payload[i] = fuzzByte(index, i);
+    memcpy(payload, &index, 4);
+    return buildCommandFrame(out, HEADER_LEN + MAX_RX_PAYLOAD + 3, 0x01, (uint16_t)index, payload, len, true);
+}
+
+// ノイズ: ランダムバイト、LEN 超過や CRC 不一致の偽ヘッダ、正しいフレームの途中までの断片のいずれか
+static void appendNoise(std::vector<uint8_t>& v) {
+    uint8_t buf[HEADER_LEN + MAX_RX_PAYLOAD + 3];
+    switch (nextRand() % 4) {
+    case 0: {
+        size_t n = 1 + nextRand() % 64;
+        for (size_t i = 0; i < n; i++) v.push_back((uint8_t)nextRand());
+        break;
+    }
+    case 1: {
+        uint16_t len = (uint16_t)(MAX_RX_PAYLOAD + 1 + nextRand() % 1000);
+        uint8_t hdr[HEADER_LEN] = { SYNC0, SYNC1, VERSION, 0x01, 0, 0, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+        append(v, hdr, sizeof(hdr));
+        break;
+    }
+    case 2: {
+        uint16_t len = (uint16_t)(nextRand() % 32);
+        uint8_t hdr[HEADER_LEN] = { SYNC0, SYNC1, VERSION, 0x01, 0, 0, (uint8_t)len, 0 };
+        append(v, hdr, sizeof(hdr));
+        for (uint16_t i = 0; i < len + 3; i++) v.push_back((uint8_t)nextRand());
+        break;
+    }
+    default: {
+        size_t n = makeFuzzFrame(buf, 0xFFFFFFFFu, (uint16_t)(nextRand() % 64));
+        append(v, buf, 1 + nextRand() % (n - 1));
+        break;
+    }
+    }
+}
+
+static void test_fuzz_stream() {
+    const size_t TARGET_BYTES = 4u * 1024 * 1024;
+    std::vector<uint8_t> stream;
+    stream.reserve(TARGET_BYTES + 4096);
+    uint8_t buf[HEADER_LEN + MAX_RX_PAYLOAD + 3];
+    rng = 12345;
+    uint32_t frames = 0;
+    while (stream.size() < TARGET_BYTES) {
+        if (nextRand() % 3 == 0) appendNoise(stream);
+        uint16_t len = (uint16_t)(4 + nextRand() % (MAX_RX_PAYLOAD - 3));
+        append(stream, buf, makeFuzzFrame(buf, frames++, len));
+    }
+    // 末尾の偽ヘッダが最後のフレームを抱え込んでいても判定が進むよう、最大フレーム長分の0を足す
+    stream.insert(stream.end(), HEADER_LEN + MAX_RX_PAYLOAD + 3, 0);
+
+    // 受理したフレーム番号（中身が壊れていたら UINT32_MAX）
+    static std::vector<uint32_t> got;
+    got.clear();
+    got.reserve(frames);
+    dec->setHandler([](const Frame& f) {
+        uint32_t index = 0xFFFFFFFFu;
+        if (f.len >= 4) memcpy(&index, f.payload, 4);
+        for (uint16_t i = 4; i < f.len; i++) {
+            if (f.payload[i] != fuzzByte(index, i)) { index = 0xFFFFFFFEu; break; }
+        }
+        if (f.seq != (uint16_t)index) index = 0xFFFFFFFEu;
+        got.push_back(index);
+    });
+
+    // 1..300B の乱数長に区切って流す
+    auto t0 = std::chrono::steady_clock::now();
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        size_t n = 1 + nextRand() % 300;
+        if (n > stream.size() - pos) n = stream.size() - pos;
+        dec->feed(stream.data() + pos, n);
+        pos += n;
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // 全フレームがちょうど1回ずつ、順番どおりに出る（ノイズ由来のフレームは出ない）
+    TEST_ASSERT_EQUAL(frames, got.size());
+    for (uint32_t i = 0; i < frames; i++) TEST_ASSERT_EQUAL(i, got[i]);
+
+    // 統計: good は全フレーム、破棄（CRC 不一致・LEN 超過）は必ず再走査を伴う
+    FrameDecoder::Stats st = dec->stats();
+    TEST_ASSERT_EQUAL(frames, st.good);
+    TEST_ASSERT_TRUE(st.crcFail > 0);
+    TEST_ASSERT_TRUE(st.overflow > 0);
+    TEST_ASSERT_TRUE(st.resync >= st.crcFail + st.overflow);
+
+    // 区切り方によらず同じ結果・同じ統計になる（一括で流したものと比較）
+    FrameDecoder whole(true);
+    uint32_t wholeGood = 0;
+    whole.setHandler([&wholeGood](const Frame&) { wholeGood++; });
+    whole.feed(stream.data(), stream.size());
+    TEST_ASSERT_EQUAL(frames, wholeGood);
+    TEST_ASSERT_EQUAL(st.good, whole.stats().good);
+    TEST_ASSERT_EQUAL(st.crcFail, whole.stats().crcFail);
+    TEST_ASSERT_EQUAL(st.overflow, whole.stats().overflow);
+    TEST_ASSERT_EQUAL(st.resync, whole.stats().resync);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%zu B, %u frames: %.1f MB/s (good=%u crcFail=%u resync=%u overflow=%u)",
+             stream.size(), (unsigned)frames, stream.size() / sec / 1e6,
+             (unsigned)st.good, (unsigned)st.crcFail, (unsigned)st.resync, (unsigned)st.overflow);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_frame_bytewise);
+    RUN_TEST(test_resync_after_bad_len);
+    RUN_TEST(test_truncated_frame);
+    RUN_TEST(test_corrupted_frame);
+    RUN_TEST(test_oversize_payload);
+    RUN_TEST(test_missing_etx);
+    RUN_TEST(test_fuzz_stream);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+/**
+ * Madgwick フィルタの数値固定テスト
+ * 決まった合成データ列を流したときの角度を、AttitudeFilter 化する前の実装
+ * （invSqrt のみ 32bit 整数に読み替えてホストでビルド）で求めた値と比較する
+ */
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include "MadgwickAHRS.h"
+// ライブラリは lib_ignore しているので、Arduino 非依存のファイルだけ直接取り込む
+#include "AttitudeFilter.cpp"
+#include "MadgwickAHRS.cpp"
+
+static constexpr float TOL_DEG = 1e-3f;
+
+// 再現性のある簡易乱数（-0.5..0.5）
+static uint32_t rng;
+static float noise() {
+    rng = rng * 1664525u + 1013904223u;
+    return ((float)(rng >> 8) / 16777216.0f) - 0.5f;
+}
+
+// i 番目のサンプル（100Hz）: ゆっくり傾きながら回る動き + ノイズ
+static void sample(int i, float* g, float* a) {
+    float t = i * 0.01f;
+    g[0] = 20.0f * sinf(0.7f * t) + 0.5f * noise();
+    g[1] = 15.0f * cosf(0.5f * t) + 0.5f * noise();
+    g[2] = 30.0f * sinf(0.3f * t) + 0.5f * noise();
+    float r = 0.35f * sinf(0.4f * t), p = -0.2f + 0.15f * cosf(0.6f * t);
+    a[0] = -sinf(p) + 0.02f * noise();
+    a[1] = sinf(r) * cosf(p) + 0.02f * noise();
+    a[2] = cosf(r) * cosf(p) + 0.02f * noise();
+}
+
+struct Expected {
+    int step;
+    float roll, pitch, yaw;
+};
+
+// 従来実装（gain 0.1, dt 0.01s, rng 初期値 12345）での角度
+static const Expected EXPECTED[] = {
+    {    1, -0.00044f, 0.14406f, 0.00111f },
+    {   10, 0.07720f, 1.45652f, 0.05414f },
+    {  100, 7.43684f, 12.96768f, 5.76544f },
+    {  500, 33.17081f, 1.36350f, 107.74096f },
+    { 1000, 110.68945f, 53.10094f, -80.01608f },
+    { 2000, 35.16820f, 58.03121f, -12.44863f },
+    { 3000, -64.06626f, 51.95830f, 72.48477f },
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void runSequence(MadgwickAHRS& f, bool explicitDt) {
+    rng = 12345;
+    size_t k = 0;
+    for (int i = 1; i <= 3000; i++) {
+        float g[3], a[3];
+        sample(i, g, a);
+        if (explicitDt) f.update(g[0], g[1], g[2], a[0], a[1], a[2], 0.01f);
+        else f.update(g[0], g[1], g[2], a[0], a[1], a[2]);
+        if (k < sizeof(EXPECTED) / sizeof(EXPECTED[0]) && EXPECTED[k].step == i) {
+            TEST_ASSERT_FLOAT_WITHIN(TOL_DEG, EXPECTED[k].roll, f.getRoll());
+            TEST_ASSERT_FLOAT_WITHIN(TOL_DEG, EXPECTED[k].pitch, f.getPitch());
+            TEST_ASSERT_FLOAT_WITHIN(TOL_DEG, EXPECTED[k].yaw, f.getYaw());
+            k++;
+        }
+    }
+    TEST_ASSERT_EQUAL(sizeof(EXPECTED) / sizeof(EXPECTED[0]), k);
+}
+
+static void test_matches_baseline() {
+    MadgwickAHRS f;
+    f.begin(100.0f);
+    f.setGain(0.1f);
+    runSequence(f, true);
+}
+
+// begin() のサンプルレートを使う更新も同じ結果になる
+static void test_matches_baseline_fixed_rate() {
+    MadgwickAHRS f;
+    f.begin(100.0f);
+    f.setGain(0.1f);
+    runSequence(f, false);
+}
+
+// reset() 後は初期状態から同じ結果を再現する
+static void test_reset_reproduces() {
+    MadgwickAHRS f;
+    f.begin(100.0f);
+    f.setGain(0.1f);
+    runSequence(f, true);
+    f.reset();
+    runSequence(f, true);
+}
+
+static void test_inv_sqrt() {
+    const float xs[] = { 1e-6f, 0.01f, 0.5f, 1.0f, 2.0f, 100.0f, 1e6f };
+    for (float x : xs) {
+        float ref = 1.0f / sqrtf(x);
+        TEST_ASSERT_FLOAT_WITHIN(ref * 0.002f, ref, AttitudeFilter::invSqrt(x));
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_baseline);
+    RUN_TEST(test_matches_baseline_fixed_rate);
+    RUN_TEST(test_reset_reproduces);
+    RUN_TEST(test_inv_sqrt);
+    return UNITY_END();
+}
@@ -0,0 +1,74 @@
+/**
+ * SpscQueue の2スレッド・ストレステスト
+ * プロデューサーが連番を積み、コンシューマーが欠番・重複・順序逆転なく受け取れることを確認する
+ * （満杯で捨てた分はプロデューサー側で数え、受け取った数と合わせて全体に一致すること）
+ */
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "system/SpscQueue.h"
+
+struct Item {
+    uint32_t seq;
+    uint32_t check;  // seq から決まる値（ちぎれた読みの検出用）
+};
+
+static constexpr uint32_t ITEMS = 2000000;
+
+void setUp() {}
+void tearDown() {}
+
+static void test_single_thread_fill_and_drain() {
+    SpscQueue<Item, 8> q;
+    Item it;
+    TEST_ASSERT_FALSE(q.pop(it));
+    for (uint32_t i = 0; i < 8; i++) TEST_ASSERT_TRUE(q.push(Item{ i, ~i }));
+    TEST_ASSERT_FALSE(q.push(Item{ 8, ~8u }));
+    TEST_ASSERT_EQUAL(8, (int)q.size());
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(q.pop(it));
+        TEST_ASSERT_EQUAL(i, it.seq);
+    }
+    TEST_ASSERT_FALSE(q.pop(it));
+    TEST_ASSERT_EQUAL(0, (int)q.size());
+}
+
+static void test_two_threads() {
+    static SpscQueue<Item, 256> q;
+    std::atomic<bool> done{false};
+    uint32_t dropped = 0;
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < ITEMS; i++) {
+            if (!q.push(Item{ i, i * 2654435761u })) dropped++;
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t received = 0, torn = 0, backwards = 0;
+    int64_t last = -1;
+    Item it;
+    for (;;) {
+        if (q.pop(it)) {
+            received++;
+            if (it.check != it.seq * 2654435761u) torn++;
+            if ((int64_t)it.seq <= last) backwards++;
+            last = it.seq;
+        } else if (done.load(std::memory_order_acquire) && q.size() == 0) {
+            break;
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, (int)torn);
+    TEST_ASSERT_EQUAL(0, (int)backwards);
+    TEST_ASSERT_EQUAL(ITEMS, received + dropped);
+    TEST_ASSERT_TRUE(received > 0);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_thread_fill_and_drain);
+    RUN_TEST(test_two_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+"""
+フライトレコーダーのダンプを CSV に変換
+
+入力はSDに保存された /frec_<millis>.bin、またはロボットから REC コマンド (cmd=0x0F) で取り出したもの。
+ファイル形式: [ヘッダ32B][レコード40B × count]（古い順、ver 2 は IMU サンプル1回ごとに1レコード）
+  ヘッダ: "FREC"[ver:1][recLen:1][reason:1][rsv:1][count:4][triggerIndex:4][triggerUs:4][capacity:4][pad:8]
+  レコード: [tUs:4][ax,ay,az:int16 g×4096][gx,gy,gz:int16 dps×16 バイアス補正前][roll,pitch,yaw:int16 deg×100]
+           [servo0..7:uint16 PCA9685カウント][loopUs:uint16 書き込んだ loop() の周期]
+
+例:
+  python flightrec_decode.py frec_123456.bin -o fall.csv
+  python flightrec_decode.py --serial /dev/ttyUSB0 --baud 921600 -o fall.csv   # 取り出して変換
+  python flightrec_decode.py --udp 192.168.0.11 --trigger -o now.csv            # 今すぐ凍結して取り出す
+"""
+import argparse
+import struct
+import sys
+import time
+
+from latency_probe import SerialLink, UdpLink, UDP_PORT
+
+CMD_REC = 0x0F
+OP_STATUS = 0x00
+OP_TRIGGER = 0x01
+OP_REARM = 0x02
+OP_READ = 0x03
+READ_MAX = 5
+
+HEADER_FMT = '<4sBBBBIIII8x'
+HEADER_LEN = struct.calcsize(HEADER_FMT)
+RECORD_FMT = '<I3h3h3h8HH'
+RECORD_LEN = struct.calcsize(RECORD_FMT)
+REASONS = {0: 'none', 1: 'command', 2: 'button', 3: 'fall', 4: 'stall'}
+STATES = {0: 'DISABLED', 1: 'RECORDING', 2: 'POST_TRIGGER', 3: 'FROZEN'}
+
+ACCEL_LSB = 4096.0
+GYRO_LSB = 16.0
+EULER_LSB = 100.0
+
+FILE_VERSION = 2  # FlightRecorder::FILE_VERSION
+CSV_COLUMNS = (['t_ms', 'ax', 'ay', 'az', 'gx', 'gy', 'gz', 'roll', 'pitch', 'yaw'] +
+               [f'servo{i}' for i in range(8)] + ['loop_us', 'trigger'])
+
+
+def build_header(reason, count, trigger_index, trigger_us, capacity):
+    return struct.pack(HEADER_FMT, b'FREC', FILE_VERSION, RECORD_LEN, reason, 0,
+                       count, trigger_index, trigger_us, capacity)
+
+
+def parse_dump(data):
+    """(header dict, records bytes list) を返す"""
+    if len(data) < HEADER_LEN:
+        raise ValueError('ヘッダが足りません')
+    magic, ver, rec_len, reason, _, count, trig_idx, trig_us, capacity = \
+        struct.unpack(HEADER_FMT, data[:HEADER_LEN])
+    if magic != b'FREC':
+        raise ValueError('FREC ファイルではありません')
+    if rec_len != RECORD_LEN:
+        raise ValueError(f'未対応のレコード長: {rec_len}')
+    body = data[HEADER_LEN:]
+    count = min(count, len(body) // RECORD_LEN)
+    header = {'version': ver, 'reason': reason, 'count': count, 'trigger_index': trig_idx,
+              'trigger_us': trig_us, 'capacity': capacity}
+    return header, [body[i * RECORD_LEN:(i + 1) * RECORD_LEN] for i in range(count)]
+
+
+def write_csv(header, records, out):
+    out.write(f"# reason={REASONS.get(header['reason'], header['reason'])} "
+              f"count={header['count']} trigger_index={header['trigger_index']}\n")
+    out.write(','.join(CSV_COLUMNS) + '\n')
+    if not records:
+        return
+    # 時刻はトリガー時点を0とした ms（トリガーなしなら先頭を0）
+    t_ref = None
+    if header['reason'] and header['trigger_index'] < len(records):
+        t_ref = struct.unpack_from('<I', records[header['trigger_index']])[0]
+    if t_ref is None:
+        t_ref = struct.unpack_from('<I', records[0])[0]
+    for i, rec in enumerate(records):
+        v = struct.unpack(RECORD_FMT, rec)
+        dt = ((v[0] - t_ref + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+        row = [f'{dt / 1000.0:.3f}']
+        row += [f'{x / ACCEL_LSB:.4f}' for x in v[1:4]]
+        row += [f'{x / GYRO_LSB:.3f}' for x in v[4:7]]
+        row += [f'{x / EULER_LSB:.2f}' for x in v[7:10]]
+        row += [str(x) for x in v[10:18]]
+        row += [str(v[18]), '1' if header['reason'] and i == header['trigger_index'] else '']
+        out.write(','.join(row) + '\n')
+
+
+class Fetcher:
+    def __init__(self, link):
+        self.link = link
+        self.seq = 0
+
+    def request(self, payload, timeout=0.5, retries=5):
+        for _ in range(retries):
+            seq = self.seq & 0xFFFF
+            self.seq += 1
+            self.link.send(seq, payload)
+            deadline = time.perf_counter() + timeout
+            while time.perf_counter() < deadline:
+                for fseq, reply in self.link.recv(deadline - time.perf_counter()):
+                    if fseq == seq and len(reply) >= 2 and reply[0] == CMD_REC:
+                        return reply
+        raise TimeoutError('ロボットから応答がありません')
+
+    def status(self, op=OP_STATUS):
+        r = self.request(struct.pack('<BB', CMD_REC, op))
+        state, reason = r[2], r[3]
+        count, capacity, trig_idx, trig_us = struct.unpack('<IIII', r[4:20])
+        return {'state': state, 'reason': reason, 'count': count, 'capacity': capacity,
+                'trigger_index': trig_idx, 'trigger_us': trig_us}
+
+    def fetch(self, wait_frozen=10.0):
+        st = self.status()
+        deadline = time.perf_counter() + wait_frozen
+        while st['state'] != 3:
+            if st['state'] == 0:
+                raise RuntimeError('フライトレコーダーが無効です')
+            if time.perf_counter() > deadline:
+                raise RuntimeError(f"凍結されていません（state={STATES.get(st['state'])}）。--trigger で凍結できます")
+            time.sleep(0.2)
+            st = self.status()
+        records = []
+        while len(records) < st['count']:
+            index = len(records)
+            r = self.request(struct.pack('<BBIB', CMD_REC, OP_READ, index, READ_MAX))
+            got_index, n = struct.unpack('<IB', r[2:7])
+            if got_index != index or n == 0:
+                raise RuntimeError(f'読み出し失敗 index={index}')
+            body = r[7:7 + n * RECORD_LEN]
+            records += [body[i * RECORD_LEN:(i + 1) * RECORD_LEN] for i in range(n)]
+            print(f"\r{len(records)}/{st['count']}", end='', file=sys.stderr)
+        print(file=sys.stderr)
+        header = dict(st)
+        header['version'] = FILE_VERSION
+        return header, records
+
+
+def main():
+    parser = argparse.ArgumentParser(description='フライトレコーダーのダンプを CSV に変換')
+    parser.add_argument('dump', nargs='?', help='ダンプファイル（.bin）。省略時は --serial/--udp から取り出す')
+    parser.add_argument('-o', '--output', help='出力CSV（省略時は標準出力）')
+    parser.add_argument('--serial', type=str, help='シリアルポート名 (例: COM8, /dev/ttyUSB0)')
+    parser.add_argument('--baud', type=int, default=115200, help='ボーレート')
+    parser.add_argument('--udp', type=str, help='ロボットのIPアドレス')
+    parser.add_argument('--udp-port', type=int, default=UDP_PORT, help='ロボットのUDP受信ポート')
+    parser.add_argument('--trigger', action='store_true', help='取り出し前に凍結する（REC trigger）')
+    parser.add_argument('--rearm', action='store_true', help='取り出し後に記録を再開する')
+    parser.add_argument('--save-bin', help='取り出した内容をダンプファイルとしても保存')
+    args = parser.parse_args()
+
+    if args.dump:
+        with open(args.dump, 'rb') as f:
+            header, records = parse_dump(f.read())
+    else:
+        if args.serial:
+            link = SerialLink(args.serial, args.baud)
+        elif args.udp:
+            link = UdpLink(args.udp, args.udp_port)
+        else:
+            parser.error('ダンプファイルか --serial / --udp を指定してください')
+        fetcher = Fetcher(link)
+        if args.trigger:
+            fetcher.status(OP_TRIGGER)
+        header, records = fetcher.fetch()
+        if args.save_bin:
+            with open(args.save_bin, 'wb') as f:
+                f.write(build_header(header['reason'], len(records), header['trigger_index'],
+                                     header['trigger_us'], header['capacity']))
+                f.write(b''.join(records))
+        if args.rearm:
+            fetcher.status(OP_REARM)
+
+    print(f"reason={REASONS.get(header['reason'], header['reason'])} records={len(records)}", file=sys.stderr)
+    if args.output:
+        with open(args.output, 'w', newline='') as out:
+            write_csv(header, records, out)
+    else:
+        write_csv(header, records, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
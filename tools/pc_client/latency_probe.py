@@ -0,0 +1,221 @@
+"""
+往復遅延（RTT）計測ツール
+
+PING_TS (cmd=0x08) を N 回送信し、RTT の min / median / p99 / max と
+ホスト・デバイス間の時計オフセットを表示する。
+前回の RTT を次の PING_TS に載せるので、デバイス側のヒストグラム（cmd=0x09）にも蓄積される。
+
+例:
+  python latency_probe.py --serial /dev/ttyUSB0 --baud 921600 -n 500
+  python latency_probe.py --udp 192.168.0.11 -n 1000 --interval 0.01
+"""
+import argparse
+import socket
+import struct
+import time
+
+import serial
+
+SYNC = b'\xAA\x55'
+VER = 0x01
+TYPE_COMMAND = 0x02
+CMD_PING_TS = 0x08
+CMD_LATENCY = 0x09
+UDP_PORT = 12345
+
+
+# --- CRC16-CCITT ---
+def crc16_ccitt(data: bytes, poly=0x1021, init=0xFFFF) -> int:
+    crc = init
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = (crc << 1) ^ poly
+            else:
+                crc <<= 1
+            crc &= 0xFFFF
+    return crc
+
+
+def build_command(seq, payload, etx):
+    header = SYNC + struct.pack('<BBHH', VER, TYPE_COMMAND, seq & 0xFFFF, len(payload))
+    body = header + payload
+    crc = crc16_ccitt(body[2:])  # VER～PAYLOAD
+    return body + struct.pack('<H', crc) + (b'\x7E' if etx else b'')
+
+
+def parse_commands(buf):
+    """buf からコマンド応答フレームを取り出す。(frames, 残りのbuf) を返す。テレメトリは読み捨てる"""
+    frames = []
+    while True:
+        i = buf.find(SYNC)
+        if i < 0:
+            return frames, buf[-1:]
+        buf = buf[i:]
+        if len(buf) < 8:
+            return frames, buf
+        ver, typ, seq, length = struct.unpack('<BBHH', buf[2:8])
+        if ver != VER or length > 256:
+            buf = buf[2:]
+            continue
+        total = 8 + length + 2
+        if len(buf) < total:
+            return frames, buf
+        pkt = buf[:total]
+        crc_recv = struct.unpack('<H', pkt[8 + length:])[0]
+        if typ == TYPE_COMMAND and crc16_ccitt(pkt[2:8 + length]) == crc_recv:
+            frames.append((seq, pkt[8:8 + length]))
+            buf = buf[total:]
+        elif typ != TYPE_COMMAND:
+            buf = buf[total:]  # テレメトリ（CRC範囲が異なるので検査しない）
+        else:
+            buf = buf[2:]
+
+
+class SerialLink:
+    def __init__(self, port, baud):
+        self.ser = serial.Serial(port, baud, timeout=0)
+        self.buf = b''
+
+    def send(self, seq, payload):
+        self.ser.write(build_command(seq, payload, True))
+
+    def recv(self, timeout):
+        deadline = time.perf_counter() + timeout
+        while time.perf_counter() < deadline:
+            data = self.ser.read(4096)
+            if data:
+                self.buf += data
+                frames, self.buf = parse_commands(self.buf)
+                if frames:
+                    return frames
+            else:
+                time.sleep(0.0002)
+        return []
+
+
+class UdpLink:
+    def __init__(self, host, port):
+        self.addr = (host, port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+
+    def send(self, seq, payload):
+        self.sock.sendto(build_command(seq, payload, False), self.addr)
+
+    def recv(self, timeout):
+        self.sock.settimeout(timeout)
+        try:
+            data, _ = self.sock.recvfrom(2048)
+        except socket.timeout:
+            return []
+        frames, _ = parse_commands(data)
+        return frames
+
+
+def host_us(t0):
+    return int((time.perf_counter() - t0) * 1e6) & 0xFFFFFFFF
+
+
+def s32(v):
+    v &= 0xFFFFFFFF
+    return v - 0x100000000 if v & 0x80000000 else v
+
+
+def percentile(sorted_vals, p):
+    if not sorted_vals:
+        return 0
+    k = min(len(sorted_vals) - 1, int(round(p / 100.0 * (len(sorted_vals) - 1))))
+    return sorted_vals[k]
+
+
+def run_probes(link, n, interval, timeout):
+    t0 = time.perf_counter()
+    rtts = []
+    offsets = []
+    lost = 0
+    prev_rtt = 0
+    for seq in range(n):
+        tx = host_us(t0)
+        link.send(seq, struct.pack('<BII', CMD_PING_TS, tx, prev_rtt))
+        got = None
+        deadline = time.perf_counter() + timeout
+        while got is None and time.perf_counter() < deadline:
+            for fseq, payload in link.recv(deadline - time.perf_counter()):
+                if fseq == (seq & 0xFFFF) and len(payload) >= 13 and payload[0] == CMD_PING_TS:
+                    got = payload
+        rx = host_us(t0)
+        if got is None:
+            lost += 1
+            prev_rtt = 0
+        else:
+            echo_tx, dev_rx, dev_tx = struct.unpack('<III', got[1:13])
+            if echo_tx == tx:
+                dev_hold = s32(dev_tx - dev_rx)
+                rtt = s32(rx - tx) - dev_hold
+                # NTP 方式: offset = デバイス時刻 - ホスト時刻
+                offset = (s32(dev_rx - tx) + s32(dev_tx - rx)) / 2
+                rtts.append(rtt)
+                offsets.append((rtt, offset))
+                prev_rtt = max(rtt, 1)
+        if interval > 0:
+            time.sleep(interval)
+    return rtts, offsets, lost
+
+
+def query_histogram(link, seq, clear):
+    link.send(seq, struct.pack('<BB', CMD_LATENCY, 1 if clear else 0))
+    deadline = time.perf_counter() + 1.0
+    while time.perf_counter() < deadline:
+        for fseq, payload in link.recv(deadline - time.perf_counter()):
+            if payload and payload[0] == CMD_LATENCY and len(payload) >= 17 + 16 * 4:
+                return struct.unpack('<4I', payload[1:17]), struct.unpack('<16I', payload[17:17 + 64])
+    return None, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='PING_TS による往復遅延計測')
+    parser.add_argument('--serial', type=str, help='シリアルポート名 (例: COM8, /dev/ttyUSB0)')
+    parser.add_argument('--baud', type=int, default=115200, help='ボーレート')
+    parser.add_argument('--udp', type=str, help='ロボットのIPアドレス')
+    parser.add_argument('--udp-port', type=int, default=UDP_PORT, help='ロボットのUDP受信ポート')
+    parser.add_argument('-n', type=int, default=200, help='計測回数')
+    parser.add_argument('--interval', type=float, default=0.01, help='送信間隔[秒]')
+    parser.add_argument('--timeout', type=float, default=0.5, help='応答待ちタイムアウト[秒]')
+    parser.add_argument('--clear', action='store_true', help='デバイス側ヒストグラムを取得後にクリア')
+    args = parser.parse_args()
+
+    if args.serial:
+        link = SerialLink(args.serial, args.baud)
+    elif args.udp:
+        link = UdpLink(args.udp, args.udp_port)
+    else:
+        parser.error('--serial か --udp を指定してください')
+
+    rtts, offsets, lost = run_probes(link, args.n, args.interval, args.timeout)
+    if not rtts:
+        print(f'応答なし (lost={lost})')
+        return
+
+    s = sorted(rtts)
+    print(f'probes={args.n} ok={len(rtts)} lost={lost}')
+    print(f'RTT[us]: min={s[0]} median={percentile(s, 50)} p99={percentile(s, 99)} max={s[-1]}')
+    # RTT が最小の計測ほど経路の非対称が小さいので、その offset を推定値とする
+    best = min(offsets, key=lambda o: o[0])
+    print(f'clock offset (device - host) [us]: {best[1]:.0f} (rtt={best[0]}us)')
+
+    summary, bins = query_histogram(link, args.n, args.clear)
+    if summary is None:
+        print('device histogram: 応答なし')
+        return
+    count, mn, mx, mean = summary
+    print(f'device histogram: n={count} min={mn} max={mx} mean={mean} us')
+    for i, c in enumerate(bins):
+        if c == 0:
+            continue
+        upper = f'<{128 << i}' if i < 15 else f'>={128 << 14}'
+        print(f'  {upper:>10} us: {c}')
+
+
+if __name__ == '__main__':
+    main()
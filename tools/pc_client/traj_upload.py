@@ -0,0 +1,172 @@
+"""
+軌道アップロードツール
+
+時刻付きキーフレーム（CSV: t_ms,pos0,...,pos7）を TRAJ_PUSH (cmd=0x0D) で先行送信し、
+ロボット側の軌道バッファで再生させる。ロボットは lead[ms] 分たまってから自分の時計で再生するので、
+通信の揺らぎがそのまま歩容のカクつきにならない。
+応答の aheadMs（バッファにたまっている時間）を見て送信ペースを調整する。
+
+例:
+  python traj_upload.py --serial /dev/ttyUSB0 --baud 921600 gait.csv
+  python traj_upload.py --udp 192.168.0.11 gait.csv --lead 150 --ahead 400
+"""
+import argparse
+import csv
+import struct
+import time
+
+from latency_probe import SerialLink, UdpLink, UDP_PORT
+
+CMD_TRAJ_PUSH = 0x0D
+CMD_TRAJ_CTRL = 0x0E
+FLAG_START = 0x01
+FLAG_END = 0x02
+OP_STATUS = 0x00
+OP_STOP = 0x01
+OP_SET_LEAD = 0x02
+SERVO_COUNT = 8
+STATE_NAMES = {0: 'IDLE', 1: 'FILLING', 2: 'PLAYING', 3: 'UNDERRUN'}
+
+# 1フレームに載せるキーフレーム数の上限（UDP受信バッファ128Bに収まる数）
+MAX_PER_FRAME_UDP = 5
+MAX_PER_FRAME_SERIAL = 12
+
+
+def load_keyframes(path):
+    """CSV を読み込む。# で始まる行と空行は無視。t_ms は単調増加であること"""
+    frames = []
+    with open(path, newline='') as f:
+        for row in csv.reader(f):
+            if not row or row[0].strip().startswith('#'):
+                continue
+            try:
+                values = [int(float(v)) for v in row[:1 + SERVO_COUNT]]
+            except ValueError:
+                continue  # ヘッダ行
+            if len(values) != 1 + SERVO_COUNT:
+                raise ValueError(f'列数が足りません: {row}')
+            frames.append((values[0], values[1:]))
+    return frames
+
+
+def parse_status(payload):
+    """[cmd][state][depth][free][underruns:4][playMs:4][aheadMs:2][leadMs:2]"""
+    if len(payload) < 16:
+        return None
+    state, depth, free = payload[1], payload[2], payload[3]
+    underruns, play_ms, ahead_ms, lead_ms = struct.unpack('<IIHH', payload[4:16])
+    return {'state': state, 'depth': depth, 'free': free, 'underruns': underruns,
+            'play_ms': play_ms, 'ahead_ms': ahead_ms, 'lead_ms': lead_ms}
+
+
+class Uploader:
+    def __init__(self, link, per_frame):
+        self.link = link
+        self.per_frame = per_frame
+        self.seq = 0
+
+    def request(self, payload, cmd, timeout=0.3):
+        seq = self.seq & 0xFFFF
+        self.seq += 1
+        self.link.send(seq, payload)
+        deadline = time.perf_counter() + timeout
+        while time.perf_counter() < deadline:
+            for fseq, reply in self.link.recv(deadline - time.perf_counter()):
+                if fseq == seq and reply and reply[0] == cmd:
+                    return parse_status(reply)
+        return None
+
+    def control(self, op, arg=0):
+        return self.request(struct.pack('<BBH', CMD_TRAJ_CTRL, op, arg), CMD_TRAJ_CTRL)
+
+    def push(self, frames, flags):
+        payload = struct.pack('<BBB', CMD_TRAJ_PUSH, flags, len(frames))
+        for t_ms, pos in frames:
+            payload += struct.pack('<I8H', t_ms, *pos)
+        return self.request(payload, CMD_TRAJ_PUSH)
+
+    def run(self, keyframes, ahead_target_ms, poll_interval):
+        i = 0
+        status = None
+        first = True
+        misses = 0
+        while i < len(keyframes):
+            # バッファが十分たまっている間は待つ（ロボットの時計に合わせて送る）
+            if status and status['ahead_ms'] >= ahead_target_ms:
+                time.sleep(poll_interval)
+                status = self.control(OP_STATUS) or status
+                continue
+            n = min(self.per_frame, len(keyframes) - i)
+            if status:
+                n = min(n, status['free'])
+            if n <= 0:
+                time.sleep(poll_interval)
+                status = self.control(OP_STATUS) or status
+                continue
+            chunk = keyframes[i:i + n]
+            flags = (FLAG_START if first else 0) | (FLAG_END if i + n >= len(keyframes) else 0)
+            reply = self.push(chunk, flags)
+            if reply is None:
+                # 応答なし: 同じキーフレームを再送（デバイス側は時刻が戻ったものを捨てる）
+                misses += 1
+                if misses >= 10:
+                    raise TimeoutError('ロボットから応答がありません')
+                continue
+            misses = 0
+            status = reply
+            first = False
+            i += n
+            print(f"\rsent={i}/{len(keyframes)} {STATE_NAMES.get(status['state'], '?'):8} "
+                  f"depth={status['depth']:2} ahead={status['ahead_ms']:5}ms "
+                  f"underruns={status['underruns']}", end='')
+        # 再生が終わるまで状態を表示
+        while status and status['state'] != 0:
+            time.sleep(poll_interval)
+            status = self.control(OP_STATUS) or status
+            print(f"\rplay={status['play_ms']}ms {STATE_NAMES.get(status['state'], '?'):8} "
+                  f"underruns={status['underruns']}      ", end='')
+        print()
+        return status
+
+
+def main():
+    parser = argparse.ArgumentParser(description='TRAJ_PUSH による軌道の先行送信')
+    parser.add_argument('csv', help='キーフレームCSV（t_ms,pos0,...,pos7）')
+    parser.add_argument('--serial', type=str, help='シリアルポート名 (例: COM8, /dev/ttyUSB0)')
+    parser.add_argument('--baud', type=int, default=115200, help='ボーレート')
+    parser.add_argument('--udp', type=str, help='ロボットのIPアドレス')
+    parser.add_argument('--udp-port', type=int, default=UDP_PORT, help='ロボットのUDP受信ポート')
+    parser.add_argument('--lead', type=int, default=None, help='再生開始前にためる時間[ms]（省略時はデバイス設定）')
+    parser.add_argument('--ahead', type=int, default=400, help='デバイス側にためておく目標時間[ms]')
+    parser.add_argument('--poll', type=float, default=0.02, help='状態確認の間隔[秒]')
+    args = parser.parse_args()
+
+    if args.serial:
+        link = SerialLink(args.serial, args.baud)
+        per_frame = MAX_PER_FRAME_SERIAL
+    elif args.udp:
+        link = UdpLink(args.udp, args.udp_port)
+        per_frame = MAX_PER_FRAME_UDP
+    else:
+        parser.error('--serial か --udp を指定してください')
+
+    keyframes = load_keyframes(args.csv)
+    if not keyframes:
+        print('キーフレームがありません')
+        return
+
+    up = Uploader(link, per_frame)
+    if args.lead is not None:
+        up.control(OP_SET_LEAD, args.lead)
+    try:
+        status = up.run(keyframes, args.ahead, args.poll)
+    except KeyboardInterrupt:
+        up.control(OP_STOP)
+        print('\n停止しました')
+        return
+    if status:
+        print(f"done: underruns={status['underruns']}")
+
+
+if __name__ == '__main__':
+    main()
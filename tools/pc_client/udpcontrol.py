@@ -16,6 +16,29 @@ import numpy as np
 ROBOT_IP = "192.168.0.11"
 ROBOT_PORT = 12345  # ESP32側UDP_LISTEN_PORTと合わせる
 LOCAL_PORT = 12346  # PC側の受信ポート
+HELLO_INTERVAL = 2.0  # 購読登録(HELLO)の送信間隔[秒]（ロボット側は10秒無通信で解除）
+STREAM_IMU = 0x02
+
+
+# --- CRC16-CCITT ---
+def crc16_ccitt(data: bytes, poly=0x1021, init=0xFFFF) -> int:
+    crc = init
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = (crc << 1) ^ poly
+            else:
+                crc <<= 1
+            crc &= 0xFFFF
+    return crc
+
+
+def build_hello(seq):
+    # TYPE_COMMAND / CMD_HELLO: [0x0A][port:2=0(送信元ポート)][streams:1]
+    payload = struct.pack('<BHB', 0x0A, 0, STREAM_IMU)
+    body = b'\xAA\x55' + struct.pack('<BBHH', 0x01, 0x02, seq & 0xFFFF, len(payload)) + payload
+    return body + struct.pack('<H', crc16_ccitt(body[2:]))
 
 class UdpRobotClient:
     def __init__(self, master):
@@ -141,7 +164,17 @@ class UdpRobotClient:
         self.auto_send_thread.start()
 
     def auto_send_loop(self):
+        last_hello = 0.0
+        hello_seq = 0
         while self.running and self.auto_send:
+            # 定期的に購読登録してIMUデータをユニキャストで受け取る
+            if time.time() - last_hello >= HELLO_INTERVAL:
+                try:
+                    self.sock.sendto(build_hello(hello_seq), (self.ip_entry.get(), ROBOT_PORT))
+                except Exception:
+                    pass
+                hello_seq += 1
+                last_hello = time.time()
             self.send_servo(auto=True)
             time.sleep(self.send_interval)
 
@@ -220,7 +253,8 @@ class UdpRobotClient:
                 data, addr = self.sock.recvfrom(128)
                 print(f"[DEBUG] 受信: {addr} バイト列: {list(data)}")
                 # ESP32からのIMUデータ（バイナリ）を受信した場合の例
-                if len(data) >= 8 and data[0] == 0xAA and data[1] == 0x55:
+                # IMUデータは27バイト固定（HELLO応答などのコマンドフレームは無視）
+                if len(data) == 27 and data[0] == 0xAA and data[1] == 0x55:
                     # 例: [AA 55][roll][pitch][yaw][gx][gy][gz][temp] (float*6+uint8)
                     try:
                         floats = struct.unpack('<6fB', data[2:2+25])
@@ -242,6 +276,8 @@ class UdpRobotClient:
                     except Exception:
                         for v in self.imu_labels.values():
                             v.set("-")
+                elif len(data) >= 8 and data[0] == 0xAA and data[1] == 0x55:
+                    pass
                 else:
                     # テキスト等
                     self.status_var.set(f"Received from {addr}: {data[:32]!r}")